@@ -0,0 +1,167 @@
+
+// Checks tsGetDouble and tsGetFloat against strtod and strtof, bit for bit,
+// on the inputs that are hard to round correctly and on a seeded stream of
+// random decimals. Each input has a point or an exponent, as the readers
+// leave integers alone.
+
+#include <LabText/LabText.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <string>
+
+static int failures = 0;
+
+static void Check(std::string const& text) {
+    char const* begin = text.c_str();
+    char const* end = begin + text.size();
+
+    double want = strtod(begin, nullptr), got = -1;
+    char const* stop = tsGetDouble(begin, end, &got);
+    if (stop != end || memcmp(&want, &got, sizeof(got))) {
+        if (failures++ < 10)
+            printf("double %s: want %.17g got %.17g, read %d of %d\n", begin, want, got, (int) (stop - begin), (int) text.size());
+    }
+
+    float wantf = strtof(begin, nullptr), gotf = -1;
+    stop = tsGetFloat(begin, end, &gotf);
+    if (stop != end || memcmp(&wantf, &gotf, sizeof(gotf))) {
+        if (failures++ < 10)
+            printf("float %s: want %.9g got %.9g, read %d of %d\n", begin, wantf, gotf, (int) (stop - begin), (int) text.size());
+    }
+}
+
+static char const* cases[] = {
+    // halfway between two doubles, ties to even, and just either side
+    "9007199254740993e0", "9007199254740993.0", "9007199254740995.",
+    "9007199254740993.0000000000000000000001",
+    "1.00000000000000011102230246251565404236316680908203125",
+    "1.000000000000000111022302462515654042363166809082031250001",
+    // halfway between two floats, and just above
+    "1.000000059604644775390625", "1.00000005960464477550", "1.00000005960464477539",
+    // short decimals whose nearest double is a float midpoint, but which lie
+    // above it, so rounding through the double would give the wrong float
+    "0.00665369420312345", "0.03127223439514637", "8.913274996302789e-06",
+    // the largest subnormal and the smallest normal double
+    "2.2250738585072011e-308", "2.2250738585072012e-308", "2.2250738585072014e-308",
+    // hard float cases
+    "7.038531e-26", "8.589973e9", "1.1754943508e-38",
+    // the top of the float range and the first value that rounds past it
+    "3.4028235e38", "3.40282346e38", "3.4028236e38", "3.4028234664e38", "3.4028234665e38",
+    // the top of the double range, and overflow
+    "1.7976931348623157e308", "1.7976931348623158e308", "1.7976931348623159e308", "1e309",
+    // subnormals, and the halfway points to zero
+    "4.9406564584124654e-324", "2.4703282292062327e-324", "2.4703282292062328e-324",
+    "1e-320", "1.4e-45", "7.006492321624085e-46", "7.006492321624086e-46", "1e-40", "1e-400",
+    // more than 19 significant digits
+    "123456789012345678901234567890.", "0.1000000000000000055511151231257827021181583404541015625",
+    "3.14159265358979323846264338327950288", "0.000000000000000000000000000000000000001234567890123456789012",
+    "18446744073709551615.", "18446744073709551616e0", "99999999999999999999e-20",
+    // signs, zeros and short forms
+    "0.", "-0e0", "0.0", "-0.0e10", "1e0", ".5", "5.", "-.25e-3", "+1.5", "0e999", "1E5",
+};
+
+static std::string RandomDecimal(std::mt19937_64& rng) {
+    char buf[128];
+    int k = 0;
+    if (rng() % 2)
+        buf[k++] = '-';
+    switch (rng() % 7) {
+    case 0: {
+        // digits on both sides of the point
+        int a = rng() % 25, b = rng() % 25;
+        for (int i = 0; i < a; ++i)
+            buf[k++] = '0' + rng() % 10;
+        buf[k++] = '.';
+        for (int i = 0; i < b; ++i)
+            buf[k++] = '0' + rng() % 10;
+        if (a + b == 0)
+            buf[k++] = '5';
+        break;
+    }
+    case 1: {
+        // an integer and an exponent across the whole range
+        int a = 1 + rng() % 20;
+        for (int i = 0; i < a; ++i)
+            buf[k++] = '0' + rng() % 10;
+        k += snprintf(buf + k, sizeof(buf) - k, "e%d", (int) (rng() % 700) - 350);
+        break;
+    }
+    case 2: {
+        // a random double, printed to a random precision
+        uint64_t bits = rng();
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        if (!isfinite(d))
+            d = 1.5;
+        k += snprintf(buf + k, sizeof(buf) - k, "%.*e", (int) (rng() % 20), fabs(d));
+        break;
+    }
+    case 3: {
+        uint32_t bits = (uint32_t) rng();
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        if (!isfinite(f))
+            f = 1.5f;
+        k += snprintf(buf + k, sizeof(buf) - k, "%.*e", (int) (rng() % 12), fabs(f));
+        break;
+    }
+    case 4: {
+        // the midpoint between a double and the next one up, which is exact
+        // where long double has the extra bit
+        uint64_t bits = rng() & 0x7fefffffffffffffull;
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        long double mid = (long double) d / 2 + (long double) nextafter(d, INFINITY) / 2;
+        k += snprintf(buf + k, sizeof(buf) - k, "%.40Le", mid);
+        break;
+    }
+    case 5: {
+        // a float midpoint, printed to 10 to 16 digits
+        uint32_t bits = (uint32_t) rng() & 0x7f7fffffu;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        double mid = (double) f / 2 + (double) nextafterf(f, INFINITY) / 2;
+        k += snprintf(buf + k, sizeof(buf) - k, "%.*e", 9 + (int) (rng() % 7), mid);
+        break;
+    }
+    default: {
+        // small values with many leading zeros
+        int zeros = rng() % 40, digits = 1 + rng() % 22;
+        buf[k++] = '0';
+        buf[k++] = '.';
+        for (int i = 0; i < zeros; ++i)
+            buf[k++] = '0';
+        for (int i = 0; i < digits; ++i)
+            buf[k++] = '0' + rng() % 10;
+        break;
+    }
+    }
+    return std::string(buf, k);
+}
+
+// Integers are left for the integer readers.
+static char const* integers[] = { "15", "-0", "9007199254740993", "123456789012345678901234567890" };
+
+int main() {
+    for (char const* c : cases)
+        Check(c);
+    for (char const* c : integers) {
+        double d = 0;
+        float f = 0;
+        char const* end = c + strlen(c);
+        if (tsGetDouble(c, end, &d) != c || tsGetFloat(c, end, &f) != c) {
+            printf("%s was read as a float\n", c);
+            ++failures;
+        }
+    }
+
+    std::mt19937_64 rng(21);
+    for (int i = 0; i < 1000000; ++i)
+        Check(RandomDecimal(rng));
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
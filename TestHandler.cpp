@@ -0,0 +1,176 @@
+
+// Checks tsStrViewParseSexprHandler against tsStrViewParseSexprWithOptions:
+// the callbacks arrive in the order of the linked cells, with the same
+// values and views; a NULL callback is skipped and the others still called;
+// and the status and returned view agree, including when maxDepth stops the
+// parse.
+
+#include <LabText/LabText.h>
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void Fail(std::string const& what) {
+    if (failures++ < 20)
+        printf("%s\n", what.c_str());
+}
+
+// One token as text: its kind, and its value, or for atoms and strings the
+// offset and length of the view into the document.
+struct Event {
+    int token;
+    std::string value;
+    bool operator==(Event const& o) const { return token == o.token && value == o.value; }
+};
+
+struct Recorder {
+    char const* doc;
+    std::vector<Event> events;
+
+    void Add(int token, std::string value = std::string()) { events.push_back({ token, value }); }
+    std::string View(tsStrView_t v) const { return std::to_string(v.curr - doc) + "+" + std::to_string(v.sz); }
+    static std::string Bits(double f) {
+        char buf[24];
+        uint64_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        snprintf(buf, sizeof(buf), "%016llx", (unsigned long long) bits);
+        return buf;
+    }
+};
+
+static void OnPush(void* user) { static_cast<Recorder*>(user)->Add(tsSexprPushList); }
+static void OnPop(void* user) { static_cast<Recorder*>(user)->Add(tsSexprPopList); }
+static void OnAtom(void* user, tsStrView_t atom) {
+    Recorder* r = static_cast<Recorder*>(user);
+    r->Add(tsSexprAtom, r->View(atom));
+}
+static void OnString(void* user, tsStrView_t str) {
+    Recorder* r = static_cast<Recorder*>(user);
+    r->Add(tsSexprString, r->View(str));
+}
+static void OnInt(void* user, int64_t i) { static_cast<Recorder*>(user)->Add(tsSexprInteger, std::to_string(i)); }
+static void OnFloat(void* user, double f) { static_cast<Recorder*>(user)->Add(tsSexprFloat, Recorder::Bits(f)); }
+
+// The linked cells' tokens, recorded as the handler records them.
+static std::vector<Event> Cells(Recorder& r, tsParsedSexpr_t const* cell) {
+    for (; cell; cell = cell->next) {
+        switch (cell->token) {
+        case tsSexprInteger: r.Add(tsSexprInteger, std::to_string(cell->i)); break;
+        case tsSexprFloat: r.Add(tsSexprFloat, Recorder::Bits(cell->f)); break;
+        case tsSexprAtom:
+        case tsSexprString: r.Add(cell->token, r.View(cell->str)); break;
+        default: r.Add(cell->token);
+        }
+    }
+    return r.events;
+}
+
+static void Compare(std::string const& name, std::string const& doc, int maxDepth) {
+    tsSexprArena_t arena;
+    tsSexprArena_Init(&arena, 0);
+    tsSexprParseOptions_t options = { &arena, maxDepth };
+    tsParsedSexpr_t head;
+    memset(&head, 0, sizeof(head));
+    tsStrView_t s = { doc.c_str(), doc.size() };
+    tsSexprStatus_t cellStatus;
+    tsStrView_t cellRest = tsStrViewParseSexprWithOptions(&s, &head, 0, &options, &cellStatus);
+    Recorder cells = { doc.c_str(), {} };
+    std::vector<Event> expected = Cells(cells, head.next);
+    tsSexprArena_Free(&arena);
+
+    std::string where = name + " (maxDepth " + std::to_string(maxDepth) + ")";
+    // each subset of the callbacks, the rest left NULL
+    for (int mask = 0; mask < 64; ++mask) {
+        Recorder r = { doc.c_str(), {} };
+        tsSexprHandler_t handler = {
+            &r,
+            mask & 1 ? OnPush : nullptr, mask & 2 ? OnPop : nullptr, mask & 4 ? OnAtom : nullptr,
+            mask & 8 ? OnString : nullptr, mask & 16 ? OnInt : nullptr, mask & 32 ? OnFloat : nullptr,
+        };
+        tsSexprStatus_t status;
+        tsStrView_t rest = tsStrViewParseSexprHandler(&s, &handler, &options, &status);
+        if (status != cellStatus || rest.curr != cellRest.curr || rest.sz != cellRest.sz) {
+            Fail(where + ": status " + std::to_string(status) + ", not " + std::to_string(cellStatus));
+            return;
+        }
+        static int const bit[] = { 4, 1, 2, 16, 32, 8 };    // by tsSexprToken_t
+        std::vector<Event> want;
+        for (Event const& e : expected)
+            if (mask & bit[e.token])
+                want.push_back(e);
+        if (r.events != want) {
+            Fail(where + ": the callbacks differ with mask " + std::to_string(mask));
+            return;
+        }
+    }
+}
+
+static char const* cases[] = {
+    "(a (b (c 1 2.5) \"s\") () ((d)))",
+    "; lead\n(a) (b c) \t(d (e))",
+    "(\"q \\\" ()\" \xA7l (\xA7 \xC2\xA7u )\xC2\xA7 ; c )\n x)",
+    "(0 -7 9223372036854775807 -9223372036854775808 1e999 -0.0 .5 12abc)",
+    "(a)) (b)))",
+    "(a (b (c) (d",
+    "(a \"never closed",
+    "(1 (2 (3 (4 (5)))) (2b))",
+};
+
+static std::string RandomDocument(std::mt19937& rng) {
+    static char const* items[] = {
+        "(", "(", "(", ")", ")", ")", "atom", "-12", "3.25", "\"s\"", "\"(\"", "\xA7)\xA7", "\xC2\xA7 \xC2\xA7",
+        "; ( comment\n", " ", "\n", "1e5", "x)", "(y",
+    };
+    std::string doc = "(";
+    size_t n = rng() % 40;
+    for (size_t i = 0; i < n; ++i) {
+        doc += items[rng() % (sizeof(items) / sizeof(items[0]))];
+        doc += ' ';
+    }
+    return doc;
+}
+
+int main() {
+    int n = 0;
+    for (char const* c : cases) {
+        for (int maxDepth : { 0, 1, 2, 3, 16 })
+            Compare("case " + std::to_string(n), c, maxDepth);
+        ++n;
+    }
+
+    // too deep stops at the paren, after the callbacks for what came before
+    Recorder r = { "(a (b (c)))", {} };
+    tsSexprHandler_t handler = { &r, OnPush, OnPop, OnAtom, OnString, OnInt, OnFloat };
+    tsSexprParseOptions_t shallow = { nullptr, 2 };
+    tsStrView_t s = { r.doc, strlen(r.doc) };
+    tsSexprStatus_t status;
+    tsStrView_t rest = tsStrViewParseSexprHandler(&s, &handler, &shallow, &status);
+    if (status != tsSexprErrorDepth || rest.curr != r.doc + 6 || rest.sz != 0 || r.events.size() != 4)
+        Fail("too deep does not stop at the third paren");
+
+    // no handler, no input, or no list
+    if (tsStrViewParseSexprHandler(&s, nullptr, nullptr, &status).curr || status != tsSexprOk)
+        Fail("a null handler parses");
+    for (char const* text : { "", "  ", "atom (a)" }) {
+        Recorder none = { text, {} };
+        tsSexprHandler_t all = { &none, OnPush, OnPop, OnAtom, OnString, OnInt, OnFloat };
+        s = { text, strlen(text) };
+        tsStrViewParseSexprHandler(&s, &all, nullptr, &status);
+        if (!none.events.empty())
+            Fail(std::string("'") + text + "' calls back");
+    }
+
+    std::mt19937 rng(9);
+    for (int i = 0; i < 500; ++i) {
+        std::string doc = RandomDocument(rng);
+        Compare("random document " + std::to_string(i), doc, 0);
+        Compare("random document " + std::to_string(i), doc, 3);
+    }
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
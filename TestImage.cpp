@@ -0,0 +1,243 @@
+
+// Checks SexprImage: an image written from a Sexpr opens to the same
+// tables, with and without symbols, and knows the source it was written
+// from; and an image that is cut short, misaligned, or has any of its
+// tables damaged does not open. The implementation is compiled here, so
+// the image header can be edited in place.
+
+#define LABTEXT_ODR
+#include <LabText/LabText.h>
+#include <stdio.h>
+#include <string.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace lab::Text;
+
+static int failures = 0;
+
+static void Fail(char const* what) {
+    if (failures++ < 20)
+        printf("%s\n", what);
+}
+
+static char const* source = R"(
+(LabSoundGraphToy :name "SN76477" :version 2 :scale -0.5
+    (ls-node :name "Gain-3" :kind "Gain" :pos 869 116
+        (pins '(:name "gain" :kind "param" :value 1.0)))
+    (ls-node :name "Oscillator-1" :kind "Oscillator" :pos 450 110
+        (pins
+            '(:name "type" :kind "setting" :value "Enumeration Sine")
+            '(:name "frequency" :kind "param" :value 440.0)
+            '(:name "detune" :kind "param" :value 0.0)))
+    ; a comment, an empty list and escapes
+    () (esc "a\"b\\c\nd" §sec\§tion§ 123456789012 1e300)
+    (ls-connection :from "Gain-2" "out" :to "Gain-1" "Gain-1")))
+) (stray
+)";
+
+// An image copied to storage aligned to 8 bytes, as a mapped file would be.
+struct Image {
+    std::vector<uint64_t> words;
+    size_t size = 0;
+
+    explicit Image(std::string const& bytes) : words((bytes.size() + 7) / 8), size(bytes.size()) {
+        memcpy(words.data(), bytes.data(), bytes.size());
+    }
+    char* data() { return reinterpret_cast<char*>(words.data()); }
+    tsSexprImageHeader_t* header() { return reinterpret_cast<tsSexprImageHeader_t*>(data()); }
+    template <class T>
+    T* section(int i) { return reinterpret_cast<T*>(data() + header()->sections[i].offset); }
+};
+
+static bool Same(StrView a, StrView b) {
+    return a.sz == b.sz && !memcmp(a.curr, b.curr, a.sz);
+}
+
+static void CompareTables(Sexpr const& sexpr, SexprImage const& image) {
+    if (!image.Valid()) {
+        Fail("a written image does not open");
+        return;
+    }
+    if (image.expr.size() != sexpr.expr.size()
+        || memcmp(image.expr.begin(), sexpr.expr.data(), sexpr.expr.size() * sizeof(Sexpr::Elem)))
+        Fail("expr differs");
+    if (image.lists.size() != sexpr.lists.size())
+        Fail("lists differ");
+    else
+        for (size_t i = 0; i < sexpr.lists.size(); ++i)
+            if (image.lists[i].begin != sexpr.lists[i].begin || image.lists[i].end != sexpr.lists[i].end
+                || image.lists[i].count != sexpr.lists[i].count) {
+                Fail("lists differ");
+                break;
+            }
+    if (image.ints.size() != sexpr.ints.size()
+        || (!sexpr.ints.empty() && memcmp(image.ints.begin(), sexpr.ints.data(), sexpr.ints.size() * sizeof(int64_t))))
+        Fail("ints differ");
+    if (image.floats.size() != sexpr.floats.size()
+        || (!sexpr.floats.empty() && memcmp(image.floats.begin(), sexpr.floats.data(), sexpr.floats.size() * sizeof(double))))
+        Fail("floats differ");
+    for (Sexpr::Elem const& e : sexpr.expr)
+        if ((e.token == tsSexprAtom || e.token == tsSexprString) && !Same(image.Text(e), sexpr.Text(e))) {
+            Fail("text differs");
+            break;
+        }
+    if (image.HasSymbols() != (sexpr.symbols != nullptr))
+        Fail("symbols differ");
+    else if (sexpr.symbols) {
+        if (image.SymbolCount() != sexpr.symbols->Size())
+            Fail("symbol count differs");
+        else
+            for (uint32_t id = 0; id < sexpr.symbols->Size(); ++id)
+                if (!Same(image.Symbol(id), sexpr.symbols->Name(id))) {
+                    Fail("symbol names differ");
+                    break;
+                }
+    }
+    for (size_t i = 0; i < sexpr.expr.size(); ++i) {
+        if (image.Next(i) != sexpr.Next(i)) {
+            Fail("Next differs");
+            break;
+        }
+        if (sexpr.expr[i].token == tsSexprPushList
+            && (image.Match(i) != sexpr.Match(i) || image.ChildCount(i) != sexpr.ChildCount(i)
+                || image.Child(i, 1) != sexpr.Child(i, 1))) {
+            Fail("list navigation differs");
+            break;
+        }
+    }
+    if (image.balance != sexpr.balance || image.status != sexpr.status || image.errorOffset != sexpr.errorOffset)
+        Fail("balance, status or errorOffset differs");
+}
+
+// Opens a copy of bytes after damage, which must make it invalid.
+static void ExpectInvalid(char const* what, std::string const& bytes, std::function<void(Image&)> damage) {
+    Image image(bytes);
+    damage(image);
+    if (SexprImage(image.data(), image.size).Valid()) {
+        printf("an image with %s opens\n", what);
+        ++failures;
+    }
+}
+
+static void TestDamage(std::string const& bytes, bool symbols) {
+    // the image opens as it is, so each failure below is the damage's
+    Image intact(bytes);
+    if (!SexprImage(intact.data(), intact.size).Valid()) {
+        Fail("the undamaged image does not open");
+        return;
+    }
+
+    ExpectInvalid("its last bytes cut off", bytes, [](Image& i) { i.size -= 8; });
+    ExpectInvalid("only part of its header", bytes, [](Image& i) { i.size = sizeof(tsSexprImageHeader_t) - 1; });
+    ExpectInvalid("a size past the buffer", bytes, [](Image& i) { i.header()->size += 8; });
+    ExpectInvalid("a bad magic number", bytes, [](Image& i) { i.header()->magic[0] = 'X'; });
+    ExpectInvalid("another version", bytes, [](Image& i) { i.header()->version += 1; });
+    ExpectInvalid("a misaligned section", bytes, [](Image& i) { i.header()->sections[tsSexprImageLists].offset += 4; });
+    ExpectInvalid("a section past the end", bytes, [](Image& i) {
+        i.header()->sections[tsSexprImageInts].offset = i.header()->size + 8;
+    });
+    ExpectInvalid("a count past the end", bytes, [](Image& i) { i.header()->sections[tsSexprImageExpr].count += 1u << 20; });
+    ExpectInvalid("a huge count", bytes, [](Image& i) { i.header()->sections[tsSexprImageFloats].count = ~0ull / 2; });
+    ExpectInvalid("one list too few", bytes, [](Image& i) { i.header()->sections[tsSexprImageLists].count -= 1; });
+    ExpectInvalid("one string too few", bytes, [](Image& i) { i.header()->sections[tsSexprImageStringOffsets].count -= 1; });
+    ExpectInvalid("string bytes past their offsets", bytes, [](Image& i) {
+        i.header()->sections[tsSexprImageStringBytes].count -= 1;
+    });
+
+    SexprImage view(intact.data(), intact.size);
+    auto find = [&](int token) {
+        for (size_t i = 0; i < view.expr.size(); ++i)
+            if (view.expr[i].token == token)
+                return i;
+        return view.expr.size();
+    };
+    size_t intAt = find(tsSexprInteger), floatAt = find(tsSexprFloat), stringAt = find(tsSexprString);
+    size_t atomAt = find(tsSexprAtom), pushAt = find(tsSexprPushList);
+    size_t innerAt = pushAt + 1;    // a list inside the first
+    while (view.expr[innerAt].token != tsSexprPushList)
+        ++innerAt;
+    size_t ints = view.ints.size(), floats = view.floats.size(), lists = view.lists.size();
+    size_t atoms = symbols ? view.SymbolCount() : view.expr.size();
+
+    ExpectInvalid("an int ref past the ints", bytes, [&](Image& i) { i.section<Sexpr::Elem>(tsSexprImageExpr)[intAt].ref = (int) ints; });
+    ExpectInvalid("a float ref past the floats", bytes, [&](Image& i) { i.section<Sexpr::Elem>(tsSexprImageExpr)[floatAt].ref = (int) floats; });
+    ExpectInvalid("a negative string ref", bytes, [&](Image& i) { i.section<Sexpr::Elem>(tsSexprImageExpr)[stringAt].ref = -1; });
+    ExpectInvalid("an atom ref past the atoms", bytes, [&](Image& i) { i.section<Sexpr::Elem>(tsSexprImageExpr)[atomAt].ref = (int) atoms + 1000; });
+    ExpectInvalid("a list ref past the lists", bytes, [&](Image& i) { i.section<Sexpr::Elem>(tsSexprImageExpr)[pushAt].ref = (int) lists; });
+    ExpectInvalid("an unknown token", bytes, [&](Image& i) { i.section<Sexpr::Elem>(tsSexprImageExpr)[intAt].token = 7; });
+    ExpectInvalid("a list whose end has moved", bytes, [&](Image& i) {
+        i.section<Sexpr::List>(tsSexprImageLists)[view.expr[innerAt].ref].end -= 1;
+    });
+    ExpectInvalid("a list ending past its parent", bytes, [&](Image& i) {
+        i.section<Sexpr::List>(tsSexprImageLists)[view.expr[innerAt].ref].end = (uint32_t) view.expr.size();
+    });
+    ExpectInvalid("a list with the wrong child count", bytes, [&](Image& i) {
+        i.section<Sexpr::List>(tsSexprImageLists)[view.expr[pushAt].ref].count += 1;
+    });
+    ExpectInvalid("a list that begins elsewhere", bytes, [&](Image& i) {
+        i.section<Sexpr::List>(tsSexprImageLists)[view.expr[innerAt].ref].begin += 1;
+    });
+    ExpectInvalid("a ) that closes another list", bytes, [&](Image& i) {
+        Sexpr::Elem* expr = i.section<Sexpr::Elem>(tsSexprImageExpr);
+        expr[view.Match(innerAt)].ref = view.expr[pushAt].ref;
+    });
+    ExpectInvalid("decreasing string offsets", bytes, [](Image& i) {
+        uint64_t* offsets = i.section<uint64_t>(tsSexprImageStringOffsets);
+        std::swap(offsets[1], offsets[2]);
+        offsets[1] += 1;
+    });
+    ExpectInvalid("string offsets that start past zero", bytes, [](Image& i) {
+        i.section<uint64_t>(tsSexprImageStringOffsets)[0] = 1;
+    });
+    if (symbols) {
+        ExpectInvalid("decreasing symbol offsets", bytes, [](Image& i) {
+            uint64_t* offsets = i.section<uint64_t>(tsSexprImageSymbolOffsets);
+            offsets[1] = offsets[2] + 1;
+        });
+        ExpectInvalid("symbol bytes past their offsets", bytes, [](Image& i) {
+            i.header()->sections[tsSexprImageSymbolBytes].count += 1;
+        });
+    }
+
+    // the same bytes at an address that is not 8 byte aligned
+    std::vector<char> shifted(bytes.size() + 8);
+    char* at = shifted.data() + ((8 - reinterpret_cast<uintptr_t>(shifted.data()) % 8) % 8) + 4;
+    memcpy(at, bytes.data(), bytes.size());
+    if (SexprImage(at, bytes.size()).Valid())
+        Fail("a misaligned image opens");
+    if (SexprImage(nullptr, 0).Valid() || SexprImage().Valid())
+        Fail("no image opens");
+}
+
+int main() {
+    StrView text(source, strlen(source));
+    for (int bits = 0; bits < 16; ++bits) {
+        SymbolTable symbols;
+        SexprOptions options;
+        options.zeroCopy = (bits & 1) != 0;
+        options.unescapeStrings = (bits & 2) != 0;
+        options.lazyNumbers = (bits & 4) != 0;
+        options.symbols = (bits & 8) ? &symbols : nullptr;
+        Sexpr sexpr(text, options);
+
+        std::string bytes;
+        sexpr.WriteImage(bytes, text);
+        Image image(bytes);
+        SexprImage view(image.data(), image.size);
+        CompareTables(sexpr, view);
+
+        // the source it was written from, and any other
+        std::string stale(source);
+        stale[stale.find("869")] = '7';
+        if (!view.Matches(text) || view.Matches(StrView(stale.c_str(), stale.size())))
+            Fail("Matches does not tell the source from a stale one");
+
+        if (bits == 0 || bits == 8)
+            TestDamage(bytes, options.symbols != nullptr);
+    }
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,187 @@
+
+// Checks KeywordIndex: the span of each keyword's values, keywords given
+// more than once followed through Next, empty spans in the middle and at the
+// end of a list, nested lists inside a span, keywords of nested lists kept
+// to their own list, and keywords that are not found; by name and by symbol
+// id, with and without a SymbolTable on the document, and over enough lists
+// that the hash table grows.
+
+#include <LabText/LabText.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace lab::Text;
+
+static int failures = 0;
+
+static char const* source = R"(
+(node :name "osc" :pos 1 (2 (3 :inner 4)) 5 :tag x :tag y (z w) :tag :empty :last)
+(node :name "amp" : notakeyword :tag only (sub :tag nested) ; a comment
+    :pos 7.5)
+(bare list with no keywords)
+()
+)";
+
+// Elements begin to end as compact text.
+static std::string Render(Sexpr const& sexpr, size_t begin, size_t end) {
+    std::string out;
+    for (size_t i = begin; i < end; ++i) {
+        Sexpr::Elem const& e = sexpr.expr[i];
+        if (!out.empty() && out.back() != '(' && e.token != tsSexprPopList)
+            out += ' ';
+        char buf[32];
+        switch (e.token) {
+        case tsSexprPushList: out += '('; break;
+        case tsSexprPopList: out += ')'; break;
+        case tsSexprInteger:
+            snprintf(buf, sizeof(buf), "%lld", (long long) sexpr.Int(e.ref));
+            out += buf;
+            break;
+        case tsSexprFloat:
+            snprintf(buf, sizeof(buf), "%g", sexpr.Float(e.ref));
+            out += buf;
+            break;
+        case tsSexprString: {
+            StrView text = sexpr.Text(e);
+            out += '"';
+            out.append(text.curr, text.sz);
+            out += '"';
+            break;
+        }
+        default: {
+            StrView text = sexpr.Text(e);
+            out.append(text.curr, text.sz);
+        }
+        }
+    }
+    return out;
+}
+
+// Every span of keyword in the list, followed through Next, rendered and
+// separated by " | ", or "none" if the keyword is not found.
+static std::string Spans(Sexpr const& sexpr, KeywordIndex const& index, size_t list, char const* keyword) {
+    KeywordIndex::Span span = index.At(list)[keyword];
+    if (!span.Found())
+        return "none";
+    std::string out;
+    for (; span.Found(); span = index.Next(span)) {
+        if (!out.empty())
+            out += " | ";
+        out += span.Empty() ? "<empty>" : Render(sexpr, span.begin, span.end);
+    }
+    return out;
+}
+
+// The expr index of the nth list in document order.
+static size_t ListAt(Sexpr const& sexpr, size_t n) {
+    return sexpr.lists[n].begin;
+}
+
+struct Case {
+    size_t list;
+    char const* keyword;
+    char const* expected;
+};
+
+static Case const cases[] = {
+    { 0, ":name", "\"osc\"" },
+    // a span holds nested lists whole, and their keywords are their own
+    { 0, ":pos", "1 (2 (3 :inner 4)) 5" },
+    { 0, ":inner", "none" },
+    { 2, ":inner", "4" },
+    // a repeated keyword, with an empty span between keywords
+    { 0, ":tag", "x | y (z w) | <empty>" },
+    { 0, ":empty", "<empty>" },
+    // and at the end of the list
+    { 0, ":last", "<empty>" },
+    { 0, ":missing", "none" },
+    { 3, ":tag", "none" },
+    // a lone ':' is not a keyword, and a comment is not a value
+    { 4, ":name", "\"amp\" : notakeyword" },
+    { 4, ":tag", "only (sub :tag nested)" },
+    { 5, ":tag", "nested" },
+    { 4, ":pos", "7.5" },
+    { 6, ":name", "none" },
+    { 7, ":name", "none" },
+};
+
+static void Check(SexprOptions options, bool documentSymbols) {
+    SymbolTable symbols;
+    options.symbols = documentSymbols ? &symbols : nullptr;
+    Sexpr sexpr(StrView(source, strlen(source)), options);
+    if (sexpr.status != tsSexprOk || sexpr.lists.size() != 8) {
+        printf("the document does not parse\n");
+        ++failures;
+        return;
+    }
+    KeywordIndex index(sexpr, symbols);
+
+    for (Case const& c : cases) {
+        size_t list = ListAt(sexpr, c.list);
+        std::string got = Spans(sexpr, index, list, c.keyword);
+        if (got != c.expected && failures++ < 20)
+            printf("list %zu %s (zeroCopy %d symbols %d)\n  want %s\n  got  %s\n", c.list, c.keyword,
+                   options.zeroCopy, documentSymbols, c.expected, got.c_str());
+
+        // by symbol id, as by name
+        uint32_t id = symbols.Find(StrView(c.keyword));
+        KeywordIndex::Span byName = index.Find(list, StrView(c.keyword));
+        KeywordIndex::Span byId = id == SymbolTable::NoSymbol ? KeywordIndex::Span() : index.At(list)[id];
+        if (byName.Found() != byId.Found() || byName.begin != byId.begin || byName.end != byId.end) {
+            printf("list %zu %s differs by symbol id (symbols %d)\n", c.list, c.keyword, documentSymbols);
+            ++failures;
+        }
+    }
+
+    // a keyword no document uses is not in the table at all
+    if (index.Find(ListAt(sexpr, 0), StrView(":never")).Found()) {
+        printf("a keyword that was never interned is found\n");
+        ++failures;
+    }
+}
+
+// Enough lists to grow the table, each with its own values for shared keywords.
+static void CheckMany(bool documentSymbols) {
+    std::string doc;
+    int const count = 5000;
+    for (int i = 0; i < count; ++i)
+        doc += "(item :id " + std::to_string(i) + " :twice " + std::to_string(i) + " :twice " + std::to_string(-i) + ")\n";
+    SymbolTable symbols;
+    SexprOptions options;
+    options.symbols = documentSymbols ? &symbols : nullptr;
+    Sexpr sexpr(StrView(doc.c_str(), doc.size()), options);
+    KeywordIndex index(sexpr, symbols);
+    if (index.Size() != (size_t) count * 3) {
+        printf("%zu entries for %d lists of three keywords\n", index.Size(), count);
+        ++failures;
+    }
+    for (int i = 0; i < count; ++i) {
+        KeywordIndex::Form form = index.At(ListAt(sexpr, i));
+        KeywordIndex::Span id = form[":id"];
+        KeywordIndex::Span first = form[":twice"];
+        KeywordIndex::Span second = index.Next(first);
+        bool ok = id.Found() && id.end == id.begin + 1 && sexpr.Int(sexpr.expr[id.begin].ref) == i
+               && second.Found() && sexpr.Int(sexpr.expr[first.begin].ref) == i
+               && sexpr.Int(sexpr.expr[second.begin].ref) == -i && !index.Next(second).Found();
+        if (!ok) {
+            printf("list %d of %d has the wrong spans (symbols %d)\n", i, count, documentSymbols);
+            ++failures;
+            break;
+        }
+    }
+}
+
+int main() {
+    for (int bits = 0; bits < 4; ++bits) {
+        SexprOptions options;
+        options.zeroCopy = (bits & 1) != 0;
+        Check(options, (bits & 2) != 0);
+    }
+    CheckMany(false);
+    CheckMany(true);
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,192 @@
+
+// Checks Sexpr's lazy numbers against an eager parse of the same document:
+// a number is converted when it is first read, its value is kept and its
+// span marked decoded, and the numbers not read are left alone; then that
+// DecodeAllNumbers, on one thread and on several, converts the rest to the
+// eager values and releases the spans, and that WriteImage does the same.
+
+#include <LabText/LabText.h>
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace lab::Text;
+
+static int failures = 0;
+
+static void Fail(std::string const& what) {
+    if (failures++ < 20)
+        printf("%s\n", what.c_str());
+}
+
+static char const* numbers[] = {
+    "0", "-0", "42", "-17", "+8", "9223372036854775807", "-9223372036854775808", "000123",
+    "1.5", "-0.0", ".25", "7.", "1e10", "-2.5E-3", "1e999", "-1e999", "5e-324", "2.2250738585072011e-308",
+    "3.14159265358979323846264338327950288", "123456789012345678901234567890.5",
+};
+
+// Enough numbers, in forms with atoms and strings, that DecodeAllNumbers
+// uses several threads, and that a parallel parse cuts the document.
+static std::string Document() {
+    std::mt19937 rng(24);
+    std::string doc;
+    while (doc.size() < (3u << 20)) {
+        doc += "(row \"s\" ";
+        for (int i = 0; i < 8; ++i) {
+            doc += numbers[rng() % (sizeof(numbers) / sizeof(numbers[0]))];
+            doc += ' ';
+            doc += std::to_string((int) rng() % 100000);
+            doc += rng() % 2 ? " x " : " ";
+        }
+        doc += ")\n";
+    }
+    return doc;
+}
+
+static bool Same(double a, double b) {
+    return !memcmp(&a, &b, sizeof(a));
+}
+
+// The lazy document's values, read through Int and Float, are the eager ones.
+static bool ValuesMatch(Sexpr const& lazy, Sexpr const& eager) {
+    for (size_t r = 0; r < eager.ints.size(); ++r)
+        if (lazy.Int((int) r) != eager.ints[r])
+            return false;
+    for (size_t r = 0; r < eager.floats.size(); ++r)
+        if (!Same(lazy.Float((int) r), eager.floats[r]))
+            return false;
+    return true;
+}
+
+static bool Released(Sexpr const& lazy) {
+    return lazy.intSpans.empty() && lazy.floatSpans.empty() && !lazy.intSpans.capacity() && !lazy.floatSpans.capacity();
+}
+
+// Numbers read one at a time, in a random order.
+static void CheckOnDemand(std::string doc, Sexpr const& eager) {
+    SexprOptions options;
+    options.lazyNumbers = true;
+    options.threads = 1;
+    Sexpr lazy(StrView(doc.c_str(), doc.size()), options);
+    if (lazy.expr.size() != eager.expr.size() || memcmp(lazy.expr.data(), eager.expr.data(), eager.expr.size() * sizeof(Sexpr::Elem))) {
+        Fail("a lazy parse has other elements than an eager one");
+        return;
+    }
+    // nothing is converted while parsing, and every span is the text of its number
+    if (!lazy.ints.empty() || !lazy.floats.empty() || lazy.intSpans.size() != eager.ints.size()
+        || lazy.floatSpans.size() != eager.floats.size())
+        Fail("a lazy parse converted its numbers");
+    for (Sexpr::NumberSpan span : lazy.intSpans) {
+        int64_t v;
+        bool overflow;
+        char const* text = doc.c_str() + span.offset;
+        if (!span.size || tsGetInt64(text, text + span.size, &v, &overflow) != text + span.size) {
+            Fail("an integer's span is not the text of an integer");
+            break;
+        }
+    }
+
+    std::mt19937 rng(7);
+    for (int i = 0; i < 2000; ++i) {
+        bool isInt = rng() % 2;
+        size_t count = isInt ? eager.ints.size() : eager.floats.size();
+        int r = (int) (rng() % count);
+        Sexpr::NumberSpan span = isInt ? lazy.intSpans[r] : lazy.floatSpans[r];
+        bool decoded = span.size == 0;
+        bool ok = isInt ? lazy.Int(r) == eager.ints[r] : Same(lazy.Float(r), eager.floats[r]);
+        Sexpr::NumberSpan after = isInt ? lazy.intSpans[r] : lazy.floatSpans[r];
+        if (!ok || after.size != 0) {
+            Fail(std::string(isInt ? "integer " : "float ") + std::to_string(r) + " reads wrongly on demand");
+            continue;
+        }
+        if (!decoded) {
+            // the value is kept: its text can change and it reads the same
+            memset(&doc[span.offset], '9', span.size);
+            bool same = isInt ? lazy.Int(r) == eager.ints[r] : Same(lazy.Float(r), eager.floats[r]);
+            if (!same)
+                Fail(std::string(isInt ? "integer " : "float ") + std::to_string(r) + " was decoded again");
+        }
+    }
+    // values are stored once the first is read, and the numbers not read are still spans
+    size_t left = 0;
+    for (Sexpr::NumberSpan span : lazy.intSpans)
+        left += span.size != 0;
+    if (lazy.ints.size() != eager.ints.size() || lazy.floats.size() != eager.floats.size() || !left)
+        Fail("the values read on demand are not stored as expected");
+}
+
+// The numbers not read are converted by DecodeAllNumbers, or by WriteImage.
+static void CheckDecodeAll(std::string const& doc, Sexpr const& eager, unsigned threads, unsigned decodeThreads,
+                           bool image) {
+    SexprOptions options;
+    options.lazyNumbers = true;
+    options.threads = threads;
+    Sexpr lazy(StrView(doc.c_str(), doc.size()), options);
+    if (lazy.intSpans.size() != eager.ints.size() || lazy.floatSpans.size() != eager.floats.size()) {
+        Fail("a lazy parse on " + std::to_string(threads) + " threads has other spans");
+        return;
+    }
+    // a few read first, which DecodeAllNumbers leaves as they are
+    for (int r = 0; r < 1000; r += 7) {
+        lazy.Int(r);
+        lazy.Float(r * 3);
+    }
+    std::string bytes;
+    if (image)
+        lazy.WriteImage(bytes, StrView(doc.c_str(), doc.size()));
+    else
+        lazy.DecodeAllNumbers(decodeThreads);
+
+    std::string what = (image ? "WriteImage" : "DecodeAllNumbers on " + std::to_string(decodeThreads) + " threads")
+                     + ", parsed on " + std::to_string(threads);
+    if (!Released(lazy))
+        Fail(what + " leaves the spans");
+    if (lazy.ints != eager.ints || lazy.floats.size() != eager.floats.size()
+        || memcmp(lazy.floats.data(), eager.floats.data(), eager.floats.size() * sizeof(double)) || !ValuesMatch(lazy, eager))
+        Fail(what + " gives other values");
+    if (image) {
+        std::vector<uint64_t> aligned((bytes.size() + 7) / 8);
+        memcpy(aligned.data(), bytes.data(), bytes.size());
+        SexprImage view(reinterpret_cast<char const*>(aligned.data()), bytes.size());
+        if (!view.Valid() || view.ints.size() != eager.ints.size() || view.floats.size() != eager.floats.size()
+            || memcmp(view.ints.begin(), eager.ints.data(), eager.ints.size() * sizeof(int64_t))
+            || memcmp(view.floats.begin(), eager.floats.data(), eager.floats.size() * sizeof(double)))
+            Fail(what + " writes other numbers");
+    }
+    // a second call has nothing left to do
+    lazy.DecodeAllNumbers(decodeThreads);
+    if (!ValuesMatch(lazy, eager))
+        Fail(what + ", decoded twice, gives other values");
+}
+
+int main() {
+    std::string doc = Document();
+    SexprOptions options;
+    options.threads = 1;
+    Sexpr eager(StrView(doc.c_str(), doc.size()), options);
+    if (eager.status != tsSexprOk || eager.ints.size() + eager.floats.size() < (4u << 16)) {
+        printf("the document does not parse (status %d), or has too few numbers (%zu, %zu)\n", eager.status,
+               eager.ints.size(), eager.floats.size());
+        return 1;
+    }
+
+    CheckOnDemand(doc, eager);
+    for (unsigned threads : { 1u, 4u })
+        for (unsigned decodeThreads : { 1u, 2u, 5u, 0u })
+            CheckDecodeAll(doc, eager, threads, decodeThreads, false);
+    CheckDecodeAll(doc, eager, 1, 0, true);
+    CheckDecodeAll(doc, eager, 4, 0, true);
+
+    // numbers in a document too small to cut, decoded on more threads than it has numbers
+    std::string small = "(1 2.5 -3 .5)";
+    options.lazyNumbers = true;
+    Sexpr few(StrView(small.c_str(), small.size()), options);
+    few.DecodeAllNumbers(8);
+    if (!Released(few) || few.ints != std::vector<int64_t>{ 1, -3 } || few.floats != std::vector<double>{ 2.5, 0.5 })
+        Fail("a small lazy document decodes wrongly");
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
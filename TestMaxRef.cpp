@@ -0,0 +1,131 @@
+
+// Checks that a Sexpr whose refs outgrow Sexpr::MaxRef stops with
+// tsSexprErrorMemory at the token that would not fit, in each table, on
+// both parsers and in the parallel splice. MaxRef is lowered so that small
+// documents reach it; the implementation is compiled here to match.
+
+#define LABTEXT_SEXPR_MAX_REF 100
+#define LABTEXT_ODR
+#include <LabText/LabText.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using namespace lab::Text;
+
+static int failures = 0;
+static constexpr int Limit = Sexpr::MaxRef + 1;    // entries a table may hold
+
+// Every element's ref indexes an entry of its table.
+static bool RefsValid(Sexpr const& sexpr) {
+    for (Sexpr::Elem const& e : sexpr.expr) {
+        size_t size;
+        switch (e.token) {
+        case tsSexprPushList: size = sexpr.lists.size(); break;
+        case tsSexprPopList: size = e.ref < 0 ? 1 : sexpr.lists.size(); break;
+        case tsSexprInteger: size = sexpr.lazyNumbers ? sexpr.intSpans.size() : sexpr.ints.size(); break;
+        case tsSexprFloat: size = sexpr.lazyNumbers ? sexpr.floatSpans.size() : sexpr.floats.size(); break;
+        case tsSexprAtom:
+            if (sexpr.symbols) {
+                size = sexpr.symbols->Size();
+                break;
+            }
+            // fall through
+        default: size = sexpr.zeroCopy ? sexpr.views.size() : sexpr.strings.size(); break;
+        }
+        if (e.ref >= 0 && static_cast<size_t>(e.ref) >= size)
+            return false;
+    }
+    return true;
+}
+
+// A document of count tokens made by item(i), inside one list, or as count
+// top-level lists when item is null. at receives the offset of each token.
+static std::string Document(int count, std::string (*item)(int), std::vector<size_t>& at) {
+    std::string doc = item ? "(" : "";
+    at.clear();
+    for (int i = 0; i < count; ++i) {
+        at.push_back(doc.size());
+        doc += item ? item(i) + " " : std::string("()\n");
+    }
+    return item ? doc + ")" : doc;
+}
+
+static std::string Atom(int i) { return "a" + std::to_string(i); }
+static std::string String(int i) { return "\"s" + std::to_string(i) + "\\n\""; }
+static std::string Int(int i) { return std::to_string(i); }
+static std::string Float(int i) { return std::to_string(i) + ".5"; }
+
+static void Check(char const* name, std::string (*item)(int), SexprOptions options) {
+    // each kind of item has a table of its own, as has the list around them
+    int fits = Limit;
+    for (int count : { fits, fits + 1 }) {
+        SymbolTable symbols;
+        if (options.symbols)
+            options.symbols = &symbols;
+        std::vector<size_t> at;
+        std::string doc = Document(count, item, at);
+        Sexpr sexpr(StrView(doc.c_str(), doc.size()), options);
+        bool over = count > fits;
+        bool ok = over ? sexpr.status == tsSexprErrorMemory && sexpr.errorOffset == at[fits]
+                       : sexpr.status == tsSexprOk;
+        if (!ok || !RefsValid(sexpr)) {
+            if (failures++ < 10)
+                printf("%s, %d of them (level %d zeroCopy %d unescape %d lazy %d symbols %d): status %d at %zu\n",
+                       name, count, tsGetSimdLevel(), options.zeroCopy, options.unescapeStrings, options.lazyNumbers,
+                       options.symbols != nullptr, sexpr.status, sexpr.errorOffset);
+        }
+    }
+}
+
+// Pieces of a parallel parse that each fit, but not together. The splice
+// stops where the piece that would not fit begins, which is at or before
+// the token the serial parse stops at.
+static void CheckParallel() {
+    std::string padding = ";" + std::string(6000, 'p') + "\n";
+    std::string doc;
+    std::vector<size_t> at;
+    while (doc.size() < (1u << 20) + (1u << 18)) {
+        at.push_back(doc.size());
+        doc += "(x " + padding + ")\n";
+    }
+    SexprOptions options;
+    options.threads = 4;
+    Sexpr parallel(StrView(doc.c_str(), doc.size()), options);
+    options.threads = 1;
+    Sexpr serial(StrView(doc.c_str(), doc.size()), options);
+    if (serial.status != tsSexprErrorMemory || serial.errorOffset != at[Limit]) {
+        printf("serial parse of %zu lists: status %d at %zu\n", at.size(), serial.status, serial.errorOffset);
+        ++failures;
+    }
+    if (parallel.status != tsSexprErrorMemory || parallel.errorOffset > serial.errorOffset
+        || doc[parallel.errorOffset] != '(' || parallel.lists.size() > (size_t) Limit || !RefsValid(parallel)) {
+        printf("parallel parse of %zu lists: status %d at %zu, %zu lists\n", at.size(), parallel.status,
+               parallel.errorOffset, parallel.lists.size());
+        ++failures;
+    }
+}
+
+int main() {
+    for (int level = tsSimdScalar; level <= tsSimdNEON; ++level) {
+        if (tsSetSimdLevel((tsSimdLevel_t) level) != (tsSimdLevel_t) level)
+            continue;
+        for (int bits = 0; bits < 16; ++bits) {
+            SymbolTable marker;     // Check makes a fresh table; this only turns it on
+            SexprOptions options;
+            options.zeroCopy = (bits & 1) != 0;
+            options.unescapeStrings = (bits & 2) != 0;
+            options.lazyNumbers = (bits & 4) != 0;
+            options.symbols = (bits & 8) ? &marker : nullptr;
+            Check("lists", nullptr, options);
+            Check("atoms", Atom, options);
+            Check("strings", String, options);
+            Check("ints", Int, options);
+            Check("floats", Float, options);
+        }
+    }
+    CheckParallel();
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
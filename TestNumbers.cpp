@@ -0,0 +1,362 @@
+
+// Checks the integer readers at the edges of their ranges: tsGetInt64 and
+// tsGetUInt64 either side of their limits, with leading zeros, and with a
+// sign and no digits, and the clamp of tsGetInt32 and tsGetUInt32.
+//
+// Checks the bulk number readers, tsParseDoubles, tsParseFloats and
+// tsParseInts, and their StrView forms: separators before, between and after
+// the values, a full array, where reading stops on a token that is not a
+// number, integers past 64 bits, and that each value read is the one
+// tsGetDouble, tsGetFloat or strtoll gives for its token alone.
+
+#include <LabText/LabText.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace lab::Text;
+
+static int failures = 0;
+
+static void Fail(std::string const& what) {
+    if (failures++ < 20)
+        printf("%s\n", what.c_str());
+}
+
+// An integer reader's result: the value, whether it overflowed, and how
+// many bytes it read, 0 when it returns where it began.
+template <class T>
+struct IntCase {
+    char const* text;
+    T value;
+    bool overflow;
+    size_t read;
+};
+
+static std::vector<IntCase<int64_t>> const int64Cases = {
+    { "9223372036854775807", INT64_MAX, false, 19 },
+    { "9223372036854775806", INT64_MAX - 1, false, 19 },
+    { "9223372036854775808", INT64_MAX, true, 19 },
+    { "+9223372036854775808", INT64_MAX, true, 20 },
+    { "-9223372036854775808", INT64_MIN, false, 20 },
+    { "-9223372036854775807", INT64_MIN + 1, false, 20 },
+    { "-9223372036854775809", INT64_MIN, true, 20 },
+    // 20 digits past UINT64_MAX, and more digits than fit at all
+    { "18446744073709551616", INT64_MAX, true, 20 },
+    { "-18446744073709551616", INT64_MIN, true, 21 },
+    { "99999999999999999999999", INT64_MAX, true, 23 },
+    { "-99999999999999999999999", INT64_MIN, true, 24 },
+    // leading zeros do not count towards the digits
+    { "0000000000000000000000009223372036854775807", INT64_MAX, false, 43 },
+    { "-0000000000000000000000009223372036854775809", INT64_MIN, true, 44 },
+    { "+0000000000000000000000042", 42, false, 26 },
+    { "000000000000000000000000", 0, false, 24 },
+    { "-0", 0, false, 2 },
+    // white space before, and the first byte that is not a digit after
+    { " \t12abc", 12, false, 4 },
+    { "-7-", -7, false, 2 },
+    // a sign, or nothing, with no digits is not read
+    { "-", 0, false, 0 },
+    { "+", 0, false, 0 },
+    { "", 0, false, 0 },
+    { "  -x", 0, false, 0 },
+    { "- 1", 0, false, 0 },
+    { "+-1", 0, false, 0 },
+};
+
+static std::vector<IntCase<uint64_t>> const uint64Cases = {
+    { "18446744073709551615", UINT64_MAX, false, 20 },
+    { "18446744073709551614", UINT64_MAX - 1, false, 20 },
+    { "18446744073709551616", UINT64_MAX, true, 20 },
+    { "28446744073709551615", UINT64_MAX, true, 20 },
+    { "184467440737095516150", UINT64_MAX, true, 21 },
+    { "9999999999999999999", 9999999999999999999ull, false, 19 },
+    { "00000000000000000000000018446744073709551615", UINT64_MAX, false, 44 },
+    { "00000000000000000000000018446744073709551616", UINT64_MAX, true, 44 },
+    { "0", 0, false, 1 },
+    // the unsigned reader takes no sign
+    { "-1", 0, false, 0 },
+    { "+1", 0, false, 0 },
+    { "", 0, false, 0 },
+};
+
+static std::vector<IntCase<int32_t>> const int32Cases = {
+    { "2147483647", INT32_MAX, false, 10 },
+    { "2147483648", INT32_MAX, false, 10 },
+    { "-2147483648", INT32_MIN, false, 11 },
+    { "-2147483649", INT32_MIN, false, 11 },
+    { "9223372036854775808", INT32_MAX, false, 19 },
+    { "-99999999999999999999", INT32_MIN, false, 21 },
+    { "-", 0, false, 0 },
+};
+
+static std::vector<IntCase<uint32_t>> const uint32Cases = {
+    { "4294967295", UINT32_MAX, false, 10 },
+    { "4294967296", UINT32_MAX, false, 10 },
+    { "18446744073709551616", UINT32_MAX, false, 20 },
+    { "0", 0, false, 1 },
+    { "-1", 0, false, 0 },
+};
+
+// A value not read leaves the result, and the overflow flag, as they were.
+// Readers without a flag are only called without one.
+template <class T, class Reader>
+static void CheckInts(char const* name, std::vector<IntCase<T>> const& cases, bool flag, Reader read) {
+    for (IntCase<T> const& c : cases) {
+        char const* end = c.text + strlen(c.text);
+        for (bool given : { false, flag }) {
+            T value = (T) 99;
+            bool overflow = !c.overflow;
+            char const* next = read(c.text, end, &value, given ? &overflow : nullptr);
+            bool ok = (size_t) (next - c.text) == c.read && value == (c.read ? c.value : (T) 99);
+            if (given)
+                ok = ok && overflow == (c.read ? c.overflow : !c.overflow);
+            if (!ok)
+                Fail(std::string(name) + " '" + c.text + "': read " + std::to_string(next - c.text) + " bytes as "
+                     + std::to_string(value) + (given && overflow ? ", overflowed" : ""));
+        }
+    }
+}
+
+static void CheckIntegers() {
+    CheckInts("tsGetInt64", int64Cases, true, [](char const* p, char const* end, int64_t* v, bool* o) {
+        return tsGetInt64(p, end, v, o);
+    });
+    CheckInts("tsGetUInt64", uint64Cases, true, [](char const* p, char const* end, uint64_t* v, bool* o) {
+        return tsGetUInt64(p, end, v, o);
+    });
+    // the 32 bit readers clamp, and have no flag
+    CheckInts("tsGetInt32", int32Cases, false, [](char const* p, char const* end, int32_t* v, bool*) {
+        return tsGetInt32(p, end, v);
+    });
+    CheckInts("tsGetUInt32", uint32Cases, false, [](char const* p, char const* end, uint32_t* v, bool*) {
+        return tsGetUInt32(p, end, v);
+    });
+
+    // every value near the limits reads as strtoll and strtoull read it
+    char buf[64];
+    for (int64_t delta = -300; delta <= 300; ++delta) {
+        for (int64_t base : { INT64_MIN, (int64_t) 0, INT64_MAX }) {
+            int64_t v = (delta < 0 && base == INT64_MIN) || (delta > 0 && base == INT64_MAX) ? base : base + delta;
+            snprintf(buf, sizeof(buf), "%lld", (long long) v);
+            int64_t got = 0;
+            bool overflow = true;
+            tsGetInt64(buf, buf + strlen(buf), &got, &overflow);
+            if (got != v || overflow)
+                Fail(std::string("tsGetInt64 '") + buf + "' reads as " + std::to_string(got));
+        }
+        uint64_t u = UINT64_MAX - (uint64_t) (delta + 300);
+        snprintf(buf, sizeof(buf), "%llu", (unsigned long long) u);
+        uint64_t got = 0;
+        bool overflow = true;
+        tsGetUInt64(buf, buf + strlen(buf), &got, &overflow);
+        if (got != u || overflow)
+            Fail(std::string("tsGetUInt64 '") + buf + "' reads as " + std::to_string(got));
+    }
+}
+
+static CharSet const separators = CharSet(",;") | CharSet::WhiteSpace();
+
+// The values each reader gets from text with room for capacity of them, and
+// the offset each stops at; the StrView forms must agree with the C ones.
+struct Read {
+    std::vector<double> doubles;
+    std::vector<float> floats;
+    std::vector<int64_t> ints;
+    size_t stops[3];
+
+    Read(std::string const& text, size_t capacity) {
+        char const* begin = text.c_str();
+        char const* end = begin + text.size();
+        StrView view(begin, text.size());
+        // one more than capacity, to see that nothing is stored past it
+        doubles.assign(capacity + 1, -1);
+        floats.assign(capacity + 1, -1);
+        ints.assign(capacity + 1, -1);
+        char const* stop;
+        size_t count, viewCount;
+
+        count = tsParseDoubles(begin, end, &separators, doubles.data(), capacity, &stop);
+        stops[0] = stop - begin;
+        std::vector<double> d(capacity + 1, -1);
+        StrView rest = view.ParseDoubles(separators, d.data(), capacity, viewCount);
+        if (viewCount != count || rest.curr != stop || rest.curr + rest.sz != end || memcmp(d.data(), doubles.data(), d.size() * sizeof(double)))
+            Fail("StrView::ParseDoubles differs on '" + text + "'");
+        Trim(doubles, count, text, "doubles");
+
+        count = tsParseFloats(begin, end, &separators, floats.data(), capacity, &stop);
+        stops[1] = stop - begin;
+        std::vector<float> f(capacity + 1, -1);
+        rest = view.ParseFloats(separators, f.data(), capacity, viewCount);
+        if (viewCount != count || rest.curr != stop || memcmp(f.data(), floats.data(), f.size() * sizeof(float)))
+            Fail("StrView::ParseFloats differs on '" + text + "'");
+        Trim(floats, count, text, "floats");
+
+        count = tsParseInts(begin, end, &separators, ints.data(), capacity, &stop);
+        stops[2] = stop - begin;
+        std::vector<int64_t> i(capacity + 1, -1);
+        rest = view.ParseInts(separators, i.data(), capacity, viewCount);
+        if (viewCount != count || rest.curr != stop || memcmp(i.data(), ints.data(), i.size() * sizeof(int64_t)))
+            Fail("StrView::ParseInts differs on '" + text + "'");
+        Trim(ints, count, text, "ints");
+
+        // and without a stop
+        if (tsParseDoubles(begin, end, &separators, d.data(), capacity, nullptr) != doubles.size())
+            Fail("tsParseDoubles counts differently without a stop on '" + text + "'");
+    }
+
+    template <class T>
+    static void Trim(std::vector<T>& values, size_t count, std::string const& text, char const* kind) {
+        if (count > values.size() - 1 || values[values.size() - 1] != (T) -1)
+            Fail(std::string("values stored past capacity for ") + kind + " on '" + text + "'");
+        values.resize(count);
+    }
+};
+
+struct Case {
+    char const* text;
+    size_t capacity;
+    std::vector<double> doubles;    // as floats, and as ints when whole
+    size_t doubleStop;
+    std::vector<int64_t> ints;
+    size_t intStop;
+};
+
+static std::vector<Case> const cases = {
+    // separators before, between and after; the last are read while looking for another value
+    { "1,2,3", 8, { 1, 2, 3 }, 5, { 1, 2, 3 }, 5 },
+    { ",; 1 ,,\t2\n\n;3, ;", 8, { 1, 2, 3 }, 16, { 1, 2, 3 }, 16 },
+    { "", 8, {}, 0, {}, 0 },
+    { " ,;,\n", 8, {}, 5, {}, 5 },
+    { "  7", 8, { 7 }, 3, { 7 }, 3 },
+    // a long run of separators, past what is stepped over a byte at a time
+    { "1                                        2", 8, { 1, 2 }, 42, { 1, 2 }, 42 },
+    // a full array stops after its last value, before the separators that follow
+    { "1 2 3 4 5", 3, { 1, 2, 3 }, 5, { 1, 2, 3 }, 5 },
+    { "1 2 3 ", 3, { 1, 2, 3 }, 5, { 1, 2, 3 }, 5 },
+    { "1 2 3", 0, {}, 0, {}, 0 },
+    // a token that is not a number stops reading at its start
+    { "1 2 12abc 4", 8, { 1, 2 }, 4, { 1, 2 }, 4 },
+    { "12abc", 8, {}, 0, {}, 0 },
+    { "1, -, 2", 8, { 1 }, 3, { 1 }, 3 },
+    { "1 + 2", 8, { 1 }, 2, { 1 }, 2 },
+    { "1 x", 8, { 1 }, 2, { 1 }, 2 },
+    { "1 2.5.5", 8, { 1 }, 2, { 1 }, 2 },
+    // floats read as floats, and stop the integers
+    { "-1.5e3 .5 5. +2 -0", 8, { -1500, 0.5, 5, 2, -0.0 }, 18, {}, 0 },
+    { "4 1.5", 8, { 4, 1.5 }, 5, { 4 }, 2 },
+    { "1e999 -1e999", 8, { INFINITY, -INFINITY }, 12, {}, 0 },
+    // integers at and past the 64 bit limits
+    { "9223372036854775807 -9223372036854775808 9223372036854775808", 8,
+      { 9223372036854775807.0, -9223372036854775808.0, 9223372036854775808.0 }, 60,
+      { INT64_MAX, INT64_MIN }, 41 },
+    { "-9223372036854775809 1", 8, { -9223372036854775809.0, 1 }, 22, {}, 0 },
+    { "18446744073709551616 1", 8, { 18446744073709551616.0, 1 }, 22, {}, 0 },
+    { "+007 -000000000000000000000000042 00000000000000000000000000", 8, { 7, -42, 0 }, 60, { 7, -42, 0 }, 60 },
+};
+
+static bool SameDouble(double a, double b) {
+    return !memcmp(&a, &b, sizeof(a));
+}
+
+static void CheckCases() {
+    for (Case const& c : cases) {
+        Read read(c.text, c.capacity);
+        bool ok = read.stops[0] == c.doubleStop && read.stops[1] == c.doubleStop && read.stops[2] == c.intStop
+               && read.doubles.size() == c.doubles.size() && read.floats.size() == c.doubles.size()
+               && read.ints == c.ints;
+        for (size_t i = 0; ok && i < c.doubles.size(); ++i)
+            ok = SameDouble(read.doubles[i], c.doubles[i]) && SameDouble(read.floats[i], (float) c.doubles[i]);
+        if (!ok) {
+            std::string got;
+            for (double d : read.doubles)
+                got += " " + std::to_string(d);
+            got += " |";
+            for (int64_t i : read.ints)
+                got += " " + std::to_string(i);
+            Fail(std::string("'") + c.text + "': read" + got + ", stopped at " + std::to_string(read.stops[0]) + " "
+                 + std::to_string(read.stops[1]) + " " + std::to_string(read.stops[2]));
+        }
+    }
+}
+
+// A decimal of up to 24 significant digits, with or without a point and an
+// exponent.
+static std::string RandomNumber(std::mt19937_64& rng) {
+    std::string s;
+    if (rng() % 2)
+        s += rng() % 4 ? "-" : "+";
+    size_t digits = 1 + rng() % 24;
+    size_t point = rng() % 3 ? rng() % (digits + 1) : digits + 1;
+    for (size_t i = 0; i < digits; ++i) {
+        if (i == point)
+            s += '.';
+        s += (char) ('0' + rng() % 10);
+    }
+    if (point == digits)
+        s += '.';
+    if (rng() % 3 == 0)
+        s += (rng() % 2 ? "e" : "E") + std::to_string((int) (rng() % 640) - 330);
+    return s;
+}
+
+// Each value read in bulk is the value its token reads as alone.
+static void CheckAgreement() {
+    static char const* gaps[] = { " ", ",", ", ", "\n", "\t;\t", "                    " };
+    std::mt19937_64 rng(25);
+    for (int round = 0; round < 2000; ++round) {
+        std::vector<std::string> tokens;
+        std::string text = rng() % 2 ? " " : "";
+        size_t n = 1 + rng() % 40;
+        for (size_t i = 0; i < n; ++i) {
+            tokens.push_back(RandomNumber(rng));
+            text += tokens.back() + gaps[rng() % 6];
+        }
+        Read read(text, n);
+        if (read.doubles.size() != n || read.floats.size() != n) {
+            Fail("read " + std::to_string(read.doubles.size()) + " of " + std::to_string(n) + " numbers from " + text);
+            continue;
+        }
+        size_t ints = 0;
+        for (size_t i = 0; i < n; ++i) {
+            char const* begin = tokens[i].c_str();
+            char const* end = begin + tokens[i].size();
+            double d;
+            float f;
+            // tsGetDouble and tsGetFloat leave integers to the integer readers
+            bool isFloat = tsGetDouble(begin, end, &d) == end;
+            if (isFloat)
+                tsGetFloat(begin, end, &f);
+            else {
+                d = strtod(begin, nullptr);
+                f = strtof(begin, nullptr);
+            }
+            if (!SameDouble(read.doubles[i], d) || memcmp(&read.floats[i], &f, sizeof(f)))
+                Fail(tokens[i] + " reads as " + std::to_string(read.doubles[i]) + " in bulk");
+
+            // the integers read until the first float or out of range value
+            errno = 0;
+            long long v = strtoll(begin, nullptr, 10);
+            if (ints == i && !isFloat && errno != ERANGE)
+                ++ints;
+            if (i < read.ints.size() && read.ints[i] != v)
+                Fail(tokens[i] + " reads as the integer " + std::to_string(read.ints[i]) + " in bulk");
+        }
+        if (read.ints.size() != ints)
+            Fail("read " + std::to_string(read.ints.size()) + " integers, not " + std::to_string(ints) + ", from " + text);
+    }
+}
+
+int main() {
+    CheckIntegers();
+    CheckCases();
+    CheckAgreement();
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,166 @@
+
+// Checks that a parallel Sexpr parse gives the same result as a serial one:
+// the same elements, tables, status and error offset, for documents large
+// enough to be cut into pieces, with errors placed in the later pieces, and
+// under every combination of the table options.
+
+#include <LabText/LabText.h>
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace lab::Text;
+
+static int failures = 0;
+
+static void Fail(char const* what, char const* doc, SexprOptions const& o) {
+    if (failures++ < 10)
+        printf("%s differs on the %s document (zeroCopy %d unescape %d lazy %d symbols %d)\n", what, doc,
+               o.zeroCopy, o.unescapeStrings, o.lazyNumbers, o.symbols != nullptr);
+}
+
+static std::string Form(std::mt19937& rng) {
+    static char const* items[] = {
+        "atom", "ls-node", ":name", "12", "-7", "3.25", "1e-3", "-0.5", "\"plain\"",
+        "\"esc \\\"q\\\" \\\\ \\n\"", "\xA7section \\\xA7 sign\xA7", "\xC2\xA7two byte\xC2\xA7",
+        "'(quoted list)", "(nested (deeper 1 2.5 \"s\"))", "; comment\n", "\n", "\t",
+    };
+    std::string form = "(form";
+    size_t n = 2 + rng() % 12;
+    for (size_t i = 0; i < n; ++i) {
+        form += ' ';
+        form += items[rng() % (sizeof(items) / sizeof(items[0]))];
+    }
+    return form + ")\n";
+}
+
+static std::string Document(std::mt19937& rng, size_t bytes) {
+    std::string doc;
+    while (doc.size() < bytes)
+        doc += Form(rng);
+    return doc;
+}
+
+// Inserts text before the top-level form that starts after at.
+static std::string InsertAt(std::string const& doc, size_t at, std::string const& text) {
+    size_t p = doc.find("\n(form", at);
+    return doc.substr(0, p + 1) + text + doc.substr(p + 1);
+}
+
+template <class T>
+static bool Equal(std::vector<T> const& a, std::vector<T> const& b) {
+    return a.size() == b.size() && (a.empty() || !memcmp(a.data(), b.data(), a.size() * sizeof(T)));
+}
+
+static void Compare(char const* name, std::string const& doc, SexprOptions options) {
+    StrView s(doc.c_str(), doc.size());
+    std::unique_ptr<SymbolTable> serialSymbols, parallelSymbols;
+    if (options.symbols) {
+        serialSymbols.reset(new SymbolTable());
+        parallelSymbols.reset(new SymbolTable());
+    }
+
+    options.threads = 1;
+    options.symbols = serialSymbols.get();
+    Sexpr serial(s, options);
+    options.threads = 4;
+    options.symbols = parallelSymbols.get();
+    Sexpr parallel(s, options);
+
+    if (serial.status != parallel.status)
+        Fail("status", name, options);
+    if (serial.status != tsSexprOk && serial.errorOffset != parallel.errorOffset)
+        Fail("errorOffset", name, options);
+    if (serial.balance != parallel.balance)
+        Fail("balance", name, options);
+    if (!Equal(serial.expr, parallel.expr))
+        Fail("expr", name, options);
+    if (serial.lists.size() != parallel.lists.size())
+        Fail("lists", name, options);
+    else
+        for (size_t i = 0; i < serial.lists.size(); ++i) {
+            Sexpr::List const& a = serial.lists[i];
+            Sexpr::List const& b = parallel.lists[i];
+            if (a.begin != b.begin || a.end != b.end || a.count != b.count) {
+                Fail("lists", name, options);
+                break;
+            }
+        }
+    if (!Equal(serial.ints, parallel.ints) || !Equal(serial.floats, parallel.floats))
+        Fail("numbers", name, options);
+    if (serial.intSpans.size() != parallel.intSpans.size() || serial.floatSpans.size() != parallel.floatSpans.size())
+        Fail("number spans", name, options);
+    else {
+        for (size_t i = 0; i < serial.intSpans.size(); ++i)
+            if (serial.Int((int) i) != parallel.Int((int) i)) {
+                Fail("lazy ints", name, options);
+                break;
+            }
+        for (size_t i = 0; i < serial.floatSpans.size(); ++i)
+            if (serial.Float((int) i) != parallel.Float((int) i)) {
+                Fail("lazy floats", name, options);
+                break;
+            }
+    }
+    if (serial.strings != parallel.strings)
+        Fail("strings", name, options);
+    if (serial.views.size() != parallel.views.size())
+        Fail("views", name, options);
+    else
+        for (size_t i = 0; i < serial.views.size(); ++i) {
+            StrView a = serial.views[i], b = parallel.views[i];
+            if (a.sz != b.sz || memcmp(a.curr, b.curr, a.sz)) {
+                Fail("views", name, options);
+                break;
+            }
+        }
+    if (serialSymbols) {
+        bool same = serialSymbols->Size() == parallelSymbols->Size();
+        for (uint32_t i = 0; same && i < serialSymbols->Size(); ++i) {
+            StrView a = serialSymbols->Name(i), b = parallelSymbols->Name(i);
+            same = a.sz == b.sz && !memcmp(a.curr, b.curr, a.sz);
+        }
+        if (!same)
+            Fail("symbols", name, options);
+    }
+}
+
+int main() {
+    std::mt19937 rng(14);
+    std::string doc = Document(rng, 5 << 18);
+
+    struct Case {
+        char const* name;
+        std::string text;
+        int maxDepth;
+    };
+    // each error past the first cuts; the cuts stop where the balance goes off
+    size_t late = doc.size() * 2 / 3;
+    std::string deep = "(" + std::string(40, '(') + "x" + std::string(40, ')') + ")\n";
+    std::vector<Case> cases = {
+        { "valid", doc, 0 },
+        { "stray paren", InsertAt(doc, late, ")\n"), 0 },
+        // quotes that pair with the next ones, so strings span the cuts
+        { "shifted quotes", InsertAt(doc, late, "(open \"x \xA7y\n"), 0 },
+        { "unterminated", doc + "(open (list \xA7never closed\n", 0 },
+        { "too deep", InsertAt(doc, late, deep), 16 },
+    };
+
+    for (Case const& c : cases)
+        for (int bits = 0; bits < 16; ++bits) {
+            SymbolTable marker;    // Compare makes fresh tables; this only turns them on
+            SexprOptions options;
+            options.maxDepth = c.maxDepth;
+            options.zeroCopy = (bits & 1) != 0;
+            options.unescapeStrings = (bits & 2) != 0;
+            options.lazyNumbers = (bits & 4) != 0;
+            options.symbols = (bits & 8) ? &marker : nullptr;
+            Compare(c.name, c.text, options);
+        }
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,194 @@
+
+// Checks SexprQuery: heads and *, string, atom, integer and float values,
+// an integer matching a float of the same value, descent through several
+// steps, the trailing keyword's values, and a step with 64 constraints, all
+// with the same results whether names compare as symbol ids or as text; and
+// that malformed queries, or a step with more than 64 constraints, are not
+// Valid.
+
+#include <LabText/LabText.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace lab::Text;
+
+static int failures = 0;
+
+static char const* source = R"(
+(graph :name "g"
+    (node :name "osc" :kind "Osc" :freq 440 :gain 0.5 :id 1)
+    (node :name "amp" :kind "Gain" :gain 1 :id 2 :tags a b (c d) e)
+    (node :name "out" :kind "Dest" :id 3.0)
+    (link :from "osc" :to "amp")
+    (group :name "sub"
+        (node :name "inner" :kind "Gain" :gain 1.0 :empty)
+        (group (node :name "deep" :kind x))))
+(node :name "top" :kind Gain) ; an atom, not a string
+)";
+
+// Elements begin to end as compact text.
+static std::string Render(Sexpr const& sexpr, size_t begin, size_t end) {
+    std::string out;
+    for (size_t i = begin; i < end; ++i) {
+        Sexpr::Elem const& e = sexpr.expr[i];
+        if (!out.empty() && out.back() != '(' && e.token != tsSexprPopList)
+            out += ' ';
+        char buf[32];
+        switch (e.token) {
+        case tsSexprPushList: out += '('; break;
+        case tsSexprPopList: out += ')'; break;
+        case tsSexprInteger:
+            snprintf(buf, sizeof(buf), "%lld", (long long) sexpr.Int(e.ref));
+            out += buf;
+            break;
+        case tsSexprFloat:
+            snprintf(buf, sizeof(buf), "%g", sexpr.Float(e.ref));
+            out += buf;
+            break;
+        case tsSexprString: {
+            StrView text = sexpr.Text(e);
+            out += '"';
+            out.append(text.curr, text.sz);
+            out += '"';
+            break;
+        }
+        default: {
+            StrView text = sexpr.Text(e);
+            out.append(text.curr, text.sz);
+        }
+        }
+    }
+    return out;
+}
+
+// Each match rendered, separated by " | ".
+static std::string Results(SexprQuery const& query, Sexpr const& sexpr) {
+    std::string out;
+    for (SexprQuery::Match const& m : query.Find(sexpr)) {
+        if (!out.empty())
+            out += " | ";
+        out += Render(sexpr, m.begin, m.end);
+    }
+    return out;
+}
+
+struct Case {
+    char const* query;
+    char const* expected;
+};
+
+static Case const cases[] = {
+    // strings, and an atom of the same text, are different values
+    { "(node :kind \"Gain\") :name", "\"amp\" | \"inner\"" },
+    { "(node :kind Gain) :name", "\"top\"" },
+    // integers and floats compare by value, either way round
+    { "(node :gain 1) :name", "\"amp\" | \"inner\"" },
+    { "(node :gain 1.0) :name", "\"amp\" | \"inner\"" },
+    { "(node :gain 0.5) :name", "\"osc\"" },
+    { "(node :id 3) :name", "\"out\"" },
+    { "(node :freq 440.0) :name", "\"osc\"" },
+    { "(node :id 4) :name", "" },
+    // * as head and as value, at any depth, in document order
+    { "(node :name *) :name", "\"osc\" | \"amp\" | \"out\" | \"inner\" | \"deep\" | \"top\"" },
+    { "(* :kind *) :kind", "\"Osc\" | \"Gain\" | \"Dest\" | \"Gain\" | x | Gain" },
+    { "(*) :from", "\"osc\"" },
+    { "(* :name \"sub\") (*) :kind", "\"Gain\"" },
+    // every constraint must hold, in any order
+    { "(node :kind \"Osc\" :name \"osc\" :id 1) :gain", "0.5" },
+    { "(node :name \"osc\" :kind \"Gain\")", "" },
+    { "(link :to \"amp\" :from \"osc\")", "(link :from \"osc\" :to \"amp\")" },
+    // later steps match direct children only
+    { "(graph) (node :kind \"Gain\") :name", "\"amp\"" },
+    { "(group) (node)", "(node :name \"inner\" :kind \"Gain\" :gain 1 :empty) | (node :name \"deep\" :kind x)" },
+    { "(graph) (group) (group) (node) :name", "\"deep\"" },
+    { "(graph) (group) (node :name \"deep\")", "" },
+    { "(graph) (node :name \"osc\") (x)", "" },
+    // the selected values run to the next keyword, and may be empty or missing
+    { "(node :name \"amp\") :tags", "a b (c d) e" },
+    { "(node :name \"inner\") :empty", "" },
+    { "(node :name \"osc\") :missing", "" },
+    { "(node :name \"osc\") :gain ; a trailing comment", "0.5" },
+};
+
+static char const* malformed[] = {
+    "", "; only a comment", "node", ":name", "()", "(\"node\")", "(1)", "((node))",
+    "(node :name)", "(node name \"x\")", "(node :name (x))", "(node) :name (x)", "(node) :a :b",
+    "(node", "(node))", "(node) \"x\"",
+};
+
+// A list with n keyword and value pairs, and a query for the first n of them
+// whose last value is last.
+static std::string Wide(int n) {
+    std::string out = "(wide";
+    for (int i = 0; i < n; ++i)
+        out += " :k" + std::to_string(i) + " " + std::to_string(i);
+    return out + ")";
+}
+static std::string WideQuery(int n, int last) {
+    std::string out = "(wide";
+    for (int i = 0; i < n; ++i)
+        out += " :k" + std::to_string(i) + " " + std::to_string(i + 1 < n ? i : last);
+    return out + ")";
+}
+
+// Runs every case against a document parsed with options; docSymbols and
+// querySymbols are the tables each is given, which may differ.
+static void Check(SexprOptions options, SymbolTable* docSymbols, SymbolTable* querySymbols) {
+    options.symbols = docSymbols;
+    Sexpr sexpr(StrView(source, strlen(source)), options);
+    if (sexpr.status != tsSexprOk) {
+        printf("the document does not parse\n");
+        ++failures;
+        return;
+    }
+    for (Case const& c : cases) {
+        SexprQuery query(StrView(c.query, strlen(c.query)), querySymbols);
+        std::string got = query.Valid() ? Results(query, sexpr) : "not valid";
+        if (got != c.expected && failures++ < 20)
+            printf("%s (zeroCopy %d lazy %d symbols %d/%d)\n  want %s\n  got  %s\n", c.query, options.zeroCopy,
+                   options.lazyNumbers, docSymbols != nullptr, querySymbols != nullptr, c.expected, got.c_str());
+    }
+
+    std::string wide = Wide(70);
+    Sexpr wideSexpr(StrView(wide.c_str(), wide.size()), options);
+    struct { int n, last; bool valid; size_t matches; } wides[] = {
+        { 63, 62, true, 1 }, { 64, 63, true, 1 }, { 64, 999, true, 0 }, { 65, 64, false, 0 }, { 70, 69, false, 0 },
+    };
+    for (auto const& w : wides) {
+        std::string text = WideQuery(w.n, w.last);
+        SexprQuery query(StrView(text.c_str(), text.size()), querySymbols);
+        if (query.Valid() != w.valid || (w.valid && query.Find(wideSexpr).size() != w.matches)) {
+            if (failures++ < 20)
+                printf("a step of %d constraints ending in %d: valid %d, %zu matches\n", w.n, w.last, query.Valid(),
+                       query.Valid() ? query.Find(wideSexpr).size() : 0);
+        }
+    }
+}
+
+int main() {
+    for (char const* text : malformed) {
+        SymbolTable symbols;
+        if (SexprQuery(StrView(text, strlen(text))).Valid() || SexprQuery(StrView(text, strlen(text)), &symbols).Valid()) {
+            printf("the malformed query '%s' is valid\n", text);
+            ++failures;
+        }
+    }
+
+    for (int bits = 0; bits < 4; ++bits) {
+        SexprOptions options;
+        options.zeroCopy = (bits & 1) != 0;
+        options.lazyNumbers = (bits & 2) != 0;
+        // names compared as ids, as text, and as text when the tables differ
+        SymbolTable shared, other;
+        Check(options, &shared, &shared);
+        Check(options, nullptr, nullptr);
+        Check(options, nullptr, &other);
+        Check(options, &shared, nullptr);
+        Check(options, &shared, &other);
+    }
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -76,7 +76,7 @@ int main() {
         switch (e.token) {
         case tsSexprPushList: printf("("); break;
         case tsSexprPopList: printf(")"); break;
-        case tsSexprInteger: printf("%d ", s.ints[e.ref]); break;
+        case tsSexprInteger: printf("%lld ", (long long) s.ints[e.ref]); break;
         case tsSexprFloat: printf("%f ", s.floats[e.ref]); break;
         case tsSexprString: printf("\"%s\" ", s.strings[e.ref].c_str()); break;
         case tsSexprAtom: printf("%s ", s.strings[e.ref].c_str()); break;
@@ -0,0 +1,271 @@
+
+// Checks the SIMD kernels against the scalar ones. Every scanner, the line
+// index and both Sexpr parsers run at each level tsSetSimdLevel can select,
+// on inputs built so that quotes, backslash runs and the two bytes of a UTF-8
+// section sign fall on either side of a 64 byte block boundary. Checks also
+// that the line index built on several threads is the one built on one, with
+// \r\n and \n\r pairs and runs of breaks across the chunk splits.
+
+#include <LabText/LabText.h>
+#include <stdio.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace lab::Text;
+
+static int failures = 0;
+
+static void Fail(char const* what, int level, std::string const& doc, size_t a, size_t b) {
+    if (failures++ < 10)
+        printf("%s: level %d differs from scalar (%zu vs %zu) on %zu bytes\n", what, level, a, b, doc.size());
+}
+
+// Records the events of a parse as text, so two parses compare as strings.
+struct Recorder : SexprHandler {
+    std::string out;
+    void OnPush() { out += "("; }
+    void OnPop() { out += ")"; }
+    void OnAtom(StrView s) { out += "A[" + std::string(s.curr, s.sz) + "]"; }
+    void OnString(StrView s, bool escaped) { out += (escaped ? "E[" : "S[") + std::string(s.curr, s.sz) + "]"; }
+    void OnInt(int64_t i) { out += "I" + std::to_string(i); }
+    void OnFloat(double f) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "F%.17g", f);
+        out += buf;
+    }
+};
+
+static std::vector<tsSimdLevel_t> Levels() {
+    std::vector<tsSimdLevel_t> levels;
+    for (int l = tsSimdScalar; l <= tsSimdNEON; ++l) {
+        // levels the CPU can't run select a narrower one
+        if (tsSetSimdLevel((tsSimdLevel_t) l) == (tsSimdLevel_t) l)
+            levels.push_back((tsSimdLevel_t) l);
+    }
+    return levels;
+}
+
+// Puts the interesting bytes at every position around the first two block
+// boundaries: a string whose closing quote follows a run of backslashes, and
+// section sign strings in both the one and the two byte spelling.
+static std::vector<std::string> BoundaryDocuments() {
+    std::vector<std::string> docs;
+    char const* tails[] = {
+        "\"", "\\\"x\" y)", "\\\\\" y)", "\\\\\\\"z\" y)", "\\\\\\\\\" 1)",
+        "\xA7 s\xA7 2)", "\xC2\xA7 s\xC2\xA7 3.5)", "x\xC2\xA7 y)", "\xC2", "\xC2\xA7",
+    };
+    for (size_t at = 56; at < 136; ++at) {
+        for (char const* tail : tails) {
+            std::string lead = "(a \"";
+            while (lead.size() < at)
+                lead += (lead.size() % 7) ? 'q' : ' ';
+            docs.push_back(lead + tail);
+            // the same bytes outside a string
+            std::string bare = "(" + std::string(at - 1, ' ') + tail + " \"t\")";
+            docs.push_back(bare);
+        }
+    }
+    return docs;
+}
+
+static std::string RandomDocument(std::mt19937& rng) {
+    char const* fragments[] = {
+        "(", ")", "(", ")", " ", "\n", "\r\n", "\t", "a", "bc", "12", "-3.5", "1e3",
+        "\"", "\\", "\\\\", "\\\"", ";", "x;c\n", "\xA7", "\xC2\xA7", "\xC2", "\xA7\xA7",
+        "\"s t\"", "\xA7l\\\xA7t\xA7", "\xC2\xA7u ( \xC2\xA7", "12abc", "(deep (er))", "  ",
+        "\xF0\x9F\xA7\xA0",
+    };
+    size_t count = sizeof(fragments) / sizeof(fragments[0]);
+    std::string doc = (rng() % 3) ? "(" : "";
+    size_t n = rng() % ((rng() % 10) ? 120 : 2000);
+    for (size_t i = 0; i < n; ++i)
+        doc += fragments[rng() % count];
+    return doc;
+}
+
+static std::string Parse(std::string const& doc, bool twoStage, SexprOptions const& options,
+                         tsSexprStatus_t& status, size_t& errorOffset) {
+    Recorder r;
+    errorOffset = 0;
+    StrView s(doc.c_str(), doc.size());
+    status = twoStage ? ParseSexprTwoStage(s, r, options, &errorOffset)
+                      : ParseSexpr(s, r, options, &errorOffset);
+    if (status == tsSexprOk)
+        errorOffset = 0;
+    return r.out;
+}
+
+static void TestParsers(std::vector<tsSimdLevel_t> const& levels, std::vector<std::string> const& docs) {
+    for (size_t d = 0; d < docs.size(); ++d) {
+        std::string const& doc = docs[d];
+        SexprOptions options;
+        if (d % 7 == 0)
+            options.maxDepth = 3;
+        tsSetSimdLevel(tsSimdScalar);
+        tsSexprStatus_t status;
+        size_t offset;
+        std::string expected = Parse(doc, false, options, status, offset);
+        for (tsSimdLevel_t level : levels) {
+            tsSetSimdLevel(level);
+            for (bool twoStage : { false, true }) {
+                tsSexprStatus_t st;
+                size_t off;
+                std::string got = Parse(doc, twoStage, options, st, off);
+                if (got != expected || st != status || off != offset)
+                    Fail(twoStage ? "ParseSexprTwoStage" : "ParseSexpr", level, doc, off, offset);
+            }
+        }
+    }
+}
+
+// The results of every dispatched scanner on one window, as offsets.
+static std::vector<size_t> Scan(char const* p, char const* end, tsCharSet_t const* set) {
+    std::vector<size_t> r;
+    auto at = [&](char const* q) { r.push_back((size_t) (q - p)); };
+    at(tsScanForWhiteSpace(p, end));
+    at(tsScanForNonWhiteSpace(p, end));
+    for (char c : { '"', '\\', ')', '\n', '\xA7', '\xC2' })
+        at(tsScanForCharacter(p, end, c));
+    at(tsScanForCharSet(p, end, set));
+    at(tsScanPastCharSet(p, end, set));
+    for (char delim : { '"', '\'', '\xA7' }) {
+        at(tsScanForQuote(p, end, delim, true));
+        at(tsScanForQuote(p, end, delim, false));
+    }
+    for (bool escapes : { false, true }) {
+        char const* str = nullptr;
+        uint32_t len = 0;
+        at(tsGetString(p, end, escapes, &str, &len));
+        r.push_back(str ? (size_t) (str - p) : ~(size_t) 0);
+        r.push_back(len);
+    }
+    char const* tok = nullptr;
+    uint32_t len = 0;
+    at(tsGetTokenCharSet(p, end, set, &tok, &len));
+    r.push_back(len);
+    at(tsGetTokenWSDelimited(p, end, &tok, &len));
+    r.push_back(len);
+    return r;
+}
+
+static std::string RandomBytes(std::mt19937& rng, size_t n) {
+    // weighted toward the bytes the kernels look for
+    char const alphabet[] = " \t\r\n\"\\'\xA7\xC2()abc019;";
+    std::string s;
+    for (size_t i = 0; i < n; ++i)
+        s += (rng() % 4) ? alphabet[rng() % (sizeof(alphabet) - 1)] : (char) rng();
+    return s;
+}
+
+static void TestScanners(std::vector<tsSimdLevel_t> const& levels, std::mt19937& rng) {
+    tsCharSet_t set;
+    tsCharSetClear(&set);
+    tsCharSetAddAlphaNumeric(&set);
+    tsCharSetAddString(&set, "-_\xA7");
+
+    for (int t = 0; t < 20000; ++t) {
+        std::string buffer = RandomBytes(rng, 1 + rng() % 300);
+        // windows at every alignment, including the empty one
+        size_t begin = rng() % buffer.size();
+        size_t end = begin + rng() % (buffer.size() - begin + 1);
+        char const* p = buffer.data() + begin;
+        char const* e = buffer.data() + end;
+
+        tsSetSimdLevel(tsSimdScalar);
+        std::vector<size_t> expected = Scan(p, e, &set);
+        LineIndex expectedLines(StrView(p, end - begin), false, 1);
+        for (tsSimdLevel_t level : levels) {
+            tsSetSimdLevel(level);
+            std::vector<size_t> got = Scan(p, e, &set);
+            for (size_t i = 0; i < got.size(); ++i)
+                if (got[i] != expected[i]) {
+                    Fail("scanner", level, buffer, got[i], expected[i]);
+                    break;
+                }
+            LineIndex lines(StrView(p, end - begin), false, 1);
+            if (lines.LineCount() != expectedLines.LineCount())
+                Fail("LineIndex", level, buffer, lines.LineCount(), expectedLines.LineCount());
+            else
+                for (size_t i = 0; i < lines.LineCount(); ++i)
+                    if (lines.LineStart(i) != expectedLines.LineStart(i)) {
+                        Fail("LineIndex", level, buffer, lines.LineStart(i), expectedLines.LineStart(i));
+                        break;
+                    }
+        }
+    }
+}
+
+// A document of short lines with mixed breaks, then the breaks that most
+// need care written over each offset LineIndex splits at on n threads.
+static std::string LineDocument(std::mt19937& rng, unsigned n) {
+    static char const* breaks[] = { "\n", "\r", "\r\n", "\n\r", "\n\n", "\r\r", "\r\n\r\n", "\n\r\n" };
+    size_t const count = sizeof(breaks) / sizeof(breaks[0]);
+    std::string s;
+    size_t size = n + rng() % 400;
+    while (s.size() < size) {
+        s.append(rng() % 6, 'a' + (char) (rng() % 26));
+        s += breaks[rng() % count];
+    }
+    for (unsigned i = 1; i < n; ++i) {
+        std::string b = breaks[rng() % count];
+        size_t split = s.size() / n * i;
+        // the break starts at, just before, or just after the split
+        size_t at = split + (rng() % 3) - std::min<size_t>(split, b.size() - 1);
+        if (at + b.size() <= s.size())
+            s.replace(at, b.size(), b);
+    }
+    return s;
+}
+
+static void FailThreads(char const* what, unsigned n, std::string const& doc, size_t a, size_t b) {
+    if (failures++ < 10)
+        printf("%s: %u threads differ from one (%zu vs %zu) on %zu bytes\n", what, n, a, b, doc.size());
+}
+
+static void TestLineIndexThreads(std::mt19937& rng) {
+    for (int t = 0; t < 4000; ++t) {
+        unsigned n = 2 + t % 8;
+        std::string doc = LineDocument(rng, n);
+        StrView view(doc.c_str(), doc.size());
+        LineIndex expected(view, false, 1);
+        LineIndex lines(view, false, n);
+        if (lines.LineCount() != expected.LineCount()) {
+            FailThreads("LineIndex", n, doc, lines.LineCount(), expected.LineCount());
+            continue;
+        }
+        for (size_t i = 0; i < lines.LineCount(); ++i)
+            if (lines.LineStart(i) != expected.LineStart(i)) {
+                FailThreads("LineIndex", n, doc, lines.LineStart(i), expected.LineStart(i));
+                break;
+            }
+        for (int k = 0; k < 8; ++k) {
+            size_t offset = rng() % (doc.size() + 1);
+            LineIndex::Location got = lines.Find(offset), want = expected.Find(offset);
+            if (got.line != want.line || got.column != want.column) {
+                FailThreads("LineIndex::Find", n, doc, got.line, want.line);
+                break;
+            }
+        }
+    }
+}
+
+int main() {
+    std::vector<tsSimdLevel_t> levels = Levels();
+    printf("levels:");
+    for (tsSimdLevel_t level : levels)
+        printf(" %d", level);
+    printf("\n");
+
+    std::mt19937 rng(15);
+    TestScanners(levels, rng);
+    TestLineIndexThreads(rng);
+
+    std::vector<std::string> docs = BoundaryDocuments();
+    for (int t = 0; t < 5000; ++t)
+        docs.push_back(RandomDocument(rng));
+    TestParsers(levels, docs);
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
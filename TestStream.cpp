@@ -0,0 +1,178 @@
+
+// Checks SexprStreamParser: a document fed in two chunks split at every byte
+// offset, and a byte at a time, gives the same forms as the whole document
+// parsed by Sexpr, with splits inside atoms, strings, escapes, comments and
+// between the two bytes of a §. Checks also where a stray paren, a top-level
+// atom and too deep a nesting stop the stream, whichever chunk they arrive
+// in, and what Finish does with a form left open.
+
+#include <LabText/LabText.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace lab::Text;
+
+static int failures = 0;
+
+static void Fail(std::string const& what) {
+    if (failures++ < 20)
+        printf("%s\n", what.c_str());
+}
+
+// The elements of a Sexpr as text, each token with its value.
+static std::string Tape(Sexpr const& sexpr) {
+    std::string out;
+    for (Sexpr::Elem const& e : sexpr.expr) {
+        char buf[40];
+        switch (e.token) {
+        case tsSexprPushList: out += "("; break;
+        case tsSexprPopList: out += ")"; break;
+        case tsSexprInteger:
+            snprintf(buf, sizeof(buf), " I%lld", (long long) sexpr.Int(e.ref));
+            out += buf;
+            break;
+        case tsSexprFloat:
+            snprintf(buf, sizeof(buf), " F%.17g", sexpr.Float(e.ref));
+            out += buf;
+            break;
+        default: {
+            StrView text = sexpr.Text(e);
+            out += e.token == tsSexprAtom ? " A[" : " S[";
+            out.append(text.curr, text.sz);
+            out += "]";
+        }
+        }
+    }
+    return out;
+}
+
+// A stream fed the given chunks and finished, with the forms it emitted.
+struct Run {
+    std::string tape;
+    size_t forms = 0;
+    tsSexprStatus_t fed = tsSexprOk;        // what the last Feed returned
+    tsSexprStatus_t finished = tsSexprOk;
+    size_t errorOffset = 0;
+    std::string last;                       // the tape of the last form
+
+    Run(std::string const& doc, std::vector<size_t> const& splits, SexprOptions const& options = SexprOptions()) {
+        SexprStreamParser stream([&](Sexpr& form) {
+            ++forms;
+            last = Tape(form);
+            tape += last;
+        }, options);
+        size_t at = 0;
+        for (size_t split : splits) {
+            fed = stream.Feed(StrView(doc.c_str() + at, split - at));
+            at = split;
+        }
+        fed = stream.Feed(StrView(doc.c_str() + at, doc.size() - at));
+        finished = stream.Finish();
+        errorOffset = stream.errorOffset;
+    }
+};
+
+static char const* document =
+    "(ls-node :name \"Gain-3\" :pos 869 116 :gain -0.5e2)\n"
+    "; a comment with (parens) \"quotes\" and \xA7 signs\n"
+    "(esc \"a\\\"b\\\\\" \"ends in a backslash\\\\\" \"(not a list)\")\n"
+    "(sec \xA7section \\\xA7 sign\xA7 \xC2\xA7two \"byte\" sign\xC2\xA7 ; inside a list\n"
+    "  (nested (deeper 12abc 1e300 .5)))   (adjacent)(forms)\n"
+    "\t()\r\n";
+
+static void Compare(char const* name, std::string const& doc, std::vector<size_t> const& splits,
+                    std::string const& expected, size_t forms) {
+    Run run(doc, splits);
+    if (run.fed != tsSexprOk || run.finished != tsSexprOk || run.tape != expected || run.forms != forms) {
+        std::string what = std::string(name) + " at";
+        for (size_t s : splits)
+            what += " " + std::to_string(s);
+        Fail(what + ": status " + std::to_string(run.finished) + ", " + std::to_string(run.forms) + " forms\n  want "
+             + expected + "\n  got  " + run.tape);
+    }
+}
+
+static void TestSplits() {
+    std::string doc = document;
+    Sexpr whole(StrView(doc.c_str(), doc.size()));
+    std::string expected = Tape(whole);
+    if (whole.status != tsSexprOk || whole.balance != 0)
+        Fail("the document does not parse whole");
+    size_t forms = 0;
+    int depth = 0;
+    for (Sexpr::Elem const& e : whole.expr) {
+        if (e.token == tsSexprPushList && depth++ == 0)
+            ++forms;
+        if (e.token == tsSexprPopList)
+            --depth;
+    }
+
+    // the offsets that most need splitting at are in the document
+    char const* needed[] = { "\xC2\xA7", "\\\\\"", "; a comment", "\\\xA7", "12abc" };
+    for (char const* n : needed)
+        if (doc.find(n) == std::string::npos)
+            Fail(std::string("the document lacks ") + n);
+
+    for (size_t k = 0; k <= doc.size(); ++k)
+        Compare("split", doc, { k }, expected, forms);
+    for (size_t k = 0; k + 7 <= doc.size(); k += 3)
+        Compare("split in three", doc, { k, k + 7 }, expected, forms);
+    std::vector<size_t> bytes;
+    for (size_t k = 1; k < doc.size(); ++k)
+        bytes.push_back(k);
+    Compare("a byte at a time", doc, bytes, expected, forms);
+}
+
+// A document that stops at offset with error, wherever it is split. forms is
+// the number of forms emitted before it stops.
+static void ExpectError(char const* name, std::string const& doc, tsSexprStatus_t error, size_t offset, size_t forms,
+                        SexprOptions const& options = SexprOptions()) {
+    for (size_t k = 0; k <= doc.size(); ++k) {
+        Run run(doc, { k }, options);
+        if (run.finished != error || run.fed != error || run.errorOffset != offset || run.forms != forms) {
+            Fail(std::string(name) + " split at " + std::to_string(k) + ": status " + std::to_string(run.finished)
+                 + " at " + std::to_string(run.errorOffset) + " after " + std::to_string(run.forms) + " forms");
+            return;
+        }
+    }
+}
+
+static void TestErrors() {
+    ExpectError("a stray paren", "(a) ; )\n (b \")\") ) (c)", tsSexprErrorSyntax, 17, 2);
+    ExpectError("a top-level atom", "(a)\n(b) atom (c)", tsSexprErrorSyntax, 8, 2);
+    ExpectError("a top-level string", "(a) \xC2\xA7s\xC2\xA7 (c)", tsSexprErrorSyntax, 4, 1);
+    SexprOptions shallow;
+    shallow.maxDepth = 2;
+    ExpectError("too deep", "(a (b)) (a (b (c)))", tsSexprErrorDepth, 14, 1, shallow);
+
+    // a form left open is handed on as Sexpr parses it, and Finish reports
+    // where it began
+    std::string open = "(a) (b \"x\" (c 1";
+    Sexpr partial(StrView(open.c_str() + 4, open.size() - 4));
+    for (size_t k = 0; k <= open.size(); ++k) {
+        Run run(open, { k });
+        if (run.fed != tsSexprOk || run.finished != tsSexprErrorUnterminated || run.errorOffset != 4
+            || run.forms != 2 || run.last != Tape(partial)) {
+            Fail("an open form split at " + std::to_string(k) + ": status " + std::to_string(run.finished) + " at "
+                 + std::to_string(run.errorOffset) + " after " + std::to_string(run.forms) + " forms, last " + run.last);
+            break;
+        }
+    }
+
+    // nothing, or only comments and space, is a complete stream
+    for (char const* empty : { "", " \n\t", "; only a comment", "; unterminated comment (" }) {
+        Run run(empty, {});
+        if (run.finished != tsSexprOk || run.forms != 0)
+            Fail(std::string("the stream '") + empty + "' does not finish cleanly");
+    }
+}
+
+int main() {
+    TestSplits();
+    TestErrors();
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+
+// Checks tsStrViewParseSexprTape against tsStrViewParseSexprWithOptions: the
+// same tokens and values, status and returned view, on fixed and random
+// documents, with and without maxDepth. Checks also the tape's match links,
+// against a stack, for nested, unmatched and unclosed lists, and that
+// tsSexprTape_Skip and tsSexprTape_String follow them.
+
+#include <LabText/LabText.h>
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void Fail(std::string const& what) {
+    if (failures++ < 20)
+        printf("%s\n", what.c_str());
+}
+
+static bool SameView(tsStrView_t a, tsStrView_t b) {
+    return a.curr == b.curr && a.sz == b.sz;
+}
+
+// The tape holds the linked cells' tokens, in order, with the same values.
+static bool SameTokens(tsSexprTape_t const& tape, tsParsedSexpr_t const* cell) {
+    for (size_t i = 0; i < tape.count; ++i, cell = cell->next) {
+        tsSexprTapeEntry_t const& e = tape.entries[i];
+        if (!cell || e.token != (uint32_t) cell->token)
+            return false;
+        switch (cell->token) {
+        case tsSexprInteger:
+            if (e.i != cell->i)
+                return false;
+            break;
+        case tsSexprFloat:
+            if (memcmp(&e.f, &cell->f, sizeof(double)))
+                return false;
+            break;
+        case tsSexprAtom:
+        case tsSexprString:
+            if (!SameView(tsSexprTape_String(&tape, i), cell->str))
+                return false;
+            break;
+        default:
+            if (tsSexprTape_String(&tape, i).curr)
+                return false;
+        }
+    }
+    return cell == nullptr;
+}
+
+// The match links and skips, found again with a stack.
+static bool LinksValid(tsSexprTape_t const& tape) {
+    std::vector<size_t> open;
+    for (size_t i = 0; i < tape.count; ++i) {
+        tsSexprTapeEntry_t const& e = tape.entries[i];
+        if (e.token == tsSexprPushList)
+            open.push_back(i);
+        else if (e.token == tsSexprPopList) {
+            if (open.empty()) {
+                if (e.match != tsSexprTapeNoMatch)
+                    return false;
+            }
+            else {
+                size_t push = open.back();
+                open.pop_back();
+                if (e.match != push || tape.entries[push].match != i || tsSexprTape_Skip(&tape, push) != i + 1)
+                    return false;
+            }
+        }
+        if (e.token != tsSexprPushList && tsSexprTape_Skip(&tape, i) != i + 1)
+            return false;
+    }
+    // lists never closed match, and skip to, the end of the tape
+    for (size_t push : open)
+        if (tape.entries[push].match != tape.count || tsSexprTape_Skip(&tape, push) != tape.count)
+            return false;
+    return true;
+}
+
+static void Compare(std::string const& name, std::string const& doc, int maxDepth, tsSexprTape_t& tape) {
+    tsSexprArena_t arena;
+    tsSexprArena_Init(&arena, 0);
+    tsSexprParseOptions_t options = { &arena, maxDepth };
+
+    tsParsedSexpr_t head;
+    memset(&head, 0, sizeof(head));
+    tsStrView_t s = { doc.c_str(), doc.size() };
+    tsSexprStatus_t cellStatus, tapeStatus;
+    tsStrView_t cellRest = tsStrViewParseSexprWithOptions(&s, &head, 0, &options, &cellStatus);
+    tsStrView_t tapeRest = tsStrViewParseSexprTape(&s, &tape, &options, &tapeStatus);
+
+    std::string where = name + " (maxDepth " + std::to_string(maxDepth) + ")";
+    if (cellStatus != tapeStatus || !SameView(cellRest, tapeRest))
+        Fail(where + ": status " + std::to_string(tapeStatus) + ", not " + std::to_string(cellStatus));
+    if (tape.source != doc.c_str() || !SameTokens(tape, head.next))
+        Fail(where + ": the tape has other tokens");
+    if (!LinksValid(tape))
+        Fail(where + ": the match links are wrong");
+    tsSexprArena_Free(&arena);
+}
+
+struct Case {
+    char const* name;
+    char const* text;
+    size_t count;           // entries on the tape, with maxDepth 0
+};
+
+static Case const cases[] = {
+    { "nested", "(a (b (c 1 2.5) \"s\") () ((d)))", 19 },
+    { "siblings", "; lead\n(a) (b c) \t(d (e))", 13 },
+    { "strings", "(\"q \\\" ()\" \xA7l (\xA7 \xC2\xA7u )\xC2\xA7 ; c )\n x)", 6 },
+    { "numbers", "(0 -7 9223372036854775807 1e999 .5 12abc)", 9 },
+    { "unmatched", "(a)) (b)))", 9 },
+    { "unclosed", "(a (b (c) (d", 9 },
+    { "unclosed string", "(a \"never closed", 3 },
+    { "deep", "(1 (2 (3 (4 (5)))) (2b))", 19 },
+};
+
+static std::string RandomDocument(std::mt19937& rng) {
+    static char const* items[] = {
+        "(", "(", "(", ")", ")", ")", "atom", "-12", "3.25", "\"s\"", "\"(\"", "\xA7)\xA7", "\xC2\xA7 \xC2\xA7",
+        "; ( comment\n", " ", "\n", "1e5", "x)", "(y",
+    };
+    std::string doc = "(";
+    size_t n = rng() % 40;
+    for (size_t i = 0; i < n; ++i) {
+        doc += items[rng() % (sizeof(items) / sizeof(items[0]))];
+        doc += ' ';
+    }
+    return doc;
+}
+
+int main() {
+    tsSexprTape_t tape;
+    tsSexprTape_Init(&tape);
+
+    // one tape reused for every parse
+    for (Case const& c : cases) {
+        for (int maxDepth : { 0, 1, 2, 3, 16 })
+            Compare(c.name, c.text, maxDepth, tape);
+        tsStrView_t s = { c.text, strlen(c.text) };
+        tsStrViewParseSexprTape(&s, &tape, nullptr, nullptr);
+        if (tape.count != c.count)
+            Fail(std::string(c.name) + ": " + std::to_string(tape.count) + " entries, not " + std::to_string(c.count));
+    }
+
+    // the links for a list closed too often, and one never closed
+    tsStrView_t s = { "(a)) (b", 7 };
+    tsSexprStatus_t status;
+    tsStrViewParseSexprTape(&s, &tape, nullptr, &status);
+    if (status != tsSexprOk || tape.count != 6 || tape.entries[0].match != 2 || tape.entries[2].match != 0
+        || tape.entries[3].match != tsSexprTapeNoMatch || tape.entries[4].match != 6 || tsSexprTape_Skip(&tape, 4) != 6)
+        Fail("the links of (a)) (b are wrong");
+
+    // too deep stops at the paren, with the tape so far
+    tsSexprParseOptions_t shallow = { nullptr, 2 };
+    s = { "(a (b (c)))", 11 };
+    tsStrView_t rest = tsStrViewParseSexprTape(&s, &tape, &shallow, &status);
+    if (status != tsSexprErrorDepth || rest.curr != s.curr + 6 || rest.sz != 0 || tape.count != 4)
+        Fail("too deep does not stop at the third paren");
+
+    // nothing to parse, and no list to begin
+    for (char const* text : { "", "   ", "atom (a)" }) {
+        s = { text, strlen(text) };
+        tsStrViewParseSexprTape(&s, &tape, nullptr, &status);
+        if (tape.count != 0)
+            Fail(std::string("'") + text + "' leaves entries on the tape");
+    }
+    if (tsStrViewParseSexprTape(nullptr, &tape, nullptr, &status).curr || tape.count != 0 || status != tsSexprOk)
+        Fail("a null view is not an empty tape");
+
+    std::mt19937 rng(7);
+    for (int i = 0; i < 3000; ++i) {
+        std::string doc = RandomDocument(rng);
+        Compare("random document " + std::to_string(i), doc, 0, tape);
+        Compare("random document " + std::to_string(i), doc, 3, tape);
+    }
+
+    tsSexprTape_Free(&tape);
+    if (tape.entries || tape.count || tape.capacity)
+        Fail("a freed tape is not empty");
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
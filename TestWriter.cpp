@@ -0,0 +1,116 @@
+
+// Checks that SexprWriter's output parses back to the document it was
+// written from: a document is parsed, written compact and pretty, parsed
+// again, and the two element streams compared, values and all, under each
+// way Sexpr can hold its strings.
+
+#include <LabText/LabText.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+using namespace lab::Text;
+
+static int failures = 0;
+
+// The elements of a document as text: each token with its value, floats by
+// their bits so that -0.0 and 0.0 differ.
+static std::string Tape(Sexpr const& sexpr) {
+    std::string out;
+    for (Sexpr::Elem const& e : sexpr.expr) {
+        char buf[40];
+        switch (e.token) {
+        case tsSexprPushList: out += "("; break;
+        case tsSexprPopList: out += ")"; break;
+        case tsSexprInteger:
+            snprintf(buf, sizeof(buf), " I%lld", (long long) sexpr.Int(e.ref));
+            out += buf;
+            break;
+        case tsSexprFloat: {
+            double f = sexpr.Float(e.ref);
+            uint64_t bits;
+            memcpy(&bits, &f, sizeof(bits));
+            snprintf(buf, sizeof(buf), " F%016llx", (unsigned long long) bits);
+            out += buf;
+            break;
+        }
+        default: {
+            StrView text = sexpr.Text(e);
+            out += e.token == tsSexprAtom ? " A[" : " S[";
+            out.append(text.curr, text.sz);
+            out += "]";
+        }
+        }
+    }
+    return out;
+}
+
+static void RoundTrip(char const* name, std::string const& doc, SexprOptions const& options) {
+    Sexpr first(StrView(doc.c_str(), doc.size()), options);
+    if (first.status != tsSexprOk || first.balance != 0) {
+        printf("%s: does not parse\n", name);
+        ++failures;
+        return;
+    }
+    std::string expected = Tape(first);
+    for (bool pretty : { false, true }) {
+        SexprWriter writer(pretty);
+        writer.Write(first);
+        std::string text = writer.Buffer();
+        Sexpr second(StrView(text.c_str(), text.size()), options);
+        std::string got = Tape(second);
+        if (second.status != tsSexprOk || got != expected) {
+            if (failures++ < 10)
+                printf("%s (%s, zeroCopy %d unescape %d) reads back differently\n  wrote %s\n  want %s\n  got  %s\n",
+                       name, pretty ? "pretty" : "compact", options.zeroCopy, options.unescapeStrings,
+                       text.c_str(), expected.c_str(), got.c_str());
+        }
+    }
+}
+
+static char const* documents[] = {
+    // infinities, signed zeros, and floats with no point in their shortest form
+    "(a 1e999 -1e999 2.5 -0.0 0.0 1e21 1e-7 5e-324 1.7976931348623157e308 \"x\\ny\")",
+    // the ends of the 64 bit integers, and the first values past them, which read as floats
+    "(ints 9223372036854775807 -9223372036854775808 9223372036854775808 -9223372036854775809"
+    " 18446744073709551615 99999999999999999999 0 -1 1000000000000000000)",
+    // strings in each delimiter, with escapes
+    "(s \"q \\\" b \\\\ n \\n r \\r t \\t x \\x\" \xA7l \\\xA7 a \\\\ \\n\xA7 \xC2\xA7u \" \\ \\n\xC2\xA7 \"\" \xA7\xA7)",
+    // strings that need a delimiter other than their own to read back
+    "(t \xA7has \" quote\xA7 \"has \xA7 sign\" \xC2\xA7has \" and \xA7\xC2\xA7 \"ends \\\\\")",
+    // nesting, empty lists and atoms
+    "(outer (inner (deepest)) () (a b) :key value 'q) (second 1 (2 (3.5)))",
+};
+
+int main() {
+    for (int bits = 0; bits < 8; ++bits) {
+        SymbolTable symbols;
+        SexprOptions options;
+        options.zeroCopy = (bits & 1) != 0;
+        options.unescapeStrings = (bits & 2) != 0;
+        options.symbols = (bits & 4) ? &symbols : nullptr;
+        int n = 0;
+        for (char const* doc : documents) {
+            char name[32];
+            snprintf(name, sizeof(name), "document %d", n++);
+            RoundTrip(name, doc, options);
+        }
+    }
+
+    // infinities written directly, as float and as double
+    SexprWriter writer;
+    writer.Push().Float(INFINITY).Float(-INFINITY).Float((double) INFINITY).Float((double) -INFINITY).Pop();
+    Sexpr back(writer.View());
+    bool ok = back.status == tsSexprOk && back.expr.size() == 6;
+    for (size_t i = 1; ok && i < 5; ++i)
+        ok = back.expr[i].token == tsSexprFloat && isinf(back.Float(back.expr[i].ref))
+          && (back.Float(back.expr[i].ref) < 0) == (i % 2 == 0);
+    if (!ok) {
+        printf("infinities written as %s do not read back\n", writer.Buffer().c_str());
+        ++failures;
+    }
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
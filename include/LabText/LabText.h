@@ -71,8 +71,16 @@ EXTERNC char const* tsGetString2                    (char const* pCurr, char con
 EXTERNC char const* tsGetInt16                      (char const* pCurr, char const* pEnd, int16_t* result);
 EXTERNC char const* tsGetInt32                      (char const* pCurr, char const* pEnd, int32_t* result);
 EXTERNC char const* tsGetUInt32                     (char const* pCurr, char const* pEnd, uint32_t* result);
+// A value out of range sets *overflow, if given, and is clamped; the 32 bit
+// readers clamp as well.
+EXTERNC char const* tsGetInt64                      (char const* pCurr, char const* pEnd, int64_t* result, bool* overflow);
+EXTERNC char const* tsGetUInt64                     (char const* pCurr, char const* pEnd, uint64_t* result, bool* overflow);
 EXTERNC char const* tsGetHex                        (char const* pCurr, char const* pEnd, uint32_t* result);
+// Floats and doubles are correctly rounded. A number needs a decimal point
+// or an exponent to be read as a float; 1.5, .5, 5. and 1e5 are floats, 15
+// is left for tsGetInt32.
 EXTERNC char const* tsGetFloat                      (char const* pcurr, char const* pEnd, float* result);
+EXTERNC char const* tsGetDouble                     (char const* pCurr, char const* pEnd, double* result);
 
 // Scanning
 EXTERNC char const* tsScanForCharacter              (char const* pCurr, char const* pEnd, char delim);
@@ -88,6 +96,19 @@ EXTERNC char const* tsScanForBeginningOfNextLine    (char const* pCurr, char con
 EXTERNC char const* tsScanPastCPPComments           (char const* pCurr, char const* pEnd);
 EXTERNC char const* tsSkipCommentsAndWhitespace     (char const* pCurr, char const*const pEnd);
 
+// SIMD dispatch. The scanners pick the widest kernel the CPU supports the
+// first time one of them runs. tsSetSimdLevel forces a narrower level, for
+// example tsSimdScalar to compare against the reference implementation, and
+// returns the level that was actually selected.
+typedef enum {
+    tsSimdScalar = 0,
+    tsSimdSSE2,
+    tsSimdAVX2,
+    tsSimdNEON } tsSimdLevel_t;
+
+EXTERNC tsSimdLevel_t tsGetSimdLevel(void);
+EXTERNC tsSimdLevel_t tsSetSimdLevel(tsSimdLevel_t level);
+
 // Expect
 EXTERNC char const* tsExpect                        (char const* pCurr, char const*const pEnd, char const* pExpect);
 
@@ -97,6 +118,48 @@ EXTERNC _Bool tsIsNumeric   (char test);
 EXTERNC _Bool tsIsAlpha     (char test);            // A-Z, a-z
 EXTERNC _Bool tsIsIn        (const char* testString, char test);
 
+// Character sets
+// A tsCharSet_t is a 256 bit membership bitmap, built once and then tested
+// with a single table lookup per byte. The bits are kept in the nibble
+// transposed layout the SIMD classifiers consume directly: byte c lives in
+// bits[((c & 0x80) >> 3) | (c & 0x0f)] at bit position (c >> 4) & 7.
+typedef struct tsCharSet_t {
+    uint8_t bits[32];
+} tsCharSet_t;
+
+EXTERNC void tsCharSetClear          (tsCharSet_t* set);
+EXTERNC void tsCharSetAdd            (tsCharSet_t* set, char c);
+EXTERNC void tsCharSetAddString      (tsCharSet_t* set, char const* chars);
+EXTERNC void tsCharSetAddRange       (tsCharSet_t* set, char first, char last);
+EXTERNC void tsCharSetAddAlphaNumeric(tsCharSet_t* set);    // 0-9, A-Z, a-z
+
+static inline _Bool tsCharSetContains(tsCharSet_t const* set, char c)
+{
+    uint8_t u = (uint8_t) c;
+    return (set->bits[((u & 0x80) >> 3) | (u & 0x0f)] >> ((u >> 4) & 7)) & 1;
+}
+
+// Scanning against a set. tsScanForCharSet stops at the first byte in the
+// set, tsScanPastCharSet at the first byte not in it. tsGetTokenCharSet skips
+// leading white space and returns the longest run of bytes from the set.
+EXTERNC char const* tsScanForCharSet                (char const* pCurr, char const* pEnd, tsCharSet_t const* set);
+EXTERNC char const* tsScanPastCharSet               (char const* pCurr, char const* pEnd, tsCharSet_t const* set);
+EXTERNC char const* tsGetTokenCharSet               (char const* pCurr, char const* pEnd,
+                                                     tsCharSet_t const* accept, char const** resultStringBegin, uint32_t* stringLength);
+
+// Bulk readers for runs of numbers, such as a column of samples. Separators
+// before, between and after the values are skipped, and up to capacity
+// values are stored. Returns the number stored; *stop, if given, is past the
+// last one, or at the first token that is not a number followed by a
+// separator or the end. Integers are read as floats and doubles as well;
+// tsParseInts stops at a number that is not an integer in 64 bit range.
+EXTERNC size_t tsParseDoubles(char const* pCurr, char const* pEnd, tsCharSet_t const* separators,
+                              double* values, size_t capacity, char const** stop);
+EXTERNC size_t tsParseFloats (char const* pCurr, char const* pEnd, tsCharSet_t const* separators,
+                              float* values, size_t capacity, char const** stop);
+EXTERNC size_t tsParseInts   (char const* pCurr, char const* pEnd, tsCharSet_t const* separators,
+                              int64_t* values, size_t capacity, char const** stop);
+
 // These UTF conversions return length. If dst is nullptr, the routines can be used for measuring a conversion
 EXTERNC int32_t tsConvertUtf8ToUtf16(uint16_t* dst, int32_t dst_size, const char* src);
 EXTERNC int32_t tsConvertUtf16ToUtf8(char* dst, int32_t dst_size, const uint16_t* src);
@@ -126,6 +189,7 @@ EXTERNC tsStrView_t tsStrViewGetTokenWSDelimited           (const tsStrView_t *s
 EXTERNC tsStrView_t tsStrViewGetTokenAlphaNumeric          (const tsStrView_t* s, tsStrView_t* result);
 EXTERNC tsStrView_t tsStrViewGetTokenAlphaNumericExt       (const tsStrView_t* s, char const* ext, tsStrView_t* result);
 EXTERNC tsStrView_t tsStrViewGetNameSpacedTokenAlphaNumeric(const tsStrView_t* s, char namespaceChar, tsStrView_t* result);
+EXTERNC tsStrView_t tsStrViewGetTokenCharSet               (const tsStrView_t* s, tsCharSet_t const* accept, tsStrView_t* result);
 
 // get values
 EXTERNC tsStrView_t tsStrViewGetString (const tsStrView_t* s, bool recognizeEscapes, tsStrView_t* result);
@@ -133,13 +197,23 @@ EXTERNC tsStrView_t tsStrViewGetString2(const tsStrView_t* s, char strDelim, boo
 EXTERNC tsStrView_t tsStrViewGetInt16  (const tsStrView_t* s, int16_t* result);
 EXTERNC tsStrView_t tsStrViewGetInt32  (const tsStrView_t* s, int32_t* result);
 EXTERNC tsStrView_t tsStrViewGetUInt32 (const tsStrView_t* s, uint32_t* result);
+EXTERNC tsStrView_t tsStrViewGetInt64  (const tsStrView_t* s, int64_t* result, bool* overflow);
+EXTERNC tsStrView_t tsStrViewGetUInt64 (const tsStrView_t* s, uint64_t* result, bool* overflow);
 EXTERNC tsStrView_t tsStrViewGetHex    (const tsStrView_t* s, uint32_t* result);
 EXTERNC tsStrView_t tsStrViewGetFloat  (const tsStrView_t* s, float* result);
+EXTERNC tsStrView_t tsStrViewGetDouble (const tsStrView_t* s, double* result);
+
+// As tsParseDoubles and its kin, returning the input that follows the values read.
+EXTERNC tsStrView_t tsStrViewParseDoubles(const tsStrView_t* s, tsCharSet_t const* separators, double* values, size_t capacity, size_t* count);
+EXTERNC tsStrView_t tsStrViewParseFloats (const tsStrView_t* s, tsCharSet_t const* separators, float* values, size_t capacity, size_t* count);
+EXTERNC tsStrView_t tsStrViewParseInts   (const tsStrView_t* s, tsCharSet_t const* separators, int64_t* values, size_t capacity, size_t* count);
 
 // Scanning
 EXTERNC tsStrView_t tsStrViewExpect                          (const tsStrView_t* s, const tsStrView_t* expect);
 EXTERNC tsStrView_t tsStrViewStrip                           (const tsStrView_t* s);
 EXTERNC tsStrView_t tsStrViewScanForCharacter                (const tsStrView_t* s, char c);
+EXTERNC tsStrView_t tsStrViewScanForCharSet                  (const tsStrView_t* s, tsCharSet_t const* set);
+EXTERNC tsStrView_t tsStrViewScanPastCharSet                 (const tsStrView_t* s, tsCharSet_t const* set);
 EXTERNC tsStrView_t tsStrViewScanBackwardsForCharacter       (const tsStrView_t* s, char c);
 EXTERNC tsStrView_t tsStrViewScanForWhiteSpace               (const tsStrView_t* s);
 EXTERNC tsStrView_t tsStrViewScanBackwardsForWhiteSpace      (const tsStrView_t* s);
@@ -155,6 +229,30 @@ EXTERNC tsStrView_t tsStrViewScanPastCPPCommentsSkipped      (const tsStrView_t*
 EXTERNC tsStrView_t tsStrViewSkipCommentsAndWhiteSpace       (const tsStrView_t* s);
 EXTERNC tsStrView_t tsStrViewSkipCommentsAndWhiteSpaceSkipped(const tsStrView_t* s, tsStrView_t* skipped);
 
+//-----------------------------------------------------------------------------
+// Memory mapped files
+//-----------------------------------------------------------------------------
+
+// A file mapped read-only, so that it can be scanned and parsed in place
+// rather than copied into a buffer. Pages are read as they are touched, and
+// the mapping is hinted for a sequential pass with read ahead; the hints are
+// applied where the platform headers declare them. An empty file maps to an
+// empty view.
+typedef enum {
+    tsMapSequential = 0,
+    tsMapRandom = 1,        // hint random access, and do not read ahead
+    tsMapHugePages = 2,     // ask for huge pages, where the system supports them for files
+} tsMapFlags_t;
+
+typedef struct tsMappedFile_t {
+    char const* data;       // NULL if the file is not mapped
+    size_t size;
+} tsMappedFile_t;
+
+EXTERNC _Bool       tsMappedFile_Open (tsMappedFile_t* file, char const* path, unsigned flags);    // flags are tsMapFlags_t
+EXTERNC void        tsMappedFile_Close(tsMappedFile_t* file);
+EXTERNC tsStrView_t tsMappedFile_View (tsMappedFile_t const* file);
+
 //-----------------------------------------------------------------------------
 // Sexpr parser
 //-----------------------------------------------------------------------------
@@ -179,9 +277,132 @@ typedef struct tsParsedSexpr_t {
     struct tsParsedSexpr_t* next;
 } tsParsedSexpr_t;
 
-EXTERNC tsParsedSexpr_t* tsParsedSexpr_New();
+EXTERNC tsParsedSexpr_t* tsParsedSexpr_New();                         // NULL if out of memory
+EXTERNC void             tsParsedSexpr_Free(tsParsedSexpr_t* list);   // frees a list of cells from tsParsedSexpr_New
 EXTERNC tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int balance);
 
+// Reads the number an atom begins with in one pass, deciding integer or
+// float as the digits are accumulated. Returns the end of the number, with
+// *token tsSexprInteger or tsSexprFloat and the value in *i or *f, or pCurr
+// if the atom is not a number. An integer too large for 64 bits is a float.
+EXTERNC char const* tsSexprGetNumber(char const* pCurr, char const* pEnd, tsSexprToken_t* token, int64_t* i, double* f);
+// As tsSexprGetNumber, finding the end and kind of the number without
+// converting it; tsSexprGetNumber over the same bytes gives its value.
+EXTERNC char const* tsSexprScanNumber(char const* pCurr, char const* pEnd, tsSexprToken_t* token);
+
+// An arena hands out cells from large slabs instead of one malloc per cell.
+// Every cell is released at once by tsSexprArena_Free, or recycled for the
+// next parse by tsSexprArena_Reset, so the list needs no per-cell free.
+typedef struct tsSexprArenaSlab_t tsSexprArenaSlab_t;
+
+typedef struct tsSexprArena_t {
+    tsSexprArenaSlab_t* slabs;      // slabs in use, the newest first
+    tsSexprArenaSlab_t* spare;      // slabs recycled by tsSexprArena_Reset
+    size_t used;                    // cells handed out from the newest slab
+    size_t cellsPerSlab;
+} tsSexprArena_t;
+
+EXTERNC void             tsSexprArena_Init (tsSexprArena_t* arena, size_t cellsPerSlab);    // 0 picks a default
+EXTERNC tsParsedSexpr_t* tsSexprArena_New  (tsSexprArena_t* arena);    // NULL if out of memory
+EXTERNC void             tsSexprArena_Reset(tsSexprArena_t* arena);
+EXTERNC void             tsSexprArena_Free (tsSexprArena_t* arena);
+
+// as tsStrViewParseSexpr, taking cells from arena; a NULL arena uses tsParsedSexpr_New
+EXTERNC tsStrView_t tsStrViewParseSexprArena(tsStrView_t* s, tsParsedSexpr_t* currCell, int balance, tsSexprArena_t* arena);
+
+// The parsers are iterative, so nesting costs no stack. maxDepth bounds the
+// nesting a document may have; exceeding it stops the parse with
+// tsSexprErrorDepth, returning an empty view at the offending paren.
+typedef enum {
+    tsSexprOk = 0,
+    tsSexprErrorSyntax,     // the input does not begin with a list
+    tsSexprErrorDepth,      // a list is nested deeper than maxDepth
+    tsSexprErrorMemory,     // an allocation failed, or a table outgrew its indices
+    tsSexprErrorUnterminated// the input ended inside a list or string
+} tsSexprStatus_t;
+
+typedef struct tsSexprParseOptions_t {
+    tsSexprArena_t* arena;  // NULL allocates each cell with tsParsedSexpr_New
+    int maxDepth;           // 0 for no limit
+} tsSexprParseOptions_t;
+
+EXTERNC tsStrView_t tsStrViewParseSexprWithOptions(tsStrView_t* s, tsParsedSexpr_t* currCell, int balance,
+                                                   tsSexprParseOptions_t const* options, tsSexprStatus_t* status);
+
+// A tape holds the parsed tokens in one contiguous array, so a document can
+// be walked, and whole lists skipped, without chasing a pointer per token.
+// Atoms and strings are (offset, length) slices of the source, which must
+// outlive the tape; one of 4 GB or more stops the parse with
+// tsSexprErrorMemory. A tsSexprPushList entry's match is the index of its
+// tsSexprPopList, or count if the list is not closed before the parse ends,
+// at the end of the input or at an error; a tsSexprPopList's match is the
+// index of its tsSexprPushList, or tsSexprTapeNoMatch.
+#define tsSexprTapeNoMatch (~(uint64_t) 0)
+
+typedef struct tsSexprTapeEntry_t {
+    uint32_t token;             // a tsSexprToken_t
+    uint32_t length;            // atoms and strings: length in bytes
+    union {
+        int64_t  i;             // tsSexprInteger
+        double   f;             // tsSexprFloat
+        uint64_t offset;        // tsSexprAtom, tsSexprString: byte offset into the source
+        uint64_t match;         // tsSexprPushList, tsSexprPopList
+    };
+} tsSexprTapeEntry_t;
+
+typedef struct tsSexprTape_t {
+    tsSexprTapeEntry_t* entries;
+    size_t count;
+    size_t capacity;
+    char const* source;         // the text the slices refer to
+} tsSexprTape_t;
+
+EXTERNC void        tsSexprTape_Init  (tsSexprTape_t* tape);
+EXTERNC void        tsSexprTape_Free  (tsSexprTape_t* tape);
+EXTERNC tsStrView_t tsSexprTape_String(tsSexprTape_t const* tape, size_t index);   // atoms and strings
+EXTERNC size_t      tsSexprTape_Skip  (tsSexprTape_t const* tape, size_t index);   // index of the next sibling
+
+// Parses s into tape, replacing its contents and reusing its allocation.
+// options->arena is not used.
+EXTERNC tsStrView_t tsStrViewParseSexprTape(tsStrView_t* s, tsSexprTape_t* tape,
+                                            tsSexprParseOptions_t const* options, tsSexprStatus_t* status);
+
+// A handler receives each token as it is parsed, and nothing is stored.
+// Atoms and strings are views into the source. Any callback may be NULL.
+typedef struct tsSexprHandler_t {
+    void* user;
+    void (*onPush)  (void* user);
+    void (*onPop)   (void* user);
+    void (*onAtom)  (void* user, tsStrView_t atom);
+    void (*onString)(void* user, tsStrView_t str);
+    void (*onInt)   (void* user, int64_t i);
+    void (*onFloat) (void* user, double f);
+} tsSexprHandler_t;
+
+// options->arena is not used.
+EXTERNC tsStrView_t tsStrViewParseSexprHandler(tsStrView_t* s, tsSexprHandler_t const* handler,
+                                               tsSexprParseOptions_t const* options, tsSexprStatus_t* status);
+
+// Stage one of a two stage parse of the C++ Sexpr grammar. 64 bytes at a
+// time, it classifies every byte, steps over strings and comments with bit
+// operations, and records the offset of each paren and of the first byte of
+// each other token. The index is the same at every tsSimdLevel_t.
+typedef struct tsSexprIndexer_t {
+    uint64_t escapedCarry;      // the next block's first byte is escaped
+    uint64_t nextInside;        // bytes of the next block already in a string
+    int state;                  // outside, or in which kind of string or comment
+    int afterSeparator;         // a token may begin with the next block's first byte
+} tsSexprIndexer_t;
+
+EXTERNC void tsSexprIndexer_Init(tsSexprIndexer_t* indexer);
+
+// Indexes p up to end, writing offsets from p, and stops early once fewer
+// than 64 entries are left in offsets. Returns the bytes indexed, a multiple
+// of 64 unless end was reached; *count receives the number of offsets. Call
+// again from where it stopped, with the same indexer, to continue.
+EXTERNC size_t tsSexprIndexStructure(tsSexprIndexer_t* indexer, char const* p, char const* end,
+                                     uint32_t* offsets, size_t capacity, size_t* count);
+
 
 
 //-----------------------------------------------------------------------------
@@ -191,10 +412,63 @@ EXTERNC tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCel
 #ifdef __cplusplus
 
 #include <string.h>
+#include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace lab { namespace Text {
 
+// CharSet is a tsCharSet_t that can be built at compile time, so a tokenizer
+// can keep its accepted characters in a constexpr table instead of an ext
+// string that is re-walked for every byte.
+struct CharSet : public tsCharSet_t
+{
+    constexpr CharSet() : tsCharSet_t{{0}} {}
+    constexpr explicit CharSet(const char* chars) : tsCharSet_t{{0}} {
+        Add(chars);
+    }
+
+    constexpr CharSet& Add(char c) {
+        uint8_t u = static_cast<uint8_t>(c);
+        bits[((u & 0x80) >> 3) | (u & 0x0f)] |= static_cast<uint8_t>(1u << ((u >> 4) & 7));
+        return *this;
+    }
+    constexpr CharSet& Add(const char* chars) {
+        for (; chars && *chars; ++chars)
+            Add(*chars);
+        return *this;
+    }
+    constexpr CharSet& AddRange(char first, char last) {
+        for (int c = static_cast<uint8_t>(first); c <= static_cast<uint8_t>(last); ++c)
+            Add(static_cast<char>(c));
+        return *this;
+    }
+    constexpr bool Contains(char c) const {
+        uint8_t u = static_cast<uint8_t>(c);
+        return (bits[((u & 0x80) >> 3) | (u & 0x0f)] >> ((u >> 4) & 7)) & 1;
+    }
+    constexpr CharSet operator|(CharSet const& rhs) const {
+        CharSet result;
+        for (int i = 0; i < 32; ++i)
+            result.bits[i] = static_cast<uint8_t>(bits[i] | rhs.bits[i]);
+        return result;
+    }
+    constexpr CharSet operator~() const {
+        CharSet result;
+        for (int i = 0; i < 32; ++i)
+            result.bits[i] = static_cast<uint8_t>(~bits[i]);
+        return result;
+    }
+
+    static constexpr CharSet AlphaNumeric() {
+        return CharSet().AddRange('0', '9').AddRange('A', 'Z').AddRange('a', 'z');
+    }
+    static constexpr CharSet WhiteSpace() {
+        return CharSet(" \t\r\n");
+    }
+};
+
 // StrView provides a non-owning view on a memory range meant to be
 // interpreted as a UTF8 string. 
 struct StrView : public tsStrView_t
@@ -287,6 +561,14 @@ struct StrView : public tsStrView_t
     StrView GetNameSpacedTokenAlphaNumeric(char namespaceChar, StrView& result) const {
         return tsStrViewGetNameSpacedTokenAlphaNumeric(this, namespaceChar, static_cast<tsStrView_t*>(&result));
     }
+    // accepts exactly the bytes in the set; white space only if the set contains it
+    StrView GetTokenExt(CharSet const& accept, StrView& result) const {
+        return tsStrViewGetTokenCharSet(this, &accept, static_cast<tsStrView_t*>(&result));
+    }
+    StrView GetTokenAlphaNumericExt(CharSet const& ext, StrView& result) const {
+        CharSet accept = CharSet::AlphaNumeric() | ext;
+        return tsStrViewGetTokenCharSet(this, &accept, static_cast<tsStrView_t*>(&result));
+    }
     StrView GetString(bool recognizeEscapes, StrView& result) const {
         return tsStrViewGetString(this, recognizeEscapes, static_cast<tsStrView_t*>(&result));
     }
@@ -299,6 +581,12 @@ struct StrView : public tsStrView_t
     StrView GetInt32(int32_t& result) const {
         return tsStrViewGetInt32(this, &result);
     }
+    StrView GetInt64(int64_t& result, bool* overflow = nullptr) const {
+        return tsStrViewGetInt64(this, &result, overflow);
+    }
+    StrView GetUInt64(uint64_t& result, bool* overflow = nullptr) const {
+        return tsStrViewGetUInt64(this, &result, overflow);
+    }
     StrView GetUInt32(uint32_t& result) const {
         return tsStrViewGetUInt32(this, &result);
     }
@@ -308,9 +596,28 @@ struct StrView : public tsStrView_t
     StrView GetFloat(float& result) const {
         return tsStrViewGetFloat(this, &result);
     }
+    StrView GetDouble(double& result) const {
+        return tsStrViewGetDouble(this, &result);
+    }
+    // fill values with up to capacity numbers, with count set to how many were read
+    StrView ParseDoubles(CharSet const& separators, double* values, size_t capacity, size_t& count) const {
+        return tsStrViewParseDoubles(this, &separators, values, capacity, &count);
+    }
+    StrView ParseFloats(CharSet const& separators, float* values, size_t capacity, size_t& count) const {
+        return tsStrViewParseFloats(this, &separators, values, capacity, &count);
+    }
+    StrView ParseInts(CharSet const& separators, int64_t* values, size_t capacity, size_t& count) const {
+        return tsStrViewParseInts(this, &separators, values, capacity, &count);
+    }
     StrView ScanForCharacter(char c) const {
         return tsStrViewScanForCharacter(this, c);
     }
+    StrView ScanForCharSet(CharSet const& set) const {
+        return tsStrViewScanForCharSet(this, &set);
+    }
+    StrView ScanPastCharSet(CharSet const& set) const {
+        return tsStrViewScanPastCharSet(this, &set);
+    }
     StrView ScanBackwardsForCharacter(char c) const {
         return tsStrViewScanBackwardsForCharacter(this, c);
     }
@@ -363,274 +670,1276 @@ struct StrView : public tsStrView_t
 
 std::vector<StrView> Split(StrView s, char split);
 
-struct Sexpr {
+// MappedFile maps a file for as long as it lives, and converts to a StrView
+// of its contents, so a file can be handed straight to Sexpr, Split or the
+// scanners without being read into a string.
+class MappedFile
+{
+public:
+    MappedFile() { file.data = nullptr; file.size = 0; }
+    explicit MappedFile(char const* path, unsigned flags = tsMapSequential) {
+        tsMappedFile_Open(&file, path, flags);
+    }
+    explicit MappedFile(std::string const& path, unsigned flags = tsMapSequential)
+    : MappedFile(path.c_str(), flags) {}
+    ~MappedFile() { tsMappedFile_Close(&file); }
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+    MappedFile(MappedFile&& rhs) : file(rhs.file) {
+        rhs.file.data = nullptr;
+        rhs.file.size = 0;
+    }
+    MappedFile& operator=(MappedFile&& rhs) {
+        if (this != &rhs) {
+            tsMappedFile_Close(&file);
+            file = rhs.file;
+            rhs.file.data = nullptr;
+            rhs.file.size = 0;
+        }
+        return *this;
+    }
 
-    struct Elem {
-        tsSexprToken_t token;
-        int ref;
+    bool Valid() const { return file.data != nullptr; }
+    char const* Data() const { return file.data; }
+    size_t Size() const { return file.size; }
+    StrView View() const { return StrView(file.data, file.size); }
+    operator StrView() const { return View(); }
+
+private:
+    tsMappedFile_t file;
+};
+
+// LineIndex records where every line of a buffer starts, so that offsets can
+// be turned into line and column numbers by binary search instead of
+// rescanning from the top. Lines end the way tsScanForEndOfLine ends them: at
+// \n, \r, \r\n or \n\r. Lines and columns are zero based, a buffer that
+// ends with a line break has a final empty line, and the buffer must outlive
+// the index.
+//
+// A lazy index is built by the first query, so an unbuilt lazy index must not
+// be shared between threads. threads == 0 builds in parallel across all
+// cores for buffers over 1 GB, and serially otherwise.
+class LineIndex
+{
+public:
+    struct Location {
+        size_t line;
+        size_t column;
     };
 
-    std::vector<Elem>        expr;
-    std::vector<int>         ints;
-    std::vector<float>       floats;
-    std::vector<std::string> strings;
+    explicit LineIndex(StrView s, bool lazy = false, unsigned threads = 0)
+    : source(s), threads(threads) {
+        if (!lazy)
+            Build();
+    }
 
-    int balance = 0;
+    size_t LineCount() const {
+        Build();
+        return starts.size();
+    }
+    size_t LineStart(size_t line) const {
+        Build();
+        return starts[line];
+    }
+    // offsets inside a line break belong to the line the break ends
+    Location Find(size_t offset) const;
+    Location Find(char const* p) const {
+        return Find(static_cast<size_t>(p - source.curr));
+    }
+    // the text of a line, without its line break
+    StrView Line(size_t line) const;
 
-    explicit Sexpr(StrView s) {
-        Parse(s);
+private:
+    void Build() const {
+        if (!built)
+            BuildIndex();
     }
+    void BuildIndex() const;
+
+    StrView source;
+    unsigned threads;
+    mutable std::vector<size_t> starts;
+    mutable bool built = false;
+};
+
+// SymbolTable interns names, giving each distinct name a dense 32 bit id, so
+// names can be compared and dispatched on as integers. It owns copies of the
+// names, so one table can outlive, and be shared by, many documents. Lookup
+// is open addressing over a power of two table. Not thread safe.
+class SymbolTable
+{
+public:
+    static constexpr uint32_t NoSymbol = 0xffffffffu;
+
+    explicit SymbolTable(size_t expected = 0);
+
+    uint32_t Intern(StrView name);      // the id of name, adding it if it is new
+    uint32_t Find(StrView name) const;  // the id of name, or NoSymbol
+    StrView Name(uint32_t id) const { return names[id]; }    // valid as long as the table
+    size_t Size() const { return names.size(); }
+
+    static uint64_t Hash(StrView name);
 
 private:
-    StrView Parse(StrView s) {
-        StrView curr = s;
-        while (true) {
-            curr = curr.ScanForNonWhiteSpace();
-            if (curr.sz == 0)
-                return curr; // parsing finished
-            if (*curr.curr == ';') {
-                curr = curr.ScanForBeginningOfNextLine(); // Lisp comment
-                continue;
-            }
-            if (*curr.curr != '(') {
-                curr.sz = 0; // stop parsing
-                return curr; // error
-            }
-            break;
-        }
-        ++balance;
-        expr.push_back({ tsSexprPushList, 0 });
+    uint32_t Probe(StrView name, uint64_t hash, size_t& slot) const;
+    void Rehash(size_t slotCount);
+    char const* Store(StrView name);
+
+    std::vector<StrView> names;         // by id
+    std::vector<uint64_t> hashes;       // by id, so rehashing never reads the names
+    std::vector<uint32_t> slots;        // id + 1, or 0 if empty
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* blockNext = nullptr;          // the next free byte of the current block
+    size_t blockFree = 0;
+};
 
-        curr.curr++;
-        curr.sz--;
+struct SexprOptions {
+    int maxDepth = 0;               // deepest nesting accepted, 0 for no limit
+    bool zeroCopy = false;          // fill Sexpr::views instead of Sexpr::strings
+    bool unescapeStrings = false;   // resolve backslash escapes in quoted strings
+    bool lazyNumbers = false;       // keep the text of numbers, converting each when it is first read
+    SymbolTable* symbols = nullptr; // intern atoms; an atom's ref is then its symbol id
+    unsigned threads = 1;           // parse top-level forms in parallel; 0 for one per core
+};
 
-        while (true) {
-            curr = curr.ScanForNonWhiteSpace();
-            if (curr.sz == 0)
-                return curr;
+// A handler for ParseSexpr. Derive from SexprHandler and hide the calls of
+// interest; the parser is a template over the handler, so the calls inline
+// and nothing is stored. Atoms and strings are views into the source.
+struct SexprHandler {
+    void OnPush() {}
+    void OnPop() {}
+    void OnAtom(StrView /*atom*/) {}
+    void OnString(StrView /*str*/, bool /*escapes*/) {}  // escapes: backslashes in str are escapes
+    void OnInt(int64_t /*i*/) {}
+    void OnFloat(double /*f*/) {}
+
+    // If DecodeNumbers returns false, each number arrives as its text and
+    // kind, tsSexprInteger or tsSexprFloat, in place of OnInt and OnFloat.
+    bool DecodeNumbers() const { return true; }
+    void OnNumber(StrView /*text*/, tsSexprToken_t /*token*/) {}
+
+    // Asked after each paren and token. Once it returns true, the parse stops
+    // there with tsSexprErrorMemory.
+    bool Full() const { return false; }
+};
 
-            if (*curr.curr == ';') {
-                curr = curr.ScanForBeginningOfNextLine().ScanForNonWhiteSpace();
-                continue;
-            }
-            if (*curr.curr == '"') {
-                StrView str;
-                curr = curr.GetString(true, str).ScanForNonWhiteSpace();
-                expr.push_back({ tsSexprString, (int)strings.size() });
-                strings.push_back(std::string(str.curr, str.sz));
-                if (curr.sz == 0)
-                    return curr;
-                continue;
-            }
-            // Handle § delimited strings (both Latin-1 and UTF-8)
-            if (*curr.curr == '\xA7') { // Latin-1 §
-                StrView str;
-                curr = curr.GetString2(0, '\xA7', true, str).ScanForNonWhiteSpace();
-                expr.push_back({ tsSexprString, (int)strings.size() });
-                strings.push_back(std::string(str.curr, str.sz));
-                if (curr.sz == 0)
-                    return curr;
-                continue;
-            }
-            if (curr.sz > 1 && *curr.curr == '\xC2' && *(curr.curr + 1) == '\xA7') { // UTF-8 §
-                // Manual UTF-8 § parsing since GetString2 expects single-byte delimiters
-                const char* original_start = curr.curr;
-                const char* original_limit = curr.curr + curr.sz;
-                
-                curr.curr += 2; // Skip opening UTF-8 §
-                curr.sz -= 2;
-                
-                const char* start = curr.curr;
-                const char* end = curr.curr;
-                const char* limit = curr.curr + curr.sz;
-                
-                // Find closing UTF-8 § sequence
-                while (end < limit - 1) {
-                    if (*end == '\xC2' && *(end + 1) == '\xA7') {
-                        break;
-                    }
-                    ++end;
-                }
-                
-                if (end < limit - 1 && end + 2 <= original_limit) {
-                    // Found closing delimiter and it's within bounds
-                    expr.push_back({ tsSexprString, (int)strings.size() });
-                    strings.push_back(std::string(start, end - start));
-                    curr.curr = end + 2; // Skip closing UTF-8 §
-                    curr.sz = original_limit - (end + 2);
-                } else {
-                    // No closing delimiter or out of bounds - treat as unterminated string
-                    expr.push_back({ tsSexprString, (int)strings.size() });
-                    strings.push_back(std::string(start, limit - start));
-                    curr.curr = original_limit;
-                    curr.sz = 0;
-                }
-                curr = curr.ScanForNonWhiteSpace();
-                if (curr.sz == 0)
-                    return curr;
-                continue;
-            }
-            if (*curr.curr == ')') {
-                --balance;
-                expr.push_back({ tsSexprPopList, 0 });
-                curr.curr++;
-                curr.sz--;
-                continue;
-            }
-            if (*curr.curr == '(') {
-                curr = Parse(curr);
-                continue;
-            }
+// Lexes the string or atom at the start of curr, which is not white space,
+// a paren or a comment, and returns the input that follows it. A number may
+// be followed by more of its token, which is lexed as further numbers or an
+// atom; the token ends where an atom would.
+template <class Handler>
+StrView ParseSexprToken(StrView curr, Handler& handler)
+{
+    if (*curr.curr == '"') {
+        StrView str;
+        curr = curr.GetString(true, str);
+        handler.OnString(str, true);
+        return curr;
+    }
+    // Handle § delimited strings (both Latin-1 and UTF-8)
+    if (*curr.curr == '\xA7') { // Latin-1 §
+        StrView str;
+        curr = curr.GetString2(0, '\xA7', true, str);
+        handler.OnString(str, true);
+        return curr;
+    }
+    if (curr.sz > 1 && *curr.curr == '\xC2' && *(curr.curr + 1) == '\xA7') { // UTF-8 §
+        // Manual UTF-8 § parsing since GetString2 expects single-byte delimiters
+        const char* original_limit = curr.curr + curr.sz;
 
-            StrView token = curr;
-            token.sz = 0;
-            while (curr.sz > 0) {
-                if (*curr.curr == '"')
-                    break;
-                if (*curr.curr == '(')
-                    break;
-                if (*curr.curr == ')')
-                    break;
-                if (tsIsWhiteSpace(*curr.curr))
-                    break;
-                if (*curr.curr == ';')
-                    break;
-                // Removed § checks from atom tokenization to prevent false positives
-                // with multi-byte UTF-8 sequences like 🧠 which contains A7 byte
-                token.sz++;
-                curr.curr++;
-                curr.sz--;
-            }
-            if (!token.sz)
-                continue;
+        curr.curr += 2; // Skip opening UTF-8 §
+        curr.sz -= 2;
 
-            float f;
-            StrView test = token.GetFloat(f);
-            if (test.curr != token.curr) {
-                expr.push_back({ tsSexprFloat, (int)floats.size() });
-                floats.push_back(f);
-                curr.curr = test.curr;
-                curr.sz -= test.sz;
-            }
-            else {
-                int32_t i;
-                StrView test = token.GetInt32(i);
-                if (test.curr != token.curr) {
-                    expr.push_back({ tsSexprInteger, (int)ints.size() });
-                    ints.push_back(i);
-                    curr.curr = test.curr;
-                    curr.sz -= test.sz;
-                }
-                else {
-                    expr.push_back({ tsSexprAtom, (int)strings.size() });
-                    strings.push_back(std::string(token.curr, token.sz));
-                }
+        const char* start = curr.curr;
+        const char* end = curr.curr;
+        const char* limit = curr.curr + curr.sz;
+
+        // Find closing UTF-8 § sequence
+        while (end < limit - 1) {
+            end = tsScanForCharacter(end, limit - 1, '\xC2');
+            if (end < limit - 1 && *(end + 1) == '\xA7') {
+                break;
             }
-            curr = curr.ScanForNonWhiteSpace();
+            ++end;
         }
+
+        if (end < limit - 1 && end + 2 <= original_limit) {
+            // Found closing delimiter and it's within bounds
+            handler.OnString(StrView(start, end - start), false);
+            curr.curr = end + 2; // Skip closing UTF-8 §
+            curr.sz = original_limit - (end + 2);
+        } else {
+            // No closing delimiter or out of bounds - treat as unterminated string
+            handler.OnString(StrView(start, limit - start), false);
+            curr.curr = original_limit;
+            curr.sz = 0;
+        }
+        return curr;
     }
-};
 
+    // Removed § checks from atom tokenization to prevent false positives
+    // with multi-byte UTF-8 sequences like 🧠 which contains A7 byte
+    static constexpr CharSet atomEnd = CharSet("\"();") | CharSet::WhiteSpace();
+    char const* p = curr.curr;
+    char const* end = curr.curr + curr.sz;
+    while (p < end && !atomEnd.Contains(*p)) {
+        // numbers are classified and converted in the pass that finds their end
+        tsSexprToken_t number;
+        int64_t i;
+        double f;
+        bool decode = handler.DecodeNumbers();
+        char const* next = decode ? tsSexprGetNumber(p, end, &number, &i, &f) : tsSexprScanNumber(p, end, &number);
+        if (next == p) {
+            StrView rest = StrView(p, end - p).ScanForCharSet(atomEnd);
+            handler.OnAtom(StrView(p, rest.curr - p));
+            return rest;
+        }
+        if (!decode)
+            handler.OnNumber(StrView(p, next - p), number);
+        else if (number == tsSexprInteger)
+            handler.OnInt(i);
+        else
+            handler.OnFloat(f);
+        p = next;
+    }
+    return StrView(p, end - p);
+}
 
+// Parses s, calling handler for each token. Iterative; nesting is tracked by
+// a count alone, so deep documents cost no stack. On error, errorOffset, if
+// given, receives the offset into s where parsing stopped.
+template <class Handler>
+tsSexprStatus_t ParseSexpr(StrView s, Handler& handler, SexprOptions const& options = SexprOptions(),
+                           size_t* errorOffset = nullptr)
+{
+    StrView curr = s;
+    int balance = 0;
+    auto fail = [&](tsSexprStatus_t error) {
+        if (errorOffset)
+            *errorOffset = static_cast<size_t>(curr.curr - s.curr);
+        return error;
+    };
 
-}} // lab::Text
+    while (true) {
+        curr = curr.ScanForNonWhiteSpace();
+        if (curr.sz == 0)
+            return tsSexprOk; // parsing finished
+        if (*curr.curr == ';') {
+            curr = curr.ScanForBeginningOfNextLine(); // Lisp comment
+            continue;
+        }
+        if (*curr.curr != '(')
+            return fail(tsSexprErrorSyntax);
+        break;
+    }
 
-#endif // cplusplus
+    while (true) {
+        curr = curr.ScanForNonWhiteSpace();
+        if (curr.sz == 0)
+            return tsSexprOk;
 
+        if (*curr.curr == ';') {
+            curr = curr.ScanForBeginningOfNextLine().ScanForNonWhiteSpace();
+            continue;
+        }
+        if (*curr.curr == ')') {
+            --balance;
+            handler.OnPop();
+            if (handler.Full())
+                return fail(tsSexprErrorMemory);
+            curr.curr++;
+            curr.sz--;
+            continue;
+        }
+        if (*curr.curr == '(') {
+            if (options.maxDepth > 0 && balance >= options.maxDepth)
+                return fail(tsSexprErrorDepth);
+            ++balance;
+            handler.OnPush();
+            if (handler.Full())
+                return fail(tsSexprErrorMemory);
+            curr.curr++;
+            curr.sz--;
+            continue;
+        }
+        StrView next = ParseSexprToken(curr, handler);
+        if (handler.Full())
+            return fail(tsSexprErrorMemory);
+        curr = next;
+    }
+}
 
-#endif // LABTEXT_H
+// As ParseSexpr, in two stages: tsSexprIndexStructure finds every paren and
+// token a block at a time, then only those bytes are visited, so white space
+// and comments are never stepped through. The handler sees the same calls.
+template <class Handler>
+tsSexprStatus_t ParseSexprTwoStage(StrView s, Handler& handler, SexprOptions const& options = SexprOptions(),
+                                   size_t* errorOffset = nullptr)
+{
+    tsSexprIndexer_t indexer;
+    tsSexprIndexer_Init(&indexer);
+    uint32_t offsets[1024];
 
-#ifdef LABTEXT_ODR
+    char const* p = s.curr;
+    char const* end = s.curr + s.sz;
+    int balance = 0;
+    bool first = true;
+    while (p < end) {
+        size_t count;
+        size_t used = tsSexprIndexStructure(&indexer, p, end, offsets, sizeof(offsets) / sizeof(offsets[0]), &count);
+        for (size_t i = 0; i < count; ++i) {
+            char const* t = p + offsets[i];
+            if (first && *t != '(') {
+                if (errorOffset)
+                    *errorOffset = static_cast<size_t>(t - s.curr);
+                return tsSexprErrorSyntax;
+            }
+            first = false;
+            if (*t == ')') {
+                --balance;
+                handler.OnPop();
+            }
+            else if (*t == '(') {
+                if (options.maxDepth > 0 && balance >= options.maxDepth) {
+                    if (errorOffset)
+                        *errorOffset = static_cast<size_t>(t - s.curr);
+                    return tsSexprErrorDepth;
+                }
+                ++balance;
+                handler.OnPush();
+            }
+            else
+                ParseSexprToken(StrView(t, end - t), handler);
+            if (handler.Full()) {
+                if (errorOffset)
+                    *errorOffset = static_cast<size_t>(t - s.curr);
+                return tsSexprErrorMemory;
+            }
+        }
+        p += used;
+    }
+    return tsSexprOk;
+}
 
-//------------------------------------------------------------------------------
-// IMPLEMENTATION
-//------------------------------------------------------------------------------
+// Navigation over the expr and lists tables of a parsed document, shared by
+// Sexpr, which holds them in vectors, and SexprImage, which reads them in
+// place. Document derives from it and names the tables expr and lists.
+template <class Document>
+struct SexprNavigation {
+    // the element after the one at i, and all of its contents
+    size_t Next(size_t i) const {
+        auto const& d = Doc();
+        if (d.expr[i].token != tsSexprPushList)
+            return i + 1;
+        size_t end = d.lists[d.expr[i].ref].end;
+        return end < d.expr.size() ? end + 1 : end;
+    }
+    size_t Match(size_t i) const {      // the other paren of the list at i
+        auto const& d = Doc();
+        auto const& l = d.lists[d.expr[i].ref];
+        return d.expr[i].token == tsSexprPushList ? l.end : l.begin;
+    }
+    size_t ChildCount(size_t i) const {
+        auto const& d = Doc();
+        return d.lists[d.expr[i].ref].count;
+    }
+    // the nth child of the list at i, stepping over siblings; expr.size() if there is none
+    size_t Child(size_t i, size_t n) const {
+        auto const& d = Doc();
+        if (n >= d.lists[d.expr[i].ref].count)
+            return d.expr.size();
+        size_t c = i + 1;
+        while (n--)
+            c = Next(c);
+        return c;
+    }
 
-#include <math.h>
-#include <stdbool.h>
+private:
+    Document const& Doc() const { return static_cast<Document const&>(*this); }
+};
 
-//! @todo replace Assert with custom error reporting mechanism
-#include <assert.h>
-#define Assert assert
+// The largest ref an element holds. A test may lower it to reach the limit
+// with a small document, defining it wherever the header is included.
+#ifndef LABTEXT_SEXPR_MAX_REF
+#define LABTEXT_SEXPR_MAX_REF ((1 << 28) - 1)
+#endif
 
+// Atoms and strings are copied into strings, unless options.zeroCopy is set.
+// Then views holds them instead, as views into the source, which must
+// outlive the Sexpr; only strings whose escapes are resolved are copied, all
+// into one shared buffer. String(ref) reads either.
+//
+// Given options.symbols, atoms are interned there instead, and an atom's ref
+// is its symbol id. Text(elem) reads any atom or string.
+//
+// With options.lazyNumbers, numbers are only classified while parsing, and
+// intSpans and floatSpans locate their text in the source, which must
+// outlive the Sexpr until the numbers are decoded. Int(ref) and Float(ref)
+// convert a number when it is first read and keep the value in ints or
+// floats, which are filled as numbers are read. Reading values is then not
+// safe from several threads at once until DecodeAllNumbers has converted
+// the rest. Sources over 4 GB are decoded as they are parsed.
+//
+// The ref of a tsSexprPushList, and of its tsSexprPopList, indexes lists,
+// which records where the list ends and how many direct children it has, so
+// siblings can be stepped over in constant time. An unmatched ) has ref -1.
+struct Sexpr : SexprNavigation<Sexpr> {
+
+    // A token and its ref packed in 32 bits, so refs run to MaxRef.
+    struct Elem {
+        uint32_t token : 3;     // a tsSexprToken_t
+        int32_t ref : 29;
+    };
+    static constexpr int MaxRef = LABTEXT_SEXPR_MAX_REF;
 
-/*
-* The two functions, tsConvertUtf16ToUtf8 and tsConvertUtf8ToUtf16 are
-* originally from the Effekseer library, and bear the following license:
+    struct List {
+        uint32_t begin;     // index of the tsSexprPushList
+        uint32_t end;       // index of the tsSexprPopList, or expr.size() if never closed
+        uint32_t count;     // direct children
+    };
 
-The MIT License (MIT)
+    struct NumberSpan {
+        uint32_t offset;    // from source
+        uint32_t size;      // 0 once decoded
+    };
 
-Copyright (c) 2011 Effekseer Project
+    std::vector<Elem>        expr;
+    std::vector<List>        lists;
+    mutable std::vector<int64_t> ints;      // mutable to cache lazily decoded numbers
+    mutable std::vector<double>  floats;
+    mutable std::vector<NumberSpan> intSpans;   // with lazyNumbers
+    mutable std::vector<NumberSpan> floatSpans;
+    std::vector<std::string> strings;
+    std::vector<StrView>     views;
+    std::shared_ptr<std::string> unescaped;     // escaped strings, when zeroCopy and unescapeStrings
 
-Permission is hereby granted, free of charge, to any person obtaining a copy of
-this software and associated documentation files (the "Software"), to deal in
-the Software without restriction, including without limitation the rights to
-use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
-the Software, and to permit persons to whom the Software is furnished to do so,
-subject to the following conditions:
+    SymbolTable* symbols = nullptr;    // must outlive the Sexpr
 
-The above copyright notice and this permission notice shall be included in all
-copies or substantial portions of the Software.
+    int balance = 0;
+    bool zeroCopy = false;
+    bool unescapeStrings = false;   // strings hold their values rather than their escaped text
+    bool lazyNumbers = false;
+    char const* source = nullptr;   // the text parsed, which spans are relative to
+
+    tsSexprStatus_t status = tsSexprOk;
+    size_t errorOffset = 0;     // where parsing stopped, if status is not tsSexprOk
+
+    // With options.threads other than 1, a large document is cut between
+    // top-level forms and the pieces are parsed concurrently; the result is
+    // the same as a serial parse.
+    explicit Sexpr(StrView s, SexprOptions const& options = SexprOptions())
+    : symbols(options.symbols), zeroCopy(options.zeroCopy), unescapeStrings(options.unescapeStrings),
+      lazyNumbers(options.lazyNumbers && s.sz <= UINT32_MAX), source(s.curr) {
+        if (options.threads == 1)
+            ParseSerial(s, options);
+        else
+            ParseParallel(s, options);
+    }
 
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
-FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
-COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
-IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
-CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+    StrView String(int ref) const {
+        return zeroCopy ? views[ref] : StrView(strings[ref]);
+    }
+    StrView Text(Elem const& e) const {
+        if (e.token == tsSexprAtom && symbols)
+            return symbols->Name(static_cast<uint32_t>(e.ref));
+        return String(e.ref);
+    }
 
-*/
+    // the values of tsSexprInteger and tsSexprFloat elements, decoded on first use
+    int64_t Int(int ref) const {
+        if (!intSpans.empty() && intSpans[ref].size)
+            DecodeNumber(tsSexprInteger, ref);
+        return ints[ref];
+    }
+    double Float(int ref) const {
+        if (!floatSpans.empty() && floatSpans[ref].size)
+            DecodeNumber(tsSexprFloat, ref);
+        return floats[ref];
+    }
 
-/**
-    @brief    Convert UTF16 into UTF8
-    @param    dst    a pointer to destination buffer
-    @param    dst_size    a length of destination buffer
-    @param    src            a source buffer
-    @return    length except 0
-*/
-int32_t tsConvertUtf16ToUtf8(char* dst, int32_t dst_size, const uint16_t* src)
-{
-    int32_t cnt = 0;
-    const uint16_t* wp = src;
-    char* cp = dst;
+    // Decodes every number not yet read, on up to threads threads, 0 for
+    // one per core, and releases intSpans and floatSpans.
+    void DecodeAllNumbers(unsigned threads = 0) const;
+
+    // Appends str to out, replacing \n, \r and \t with the control characters
+    // they name, and any other escaped character with itself.
+    static void Unescape(StrView str, std::string& out) {
+        char const* p = str.curr;
+        char const* end = str.curr + str.sz;
+        while (p < end) {
+            char const* q = tsScanForCharacter(p, end, '\\');
+            out.append(p, q);
+            if (q >= end - 1) {
+                out.append(q, end);   // a lone trailing backslash is kept
+                break;
+            }
+            switch (q[1]) {
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            default: out += q[1]; break;
+            }
+            p = q + 2;
+        }
+    }
 
-    if (dst_size == 0)
-        return 0;
+    // Appends a binary image of the Sexpr to image, for SexprImage to read
+    // in place. source is the text that was parsed; its hash is recorded so
+    // that a stale image can be detected. The symbol table, if there is one,
+    // is included whole, so that atom refs remain its ids. Numbers not yet
+    // read are decoded first.
+    void WriteImage(std::string& image, StrView source) const;
 
-    dst_size -= 3;
+private:
+    // The tables are sized from a pass of the structural index, so each is
+    // allocated once. The parse that follows indexes again where that is
+    // vectorized: keeping the offsets instead measured slower, as the
+    // second pass finds each block of the source still in cache.
+    void ParseSerial(StrView s, SexprOptions const& options) {
+        Reserve(s);
+        Builder builder{ *this, options.unescapeStrings };
+        if (tsGetSimdLevel() >= tsSimdAVX2)
+            status = ParseSexprTwoStage(s, builder, options, &errorOffset);
+        else
+            status = ParseSexpr(s, builder, options, &errorOffset);
+        builder.Finish();
+    }
 
-    for (cnt = 0; cnt < dst_size;)
-    {
-        uint16_t wc = *wp++;
-        if (wc == 0)
-        {
-            break;
+    // Each paren and token is at least one element, and its first bytes tell
+    // a list, a string, a number and which kind, or an atom. A token that
+    // runs on past a number, as in 12abc, is lexed as more than one element,
+    // and only then does a table grow.
+    void Reserve(StrView s) {
+        tsSexprIndexer_t indexer;
+        tsSexprIndexer_Init(&indexer);
+        uint32_t offsets[1024];
+        size_t elements = 0, opens = 0, strs = 0, atoms = 0, integers = 0, reals = 0;
+        char const* end = s.curr + s.sz;
+        for (char const* p = s.curr; p < end; ) {
+            size_t count;
+            size_t used = tsSexprIndexStructure(&indexer, p, end, offsets, sizeof(offsets) / sizeof(offsets[0]), &count);
+            elements += count;
+            for (size_t i = 0; i < count; ++i) {
+                char const* t = p + offsets[i];
+                tsSexprToken_t number;
+                if (*t == '(')
+                    ++opens;
+                else if (*t == ')')
+                    continue;
+                else if (*t == '"' || *t == '\xA7' || (*t == '\xC2' && t + 1 < end && t[1] == '\xA7'))
+                    ++strs;
+                else if (((*t >= '0' && *t <= '9') || *t == '-' || *t == '+' || *t == '.')
+                         && tsSexprScanNumber(t, end, &number) != t)
+                    ++(number == tsSexprInteger ? integers : reals);
+                else
+                    ++atoms;
+            }
+            p += used;
         }
-        if ((wc & ~0x7f) == 0)
-        {
-            if (cp)
-                *cp++ = wc & 0x7f;
-            cnt += 1;
+        expr.reserve(elements);
+        lists.reserve(opens);
+        if (lazyNumbers) {
+            intSpans.reserve(integers);
+            floatSpans.reserve(reals);
         }
-        else if ((wc & ~0x7ff) == 0)
-        {
-            if (cp) {
-                *cp++ = ((wc >> 6) & 0x1f) | 0xc0;
-                *cp++ = ((wc) & 0x3f) | 0x80;
-            }
-            cnt += 2;
+        else {
+            ints.reserve(integers);
+            floats.reserve(reals);
         }
+        size_t texts = strs + (symbols ? 0 : atoms);
+        if (zeroCopy)
+            views.reserve(texts);
         else
-        {
-            if (cp) {
-                *cp++ = ((wc >> 12) & 0xf) | 0xe0;
-                *cp++ = ((wc >> 6) & 0x3f) | 0x80;
-                *cp++ = ((wc) & 0x3f) | 0x80;
+            strings.reserve(texts);
+    }
+    void ParseParallel(StrView s, SexprOptions const& options);
+    void DecodeNumber(tsSexprToken_t token, int ref) const;
+    bool Append(Sexpr& part, SymbolTable const* partSymbols, std::string const* partUnescaped, size_t unescapedBase);
+
+    struct Builder : public SexprHandler {
+        Sexpr& sexpr;
+        bool unescape;
+        std::vector<std::pair<int, size_t>> moved;  // views into unescaped, as (ref, offset)
+        int open = -1;      // the innermost open list; an open list's end links to its parent
+        bool full = false;  // a ref would not fit in an Elem; the parse stops
+
+        Builder(Sexpr& sexpr, bool unescape) : sexpr(sexpr), unescape(unescape) {}
+
+        // False, and nothing is stored, if ref is past MaxRef.
+        bool Append(tsSexprToken_t token, size_t ref) {
+            if (full || ref > static_cast<size_t>(MaxRef)) {
+                full = true;
+                return false;
             }
-            cnt += 3;
+            if (open >= 0)
+                ++sexpr.lists[open].count;
+            sexpr.expr.push_back({ static_cast<uint32_t>(token), static_cast<int32_t>(ref) });
+            return true;
         }
-    }
-    *cp = '\0';
+
+        void Add(tsSexprToken_t token, StrView str) {
+            if (sexpr.zeroCopy) {
+                if (Append(token, sexpr.views.size()))
+                    sexpr.views.push_back(str);
+            }
+            else if (Append(token, sexpr.strings.size()))
+                sexpr.strings.push_back(std::string(str.curr, str.sz));
+        }
+
+        void Finish() {
+            // the buffer may move while it grows, so views into it are set at the end
+            for (auto const& m : moved)
+                sexpr.views[m.first].curr = sexpr.unescaped->data() + m.second;
+            // lists left open end with the document
+            while (open >= 0) {
+                List& l = sexpr.lists[open];
+                open = static_cast<int>(l.end);
+                l.end = static_cast<uint32_t>(sexpr.expr.size());
+            }
+        }
+
+        void OnPush() {
+            int list = (int)sexpr.lists.size();
+            if (!Append(tsSexprPushList, sexpr.lists.size()))
+                return;
+            ++sexpr.balance;
+            sexpr.lists.push_back({ (uint32_t)sexpr.expr.size() - 1, (uint32_t)open, 0 });
+            open = list;
+        }
+        void OnPop() {
+            --sexpr.balance;
+            int list = open;
+            if (list >= 0) {
+                List& l = sexpr.lists[list];
+                open = static_cast<int>(l.end);
+                l.end = static_cast<uint32_t>(sexpr.expr.size());
+            }
+            sexpr.expr.push_back({ static_cast<uint32_t>(tsSexprPopList), list });   // not a child of either list
+        }
+        void OnAtom(StrView atom) {
+            if (sexpr.symbols)
+                Append(tsSexprAtom, sexpr.symbols->Intern(atom));
+            else
+                Add(tsSexprAtom, atom);
+        }
+        void OnString(StrView str, bool escapes) {
+            if (!unescape || !escapes || tsScanForCharacter(str.curr, str.curr + str.sz, '\\') == str.curr + str.sz) {
+                Add(tsSexprString, str);
+                return;
+            }
+            if (!sexpr.zeroCopy) {
+                if (!Append(tsSexprString, sexpr.strings.size()))
+                    return;
+                sexpr.strings.emplace_back();
+                Unescape(str, sexpr.strings.back());
+                return;
+            }
+            if (!Append(tsSexprString, sexpr.views.size()))
+                return;
+            if (!sexpr.unescaped)
+                sexpr.unescaped = std::make_shared<std::string>();
+            size_t offset = sexpr.unescaped->size();
+            Unescape(str, *sexpr.unescaped);
+            moved.push_back({ (int)sexpr.views.size(), offset });
+            sexpr.views.push_back(StrView(nullptr, sexpr.unescaped->size() - offset));
+        }
+        void OnInt(int64_t i) {
+            if (Append(tsSexprInteger, sexpr.ints.size()))
+                sexpr.ints.push_back(i);
+        }
+        void OnFloat(double f) {
+            if (Append(tsSexprFloat, sexpr.floats.size()))
+                sexpr.floats.push_back(f);
+        }
+        bool DecodeNumbers() const { return !sexpr.lazyNumbers; }
+        void OnNumber(StrView text, tsSexprToken_t token) {
+            NumberSpan span = { static_cast<uint32_t>(text.curr - sexpr.source), static_cast<uint32_t>(text.sz) };
+            std::vector<NumberSpan>& spans = token == tsSexprInteger ? sexpr.intSpans : sexpr.floatSpans;
+            if (Append(token, spans.size()))
+                spans.push_back(span);
+        }
+        bool Full() const { return full; }
+    };
+};
+
+// KeywordIndex maps the keywords of property list style forms, such as
+// (ls-node :name "Gain-3" :pos 869 116), to their values. A keyword is an
+// atom beginning with ':' that is a direct child of a list, and its value is
+// the span of elements after it, up to the next keyword or the end of the
+// list. A keyword given more than once has a span for each. Keywords are
+// interned in symbols, which must be the Sexpr's own table if it has one.
+// The index refers into the Sexpr, which must outlive it.
+class KeywordIndex
+{
+public:
+    struct Span {
+        size_t begin = 0;       // expr indices of the values, end exclusive
+        size_t end = 0;
+        uint32_t entry = NoEntry;
+        bool Found() const { return entry != NoEntry; }
+        bool Empty() const { return begin == end; }
+    };
+
+    // Lookups for one list
+    class Form {
+    public:
+        Form(KeywordIndex const& index, size_t list) : index(&index), list(list) {}
+        Span operator[](StrView keyword) const { return index->Find(list, keyword); }
+        Span operator[](char const* keyword) const { return index->Find(list, StrView(keyword)); }
+        Span operator[](uint32_t symbol) const { return index->Find(list, symbol); }
+        size_t List() const { return list; }
+    private:
+        KeywordIndex const* index;
+        size_t list;
+    };
+
+    KeywordIndex(Sexpr const& sexpr, SymbolTable& symbols);
+
+    Form At(size_t list) const { return Form(*this, list); }    // list is the index of a tsSexprPushList
+    Span Find(size_t list, uint32_t symbol) const;
+    Span Find(size_t list, StrView keyword) const;
+    Span Next(Span const& span) const;      // the same keyword's next span in the same list
+    size_t Size() const { return entries.size(); }
+
+private:
+    static constexpr uint32_t NoEntry = 0xffffffffu;
+
+    struct Entry {
+        uint64_t key;           // list << 32 | symbol
+        uint32_t begin;
+        uint32_t end;
+        uint32_t next;          // the next entry with this key, or NoEntry
+    };
+
+    static uint64_t Key(size_t list, uint32_t symbol) {
+        return (static_cast<uint64_t>(list) << 32) | symbol;
+    }
+    static size_t Slot(uint64_t key, size_t mask) {
+        return static_cast<size_t>((key * 0x9e3779b97f4a7c15ull) >> 32) & mask;
+    }
+    Span SpanOf(uint32_t entry) const;
+    void Insert(uint32_t entry);
+
+    SymbolTable const& symbols;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> slots;    // the first entry for a key + 1, or 0 if empty
+};
+
+// SexprQuery finds forms in a Sexpr by pattern. A query is compiled once and
+// may then be run against any number of documents. It is written as Sexpr
+// text: one or more steps, each a list, optionally followed by a keyword.
+//
+//     (ls-node :kind "Gain") :name
+//     (graph) (ls-connection :from "Osc-1")
+//
+// A step (head :key value ...) matches a list whose first child is the atom
+// head, and in which each :key is followed by value; * matches any head or
+// value. The first step matches lists at any depth, and each later step the
+// direct children of the previous one's match. A trailing keyword selects
+// the values that follow it in each match, as KeywordIndex spans them. A
+// step may have at most 64 constraints; a query with more is not Valid().
+//
+// Matching steps over the children of a list by its skip links rather than
+// descending into them. With the SymbolTable of the Sexprs it will run
+// against, heads and keywords are compared as symbol ids.
+class SexprQuery
+{
+public:
+    struct Match {
+        size_t list;        // expr index of the matched list
+        size_t begin;       // expr indices of the result, end exclusive: the list, or the
+        size_t end;         // values of the selected keyword
+    };
+
+    explicit SexprQuery(StrView query, SymbolTable* symbols = nullptr);
+
+    bool Valid() const { return valid; }
+
+    template <class Handler>    // handler(Match const&)
+    void Run(Sexpr const& sexpr, Handler&& handler) const {
+        if (!valid)
+            return;
+        for (Sexpr::List const& list : sexpr.lists)
+            if (Matches(sexpr, steps[0], list.begin))
+                Descend(sexpr, 1, list.begin, handler);
+    }
+    std::vector<Match> Find(Sexpr const& sexpr) const {
+        std::vector<Match> matches;
+        Run(sexpr, [&](Match const& m) { matches.push_back(m); });
+        return matches;
+    }
+
+private:
+    struct Name {
+        std::string text;
+        uint32_t symbol = SymbolTable::NoSymbol;
+        bool any = false;
+    };
+    struct Value {
+        tsSexprToken_t token = tsSexprAtom;
+        Name name;          // atoms and strings
+        double number = 0;
+        int64_t integer = 0;
+    };
+    struct Constraint {
+        Name key;
+        Value value;
+    };
+    struct Step {
+        Name head;
+        std::vector<Constraint> where;
+    };
+
+    template <class Handler>
+    void Descend(Sexpr const& sexpr, size_t step, size_t list, Handler& handler) const {
+        if (step == steps.size()) {
+            Match m;
+            if (Select(sexpr, list, m))
+                handler(static_cast<Match const&>(m));
+            return;
+        }
+        size_t end = sexpr.Match(list);
+        for (size_t c = list + 1; c < end; c = sexpr.Next(c))
+            if (sexpr.expr[c].token == tsSexprPushList && Matches(sexpr, steps[step], c))
+                Descend(sexpr, step + 1, c, handler);
+    }
+
+    bool Matches(Sexpr const& sexpr, Step const& step, size_t list) const;
+    bool Select(Sexpr const& sexpr, size_t list, Match& m) const;
+    bool Is(Sexpr const& sexpr, Sexpr::Elem const& e, Name const& name) const;
+    bool Equals(Sexpr const& sexpr, Sexpr::Elem const& e, Value const& value) const;
+    Name Compile(StrView text);
+
+    std::vector<Step> steps;
+    Name select;                // the trailing keyword, if any
+    bool selects = false;
+    SymbolTable* symbols = nullptr;
+    bool valid = false;
+};
+
+// SexprScanner follows the lexical structure of a document as ParseSexpr
+// reads it, without decoding any token: strings, comments and atoms are
+// stepped over, handler.OnParen(p) is called at each paren, and
+// handler.OnToken(p) at the start of every other token. Input may arrive in
+// pieces, and a token, string or comment may straddle them. Either call may
+// return false to stop the scan; Scan returns where it stopped, or end.
+class SexprScanner
+{
+public:
+    template <class Handler>
+    char const* Scan(char const* p, char const* end, Handler& handler);
+
+private:
+    enum class State {
+        Normal, Atom, Comment, TokenC2,
+        String, StringEscape, Latin1String, Latin1Escape, Utf8String, Utf8StringC2
+    };
+    State state = State::Normal;
+};
+
+template <class Handler>
+char const* SexprScanner::Scan(char const* p, char const* end, Handler& handler)
+{
+    // the bytes that end a C++ Sexpr atom, and the ends of a comment
+    static constexpr CharSet atomEnd = CharSet("\"();") | CharSet::WhiteSpace();
+    static constexpr CharSet lineEnd = CharSet("\r\n");
+
+    while (p < end) {
+        switch (state) {
+        case State::Normal: {
+            p = tsScanForNonWhiteSpace(p, end);
+            if (p == end)
+                break;
+            char ch = *p;
+            if (ch == ';') {
+                state = State::Comment;
+                ++p;
+                break;
+            }
+            if (ch == '(' || ch == ')') {
+                if (!handler.OnParen(p))
+                    return p;
+                ++p;
+                break;
+            }
+            if (!handler.OnToken(p))
+                return p;
+            ++p;
+            if (ch == '"')
+                state = State::String;
+            else if (ch == '\xA7')
+                state = State::Latin1String;
+            else if (ch == '\xC2')
+                state = State::TokenC2;
+            else
+                state = State::Atom;
+            break;
+        }
+        case State::Atom:
+            p = tsScanForCharSet(p, end, &atomEnd);
+            if (p < end)
+                state = State::Normal; // the terminator is a token of its own
+            break;
+        case State::TokenC2:
+            // C2 A7 opens a UTF-8 § string, C2 followed by anything else is an atom
+            if (*p == '\xA7') {
+                state = State::Utf8String;
+                ++p;
+            }
+            else
+                state = State::Atom;
+            break;
+        case State::Comment:
+            p = tsScanForCharSet(p, end, &lineEnd);
+            if (p < end) {
+                state = State::Normal;
+                ++p;
+            }
+            break;
+        case State::String:
+        case State::Latin1String: {
+            char delim = state == State::String ? '"' : '\xA7';
+            char const* q = tsScanForQuote(p, end, delim, true);
+            if (q < end) {
+                state = State::Normal;
+                p = q + 1;
+            }
+            else {
+                // a backslash in the last byte escapes the first byte of the next piece
+                if (q > end)
+                    state = state == State::String ? State::StringEscape : State::Latin1Escape;
+                p = end;
+            }
+            break;
+        }
+        case State::StringEscape:
+        case State::Latin1Escape:
+            state = state == State::StringEscape ? State::String : State::Latin1String;
+            ++p;
+            break;
+        case State::Utf8String: {
+            char const* q = tsScanForCharacter(p, end, '\xC2');
+            if (q + 1 < end) {
+                p = q + 1;
+                if (*p == '\xA7') {
+                    state = State::Normal;
+                    ++p;
+                }
+            }
+            else {
+                if (q < end)
+                    state = State::Utf8StringC2;
+                p = end;
+            }
+            break;
+        }
+        case State::Utf8StringC2:
+            if (*p == '\xA7') {
+                state = State::Normal;
+                ++p;
+            }
+            else
+                state = State::Utf8String;
+            break;
+        }
+    }
+    return end;
+}
+
+// SexprStreamParser accepts a document in arbitrary chunks, as they arrive
+// from a pipe or socket, and hands each top-level form to onForm as soon as
+// its closing paren arrives. Only the bytes of the form in progress are
+// kept between chunks, so peak memory is bounded by the largest form rather
+// than by the document. Atoms, strings (including a § split between its two
+// UTF-8 bytes), comments and nesting may all straddle chunk boundaries.
+//
+// Forms are parsed exactly as Sexpr parses them. Unlike a whole document,
+// a stream may contain nothing but lists at the top level.
+class SexprStreamParser
+{
+public:
+    using FormHandler = std::function<void(Sexpr& form)>;
+
+    explicit SexprStreamParser(FormHandler onForm, SexprOptions const& options = SexprOptions())
+    : onForm(std::move(onForm)), options(options) {}
+
+    // Returns tsSexprOk, or the error that stopped the stream; once stopped,
+    // further chunks are ignored.
+    tsSexprStatus_t Feed(StrView chunk);
+
+    // Ends the stream. A form left open is still handed to onForm, parsed as
+    // far as it goes, and tsSexprErrorUnterminated is returned.
+    tsSexprStatus_t Finish();
+
+    tsSexprStatus_t status = tsSexprOk;
+    size_t errorOffset = 0;     // offset into the stream where it stopped
+    size_t bytesFed = 0;
+
+private:
+    void Emit(StrView form);
+    tsSexprStatus_t Fail(tsSexprStatus_t error, size_t offset);
+
+    FormHandler onForm;
+    SexprOptions options;
+    SexprScanner scanner;
+    std::string pending;        // the start of a form that began in an earlier chunk
+    int depth = 0;
+};
+
+// SexprImage reads an image written by Sexpr::WriteImage, such as a file
+// mapped into memory, as a read-only Sexpr. The image is position
+// independent and its tables are used where they lie, so opening one parses
+// nothing. Strings, and atoms without a symbol table, are copied into the
+// image, so the source is not needed.
+//
+// The image must stay mapped, and be aligned to 8 bytes. Images are written
+// in the host's byte order and layout; one written on another kind of
+// machine, or by another version, is not Valid. Opening checks the header,
+// and in one pass over the tables that every ref is in range, that the lists
+// nest as their parens do, and that the string offsets only grow, so reading
+// a Valid image never leaves it. The text and numbers are not checked.
+class SexprImage : public SexprNavigation<SexprImage>
+{
+public:
+    using Elem = Sexpr::Elem;
+    using List = Sexpr::List;
+
+    // a table read in place, indexed as the Sexpr vector it was written from
+    template <class T>
+    struct Table {
+        T const* data = nullptr;
+        size_t count = 0;
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        T const& operator[](size_t i) const { return data[i]; }
+        T const* begin() const { return data; }
+        T const* end() const { return data + count; }
+    };
+
+    SexprImage() = default;
+    SexprImage(void const* image, size_t size);
+    explicit SexprImage(StrView image) : SexprImage(image.curr, image.sz) {}
+
+    bool Valid() const { return valid; }
+    // true if the image is valid and was written from source
+    bool Matches(StrView source) const { return valid && sourceHash == HashSource(source); }
+
+    static uint64_t HashSource(StrView source);
+
+    Table<Elem>  expr;
+    Table<List>  lists;
+    Table<int64_t> ints;
+    Table<double>  floats;
+
+    int balance = 0;
+    tsSexprStatus_t status = tsSexprOk;     // of the parse the image was written from
+    size_t errorOffset = 0;
+    uint64_t sourceHash = 0;
+
+    bool HasSymbols() const { return !symbolOffsets.empty(); }
+    size_t SymbolCount() const { return HasSymbols() ? symbolOffsets.size() - 1 : 0; }
+    StrView Symbol(uint32_t id) const { return Slice(symbolOffsets, symbolBytes, id); }
+
+    StrView String(int ref) const { return Slice(stringOffsets, stringBytes, static_cast<uint32_t>(ref)); }
+    StrView Text(Elem const& e) const {
+        if (e.token == tsSexprAtom && HasSymbols())
+            return Symbol(static_cast<uint32_t>(e.ref));
+        return String(e.ref);
+    }
+    // Next, Match, ChildCount and Child are as for Sexpr
+
+private:
+    static StrView Slice(Table<uint64_t> const& offsets, char const* bytes, uint32_t i) {
+        return StrView(bytes + offsets[i], static_cast<size_t>(offsets[i + 1] - offsets[i]));
+    }
+
+    bool CheckTables() const;
+
+    Table<uint64_t> stringOffsets;      // string i is bytes [offsets[i], offsets[i + 1])
+    Table<uint64_t> symbolOffsets;
+    char const* stringBytes = nullptr;
+    char const* symbolBytes = nullptr;
+    bool valid = false;
+};
+
+// SexprWriter writes Sexprs, either a whole parsed document or one token at
+// a time, into a buffer that grows as needed. Parsing what it writes gives
+// back the same elements. Compact output separates tokens with a space and
+// puts each top-level form on a line; pretty output also starts every
+// nested list on a new, indented line.
+//
+// Given a file descriptor, the writer hands the buffer to write() whenever
+// it passes BlockSize, so output of any size needs only a block of memory.
+class SexprWriter
+{
+public:
+    static constexpr size_t BlockSize = 64 * 1024;
+
+    explicit SexprWriter(bool pretty = false, int indent = 2)
+    : pretty(pretty), indent(indent) {}
+    // A writer that writes to fd in blocks; named, so that an int meant as
+    // pretty cannot select it.
+    static SexprWriter ToFd(int fd, bool pretty = false, int indent = 2) {
+        return SexprWriter(FdTag(), fd, pretty, indent);
+    }
+    ~SexprWriter() { Flush(); }
+
+    SexprWriter(SexprWriter&& other) noexcept
+    : buffer(std::move(other.buffer)), fd(other.fd), pretty(other.pretty), indent(other.indent),
+      depth(other.depth), needSpace(other.needSpace), failed(other.failed) {
+        other.fd = -1;
+        other.buffer.clear();
+    }
+    SexprWriter(SexprWriter const&) = delete;
+    SexprWriter& operator=(SexprWriter const&) = delete;
+
+    SexprWriter& Push();
+    SexprWriter& Pop();
+    SexprWriter& Atom(StrView atom);            // written as given
+    SexprWriter& String(StrView value);         // quoted, with \\, \", \n, \r and \t escaped
+    SexprWriter& EscapedString(StrView text);   // text whose escapes are already written out, as Sexpr holds it
+    SexprWriter& Int(int64_t i);
+    SexprWriter& Float(float f);                // shortest text that reads back as f; infinities as 1e999
+    SexprWriter& Float(double f);
+
+    // Writes every element of sexpr. An atom or string is written as its
+    // Text, escaped or not as sexpr.unescapeStrings requires.
+    SexprWriter& Write(Sexpr const& sexpr);
+
+    // Without a file descriptor, the output so far; with one, what is not
+    // yet written.
+    StrView View() const { return StrView(buffer); }
+    std::string const& Buffer() const { return buffer; }
+    void Clear() { buffer.clear(); }
+
+    // Writes out the buffer, if there is a file descriptor. False if this
+    // or any earlier write failed.
+    bool Flush();
+    bool Ok() const { return !failed; }
+
+private:
+    struct FdTag {};
+    SexprWriter(FdTag, int fd, bool pretty, int indent)
+    : fd(fd), pretty(pretty), indent(indent) { buffer.reserve(BlockSize * 2); }
+
+    void Separate();
+    void Token() {
+        needSpace = true;
+        if (fd >= 0 && buffer.size() >= BlockSize)
+            Flush();
+    }
+
+    std::string buffer;
+    int fd = -1;
+    bool pretty = false;
+    int indent = 2;
+    int depth = 0;
+    bool needSpace = false;
+    bool failed = false;
+};
+
+}} // lab::Text
+
+#endif // cplusplus
+
+
+#endif // LABTEXT_H
+
+#ifdef LABTEXT_ODR
+
+//------------------------------------------------------------------------------
+// IMPLEMENTATION
+//------------------------------------------------------------------------------
+
+#include <float.h>
+#include <locale.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+//! @todo replace Assert with custom error reporting mechanism
+#include <assert.h>
+#define Assert assert
+
+
+/*
+* The two functions, tsConvertUtf16ToUtf8 and tsConvertUtf8ToUtf16 are
+* originally from the Effekseer library, and bear the following license:
+
+The MIT License (MIT)
+
+Copyright (c) 2011 Effekseer Project
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+/**
+    @brief    Convert UTF16 into UTF8
+    @param    dst    a pointer to destination buffer
+    @param    dst_size    a length of destination buffer
+    @param    src            a source buffer
+    @return    length except 0
+*/
+int32_t tsConvertUtf16ToUtf8(char* dst, int32_t dst_size, const uint16_t* src)
+{
+    int32_t cnt = 0;
+    const uint16_t* wp = src;
+    char* cp = dst;
+
+    if (dst_size == 0)
+        return 0;
+
+    dst_size -= 3;
+
+    for (cnt = 0; cnt < dst_size;)
+    {
+        uint16_t wc = *wp++;
+        if (wc == 0)
+        {
+            break;
+        }
+        if ((wc & ~0x7f) == 0)
+        {
+            if (cp)
+                *cp++ = wc & 0x7f;
+            cnt += 1;
+        }
+        else if ((wc & ~0x7ff) == 0)
+        {
+            if (cp) {
+                *cp++ = ((wc >> 6) & 0x1f) | 0xc0;
+                *cp++ = ((wc) & 0x3f) | 0x80;
+            }
+            cnt += 2;
+        }
+        else
+        {
+            if (cp) {
+                *cp++ = ((wc >> 12) & 0xf) | 0xe0;
+                *cp++ = ((wc >> 6) & 0x3f) | 0x80;
+                *cp++ = ((wc) & 0x3f) | 0x80;
+            }
+            cnt += 3;
+        }
+    }
+    *cp = '\0';
     return cnt;
 }
 
@@ -700,48 +2009,739 @@ int32_t tsConvertUtf8ToUtf16(uint16_t* dst, int32_t dst_size, const char* src)
     return i;
 }
 
+//----------------------------------------------------------------------------
+// SIMD kernels
+//
+// Each scanner has a scalar reference implementation and, where the target
+// allows, SSE2, AVX2 and NEON versions. The kernels process whole vectors
+// while they fit in [pCurr, pEnd) and finish the tail with the scalar code,
+// so they never read outside the caller's buffer.
 //----------------------------------------------------------------------------
 
-char const* tsScanForQuote(
-    char const* pCurr, char const* pEnd,
-    char delim,
-    bool recognizeEscapes)
-{
-    Assert(pCurr && pEnd && pEnd >= pCurr);
+#if !defined(LABTEXT_NO_SIMD)
+    #if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+        #if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+            #define LABTEXT_SSE2 1
+        #endif
+        #if defined(_MSC_VER) || (defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__)))
+            #define LABTEXT_AVX2 1
+        #endif
+        #include <immintrin.h>
+        #if defined(_MSC_VER)
+            #include <intrin.h>
+        #endif
+    #elif defined(__aarch64__) || defined(_M_ARM64)
+        #define LABTEXT_NEON 1
+        #include <arm_neon.h>
+    #endif
+#endif
 
-    while (pCurr < pEnd) {
-        if (*pCurr == '\\' && recognizeEscapes) // not handling multicharacter escapes such as \u23AB
-            ++pCurr;
-        else if (*pCurr == delim)
-            break;
-        ++pCurr;
-    }
+#if defined(LABTEXT_AVX2) && !defined(_MSC_VER)
+    #define LABTEXT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define LABTEXT_TARGET_AVX2
+#endif
 
-    return pCurr;
+static inline int ts_Ctz32(uint32_t x)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long i;
+    _BitScanForward(&i, x);
+    return (int) i;
+#else
+    return __builtin_ctz(x);
+#endif
 }
 
-char const* tsScanForWhiteSpace(
-    char const* pCurr, char const* pEnd)
+static inline int ts_Ctz64(uint64_t x)
 {
-    Assert(pCurr && pEnd && pEnd >= pCurr);
-
-    while (pCurr < pEnd && !tsIsWhiteSpace(*pCurr))
-        ++pCurr;
-
-    return pCurr+1;
+#if defined(_MSC_VER) && !defined(__clang__)
+    if ((uint32_t) x)
+        return ts_Ctz32((uint32_t) x);
+    return 32 + ts_Ctz32((uint32_t)(x >> 32));
+#else
+    return __builtin_ctzll(x);
+#endif
 }
 
-char const* tsScanForNonWhiteSpace(
-   char const* pCurr, char const* pEnd)
+static inline _Bool ts_IsWhiteSpace(char test)
 {
-    Assert(pCurr && pEnd && pEnd >= pCurr);
+    return test == ' ' || test == '\t' || test == '\r' || test == '\n';
+}
 
-    while (pCurr < pEnd && tsIsWhiteSpace(*pCurr))
-        ++pCurr;
+// scalar reference kernels
 
+static char const* ts_ScanForNonWhiteSpace_Scalar(char const* pCurr, char const* pEnd)
+{
+    while (pCurr < pEnd && ts_IsWhiteSpace(*pCurr))
+        ++pCurr;
+    return pCurr;
+}
+
+static char const* ts_ScanForWhiteSpace_Scalar(char const* pCurr, char const* pEnd)
+{
+    while (pCurr < pEnd && !ts_IsWhiteSpace(*pCurr))
+        ++pCurr;
+    return pCurr;
+}
+
+static char const* ts_ScanForCharacter_Scalar(char const* pCurr, char const* pEnd, char delim)
+{
+    while (pCurr < pEnd && *pCurr != delim)
+        ++pCurr;
+    return pCurr;
+}
+
+static char const* ts_ScanForCharSet_Scalar(char const* pCurr, char const* pEnd, tsCharSet_t const* set)
+{
+    while (pCurr < pEnd && !tsCharSetContains(set, *pCurr))
+        ++pCurr;
+    return pCurr;
+}
+
+static char const* ts_ScanPastCharSet_Scalar(char const* pCurr, char const* pEnd, tsCharSet_t const* set)
+{
+    while (pCurr < pEnd && tsCharSetContains(set, *pCurr))
+        ++pCurr;
+    return pCurr;
+}
+
+// Escape-aware scan for a closing delimiter; a backslash escapes whatever
+// follows it. Like the original loop, a trailing backslash steps one past pEnd.
+static char const* ts_ScanForQuote_Scalar(char const* pCurr, char const* pEnd, char delim)
+{
+    while (pCurr < pEnd) {
+        if (*pCurr == '\\') // not handling multicharacter escapes such as \u23AB
+            ++pCurr;
+        else if (*pCurr == delim)
+            break;
+        ++pCurr;
+    }
     return pCurr;
 }
 
+static uint64_t ts_LineBreakMask64_Scalar(char const* p)
+{
+    uint64_t m = 0;
+    for (int i = 0; i < 64; ++i)
+        if (p[i] == '\r' || p[i] == '\n')
+            m |= 1ull << i;
+    return m;
+}
+
+// The classes of 64 bytes that the Sexpr structural indexer works from
+typedef struct tsSexprClasses_t {
+    uint64_t ws, lineEnd, paren, quote, backslash, semicolon, a7, c2;
+} tsSexprClasses_t;
+
+static void ts_SexprClassify64_Scalar(char const* p, tsSexprClasses_t* c)
+{
+    memset(c, 0, sizeof(tsSexprClasses_t));
+    for (int i = 0; i < 64; ++i) {
+        uint64_t bit = 1ull << i;
+        switch (p[i]) {
+        case '\r': case '\n': c->lineEnd |= bit; c->ws |= bit; break;
+        case ' ': case '\t':  c->ws |= bit; break;
+        case '(': case ')':   c->paren |= bit; break;
+        case '"':             c->quote |= bit; break;
+        case '\\':            c->backslash |= bit; break;
+        case ';':             c->semicolon |= bit; break;
+        case '\xA7':          c->a7 |= bit; break;
+        case '\xC2':          c->c2 |= bit; break;
+        }
+    }
+}
+
+// Given the delimiter and backslash bitmaps of a 64 byte block, returns the
+// delimiters that are not escaped. Odd length backslash runs are resolved in
+// bulk as in simdjson's string stage: the add carries each run that starts on
+// an odd bit across the run, which flips the parity of the bits it marks as
+// escaped. *escapedCarry records whether the first byte of the next block is
+// escaped by a run that ends this one.
+static inline uint64_t ts_UnescapedQuotes(uint64_t quote, uint64_t backslash, uint64_t* escapedCarry)
+{
+    const uint64_t evenBits = 0x5555555555555555ull;
+    backslash &= ~*escapedCarry;
+    uint64_t followsEscape = (backslash << 1) | *escapedCarry;
+    uint64_t oddSequenceStarts = backslash & ~evenBits & ~followsEscape;
+    uint64_t sequencesStartingOnEvenBits = oddSequenceStarts + backslash;
+    *escapedCarry = sequencesStartingOnEvenBits < oddSequenceStarts;
+    uint64_t invertMask = sequencesStartingOnEvenBits << 1;
+    uint64_t escaped = (evenBits ^ invertMask) & followsEscape;
+    return quote & ~escaped;
+}
+
+// Finishes a block scan: either the answer is in the last block, or the tail
+// is handed to the scalar loop, skipping its first byte if it is escaped.
+static inline char const* ts_ScanForQuote_Finish(char const* pCurr, char const* pEnd, char delim,
+                                                  uint64_t found, uint64_t escapedCarry)
+{
+    if (found)
+        return pCurr + ts_Ctz64(found);
+    return ts_ScanForQuote_Scalar(pCurr + escapedCarry, pEnd, delim);
+}
+
+#ifdef LABTEXT_SSE2
+static inline __m128i ts_WhiteSpaceMask_SSE2(__m128i v)
+{
+    __m128i a = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),  _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    __m128i b = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+    return _mm_or_si128(a, b);
+}
+
+static char const* ts_ScanForNonWhiteSpace_SSE2(char const* pCurr, char const* pEnd)
+{
+    while (pEnd - pCurr >= 16) {
+        __m128i v = _mm_loadu_si128((__m128i const*) pCurr);
+        uint32_t m = (uint32_t) _mm_movemask_epi8(ts_WhiteSpaceMask_SSE2(v)) ^ 0xffff;
+        if (m)
+            return pCurr + ts_Ctz32(m);
+        pCurr += 16;
+    }
+    return ts_ScanForNonWhiteSpace_Scalar(pCurr, pEnd);
+}
+
+static char const* ts_ScanForWhiteSpace_SSE2(char const* pCurr, char const* pEnd)
+{
+    while (pEnd - pCurr >= 16) {
+        __m128i v = _mm_loadu_si128((__m128i const*) pCurr);
+        uint32_t m = (uint32_t) _mm_movemask_epi8(ts_WhiteSpaceMask_SSE2(v));
+        if (m)
+            return pCurr + ts_Ctz32(m);
+        pCurr += 16;
+    }
+    return ts_ScanForWhiteSpace_Scalar(pCurr, pEnd);
+}
+
+static char const* ts_ScanForCharacter_SSE2(char const* pCurr, char const* pEnd, char delim)
+{
+    __m128i d = _mm_set1_epi8(delim);
+    while (pEnd - pCurr >= 16) {
+        __m128i v = _mm_loadu_si128((__m128i const*) pCurr);
+        uint32_t m = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, d));
+        if (m)
+            return pCurr + ts_Ctz32(m);
+        pCurr += 16;
+    }
+    return ts_ScanForCharacter_Scalar(pCurr, pEnd, delim);
+}
+
+static inline uint64_t ts_EqMask64_SSE2(char const* p, __m128i c)
+{
+    uint64_t m0 = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(p)),      c));
+    uint64_t m1 = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(p + 16)), c));
+    uint64_t m2 = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(p + 32)), c));
+    uint64_t m3 = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(p + 48)), c));
+    return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+}
+
+static char const* ts_ScanForQuote_SSE2(char const* pCurr, char const* pEnd, char delim)
+{
+    __m128i q = _mm_set1_epi8(delim);
+    __m128i b = _mm_set1_epi8('\\');
+    uint64_t carry = 0, found = 0;
+    while (pEnd - pCurr >= 64) {
+        found = ts_UnescapedQuotes(ts_EqMask64_SSE2(pCurr, q), ts_EqMask64_SSE2(pCurr, b), &carry);
+        if (found)
+            break;
+        pCurr += 64;
+    }
+    return ts_ScanForQuote_Finish(pCurr, pEnd, delim, found, carry);
+}
+
+static uint64_t ts_LineBreakMask64_SSE2(char const* p)
+{
+    return ts_EqMask64_SSE2(p, _mm_set1_epi8('\r')) | ts_EqMask64_SSE2(p, _mm_set1_epi8('\n'));
+}
+
+static void ts_SexprClassify64_SSE2(char const* p, tsSexprClasses_t* c)
+{
+    c->lineEnd   = ts_LineBreakMask64_SSE2(p);
+    c->ws        = c->lineEnd | ts_EqMask64_SSE2(p, _mm_set1_epi8(' ')) | ts_EqMask64_SSE2(p, _mm_set1_epi8('\t'));
+    c->paren     = ts_EqMask64_SSE2(p, _mm_set1_epi8('(')) | ts_EqMask64_SSE2(p, _mm_set1_epi8(')'));
+    c->quote     = ts_EqMask64_SSE2(p, _mm_set1_epi8('"'));
+    c->backslash = ts_EqMask64_SSE2(p, _mm_set1_epi8('\\'));
+    c->semicolon = ts_EqMask64_SSE2(p, _mm_set1_epi8(';'));
+    c->a7        = ts_EqMask64_SSE2(p, _mm_set1_epi8('\xA7'));
+    c->c2        = ts_EqMask64_SSE2(p, _mm_set1_epi8('\xC2'));
+}
+#endif // LABTEXT_SSE2
+
+#ifdef LABTEXT_AVX2
+LABTEXT_TARGET_AVX2
+static inline __m256i ts_WhiteSpaceMask_AVX2(__m256i v)
+{
+    __m256i a = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),  _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+    __m256i b = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+    return _mm256_or_si256(a, b);
+}
+
+LABTEXT_TARGET_AVX2
+static char const* ts_ScanForNonWhiteSpace_AVX2(char const* pCurr, char const* pEnd)
+{
+    while (pEnd - pCurr >= 32) {
+        __m256i v = _mm256_loadu_si256((__m256i const*) pCurr);
+        uint32_t m = ~(uint32_t) _mm256_movemask_epi8(ts_WhiteSpaceMask_AVX2(v));
+        if (m)
+            return pCurr + ts_Ctz32(m);
+        pCurr += 32;
+    }
+    return ts_ScanForNonWhiteSpace_Scalar(pCurr, pEnd);
+}
+
+LABTEXT_TARGET_AVX2
+static char const* ts_ScanForWhiteSpace_AVX2(char const* pCurr, char const* pEnd)
+{
+    while (pEnd - pCurr >= 32) {
+        __m256i v = _mm256_loadu_si256((__m256i const*) pCurr);
+        uint32_t m = (uint32_t) _mm256_movemask_epi8(ts_WhiteSpaceMask_AVX2(v));
+        if (m)
+            return pCurr + ts_Ctz32(m);
+        pCurr += 32;
+    }
+    return ts_ScanForWhiteSpace_Scalar(pCurr, pEnd);
+}
+
+LABTEXT_TARGET_AVX2
+static char const* ts_ScanForCharacter_AVX2(char const* pCurr, char const* pEnd, char delim)
+{
+    __m256i d = _mm256_set1_epi8(delim);
+    while (pEnd - pCurr >= 32) {
+        __m256i v = _mm256_loadu_si256((__m256i const*) pCurr);
+        uint32_t m = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, d));
+        if (m)
+            return pCurr + ts_Ctz32(m);
+        pCurr += 32;
+    }
+    return ts_ScanForCharacter_Scalar(pCurr, pEnd, delim);
+}
+
+// Set membership with two pshufb lookups: the low nibble selects a byte of
+// the set's bitmap, the top bit picks which half, and bits 4-6 pick the bit.
+LABTEXT_TARGET_AVX2
+static inline __m256i ts_CharSetMask_AVX2(__m256i v, __m256i lower, __m256i upper)
+{
+    const __m256i bit = _mm256_setr_epi8(
+        1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+        1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m256i lo = _mm256_and_si256(v, _mm256_set1_epi8(0x0f));
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x07));
+    __m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(lower, lo), _mm256_shuffle_epi8(upper, lo), v);
+    __m256i sel = _mm256_shuffle_epi8(bit, hi);
+    return _mm256_cmpeq_epi8(_mm256_and_si256(row, sel), sel);
+}
+
+LABTEXT_TARGET_AVX2
+static char const* ts_ScanCharSet_AVX2(char const* pCurr, char const* pEnd, tsCharSet_t const* set, uint32_t invert)
+{
+    __m256i lower = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i const*) &set->bits[0]));
+    __m256i upper = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i const*) &set->bits[16]));
+    while (pEnd - pCurr >= 32) {
+        __m256i v = _mm256_loadu_si256((__m256i const*) pCurr);
+        uint32_t m = (uint32_t) _mm256_movemask_epi8(ts_CharSetMask_AVX2(v, lower, upper)) ^ invert;
+        if (m)
+            return pCurr + ts_Ctz32(m);
+        pCurr += 32;
+    }
+    return invert ? ts_ScanPastCharSet_Scalar(pCurr, pEnd, set) : ts_ScanForCharSet_Scalar(pCurr, pEnd, set);
+}
+
+LABTEXT_TARGET_AVX2
+static inline uint64_t ts_EqMask64_AVX2(char const* p, __m256i c)
+{
+    uint64_t lo = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const*)(p)),      c));
+    uint64_t hi = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const*)(p + 32)), c));
+    return lo | (hi << 32);
+}
+
+LABTEXT_TARGET_AVX2
+static char const* ts_ScanForQuote_AVX2(char const* pCurr, char const* pEnd, char delim)
+{
+    __m256i q = _mm256_set1_epi8(delim);
+    __m256i b = _mm256_set1_epi8('\\');
+    uint64_t carry = 0, found = 0;
+    while (pEnd - pCurr >= 64) {
+        found = ts_UnescapedQuotes(ts_EqMask64_AVX2(pCurr, q), ts_EqMask64_AVX2(pCurr, b), &carry);
+        if (found)
+            break;
+        pCurr += 64;
+    }
+    return ts_ScanForQuote_Finish(pCurr, pEnd, delim, found, carry);
+}
+
+LABTEXT_TARGET_AVX2
+static uint64_t ts_LineBreakMask64_AVX2(char const* p)
+{
+    return ts_EqMask64_AVX2(p, _mm256_set1_epi8('\r')) | ts_EqMask64_AVX2(p, _mm256_set1_epi8('\n'));
+}
+
+LABTEXT_TARGET_AVX2
+static void ts_SexprClassify64_AVX2(char const* p, tsSexprClasses_t* c)
+{
+    c->lineEnd   = ts_LineBreakMask64_AVX2(p);
+    c->ws        = c->lineEnd | ts_EqMask64_AVX2(p, _mm256_set1_epi8(' ')) | ts_EqMask64_AVX2(p, _mm256_set1_epi8('\t'));
+    c->paren     = ts_EqMask64_AVX2(p, _mm256_set1_epi8('(')) | ts_EqMask64_AVX2(p, _mm256_set1_epi8(')'));
+    c->quote     = ts_EqMask64_AVX2(p, _mm256_set1_epi8('"'));
+    c->backslash = ts_EqMask64_AVX2(p, _mm256_set1_epi8('\\'));
+    c->semicolon = ts_EqMask64_AVX2(p, _mm256_set1_epi8(';'));
+    c->a7        = ts_EqMask64_AVX2(p, _mm256_set1_epi8('\xA7'));
+    c->c2        = ts_EqMask64_AVX2(p, _mm256_set1_epi8('\xC2'));
+}
+
+static char const* ts_ScanForCharSet_AVX2(char const* pCurr, char const* pEnd, tsCharSet_t const* set)
+{
+    return ts_ScanCharSet_AVX2(pCurr, pEnd, set, 0);
+}
+
+static char const* ts_ScanPastCharSet_AVX2(char const* pCurr, char const* pEnd, tsCharSet_t const* set)
+{
+    return ts_ScanCharSet_AVX2(pCurr, pEnd, set, 0xffffffffu);
+}
+#endif // LABTEXT_AVX2
+
+#ifdef LABTEXT_NEON
+// NEON has no movemask; narrowing each 0x00/0xff lane to a nibble gives a
+// 64 bit mask with four bits per byte instead.
+static inline uint64_t ts_NibbleMask_NEON(uint8x16_t cmp)
+{
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4)), 0);
+}
+
+static inline uint8x16_t ts_WhiteSpaceMask_NEON(uint8x16_t v)
+{
+    uint8x16_t a = vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')),  vceqq_u8(v, vdupq_n_u8('\t')));
+    uint8x16_t b = vorrq_u8(vceqq_u8(v, vdupq_n_u8('\r')), vceqq_u8(v, vdupq_n_u8('\n')));
+    return vorrq_u8(a, b);
+}
+
+static char const* ts_ScanForNonWhiteSpace_NEON(char const* pCurr, char const* pEnd)
+{
+    while (pEnd - pCurr >= 16) {
+        uint8x16_t v = vld1q_u8((uint8_t const*) pCurr);
+        uint64_t m = ~ts_NibbleMask_NEON(ts_WhiteSpaceMask_NEON(v));
+        if (m)
+            return pCurr + (ts_Ctz64(m) >> 2);
+        pCurr += 16;
+    }
+    return ts_ScanForNonWhiteSpace_Scalar(pCurr, pEnd);
+}
+
+static char const* ts_ScanForWhiteSpace_NEON(char const* pCurr, char const* pEnd)
+{
+    while (pEnd - pCurr >= 16) {
+        uint8x16_t v = vld1q_u8((uint8_t const*) pCurr);
+        uint64_t m = ts_NibbleMask_NEON(ts_WhiteSpaceMask_NEON(v));
+        if (m)
+            return pCurr + (ts_Ctz64(m) >> 2);
+        pCurr += 16;
+    }
+    return ts_ScanForWhiteSpace_Scalar(pCurr, pEnd);
+}
+
+static char const* ts_ScanForCharacter_NEON(char const* pCurr, char const* pEnd, char delim)
+{
+    uint8x16_t d = vdupq_n_u8((uint8_t) delim);
+    while (pEnd - pCurr >= 16) {
+        uint8x16_t v = vld1q_u8((uint8_t const*) pCurr);
+        uint64_t m = ts_NibbleMask_NEON(vceqq_u8(v, d));
+        if (m)
+            return pCurr + (ts_Ctz64(m) >> 2);
+        pCurr += 16;
+    }
+    return ts_ScanForCharacter_Scalar(pCurr, pEnd, delim);
+}
+
+// a full movemask over four vectors, by weighting each lane with its bit and
+// folding with pairwise adds
+static inline uint64_t ts_Movemask64_NEON(uint8x16_t a, uint8x16_t b, uint8x16_t c, uint8x16_t d)
+{
+    static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t w = vld1q_u8(weights);
+    uint8x16_t s0 = vpaddq_u8(vandq_u8(a, w), vandq_u8(b, w));
+    uint8x16_t s1 = vpaddq_u8(vandq_u8(c, w), vandq_u8(d, w));
+    s0 = vpaddq_u8(s0, s1);
+    s0 = vpaddq_u8(s0, s0);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(s0), 0);
+}
+
+static inline uint64_t ts_EqMask64_NEON(char const* p, uint8x16_t c)
+{
+    uint8_t const* u = (uint8_t const*) p;
+    return ts_Movemask64_NEON(vceqq_u8(vld1q_u8(u), c),      vceqq_u8(vld1q_u8(u + 16), c),
+                              vceqq_u8(vld1q_u8(u + 32), c), vceqq_u8(vld1q_u8(u + 48), c));
+}
+
+static char const* ts_ScanForQuote_NEON(char const* pCurr, char const* pEnd, char delim)
+{
+    uint8x16_t q = vdupq_n_u8((uint8_t) delim);
+    uint8x16_t b = vdupq_n_u8('\\');
+    uint64_t carry = 0, found = 0;
+    while (pEnd - pCurr >= 64) {
+        found = ts_UnescapedQuotes(ts_EqMask64_NEON(pCurr, q), ts_EqMask64_NEON(pCurr, b), &carry);
+        if (found)
+            break;
+        pCurr += 64;
+    }
+    return ts_ScanForQuote_Finish(pCurr, pEnd, delim, found, carry);
+}
+
+static uint64_t ts_LineBreakMask64_NEON(char const* p)
+{
+    return ts_EqMask64_NEON(p, vdupq_n_u8('\r')) | ts_EqMask64_NEON(p, vdupq_n_u8('\n'));
+}
+
+static void ts_SexprClassify64_NEON(char const* p, tsSexprClasses_t* c)
+{
+    c->lineEnd   = ts_LineBreakMask64_NEON(p);
+    c->ws        = c->lineEnd | ts_EqMask64_NEON(p, vdupq_n_u8(' ')) | ts_EqMask64_NEON(p, vdupq_n_u8('\t'));
+    c->paren     = ts_EqMask64_NEON(p, vdupq_n_u8('(')) | ts_EqMask64_NEON(p, vdupq_n_u8(')'));
+    c->quote     = ts_EqMask64_NEON(p, vdupq_n_u8('"'));
+    c->backslash = ts_EqMask64_NEON(p, vdupq_n_u8('\\'));
+    c->semicolon = ts_EqMask64_NEON(p, vdupq_n_u8(';'));
+    c->a7        = ts_EqMask64_NEON(p, vdupq_n_u8(0xA7));
+    c->c2        = ts_EqMask64_NEON(p, vdupq_n_u8(0xC2));
+}
+
+// the tbl equivalent of ts_CharSetMask_AVX2
+static inline uint8x16_t ts_CharSetMask_NEON(uint8x16_t v, uint8x16_t lower, uint8x16_t upper)
+{
+    static const uint8_t bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t lo = vandq_u8(v, vdupq_n_u8(0x0f));
+    uint8x16_t hi = vandq_u8(vshrq_n_u8(v, 4), vdupq_n_u8(0x07));
+    uint8x16_t top = vreinterpretq_u8_s8(vshrq_n_s8(vreinterpretq_s8_u8(v), 7));
+    uint8x16_t row = vbslq_u8(top, vqtbl1q_u8(upper, lo), vqtbl1q_u8(lower, lo));
+    return vtstq_u8(row, vqtbl1q_u8(vld1q_u8(bits), hi));
+}
+
+static char const* ts_ScanCharSet_NEON(char const* pCurr, char const* pEnd, tsCharSet_t const* set, uint64_t invert)
+{
+    uint8x16_t lower = vld1q_u8(&set->bits[0]);
+    uint8x16_t upper = vld1q_u8(&set->bits[16]);
+    while (pEnd - pCurr >= 16) {
+        uint8x16_t v = vld1q_u8((uint8_t const*) pCurr);
+        uint64_t m = ts_NibbleMask_NEON(ts_CharSetMask_NEON(v, lower, upper)) ^ invert;
+        if (m)
+            return pCurr + (ts_Ctz64(m) >> 2);
+        pCurr += 16;
+    }
+    return invert ? ts_ScanPastCharSet_Scalar(pCurr, pEnd, set) : ts_ScanForCharSet_Scalar(pCurr, pEnd, set);
+}
+
+static char const* ts_ScanForCharSet_NEON(char const* pCurr, char const* pEnd, tsCharSet_t const* set)
+{
+    return ts_ScanCharSet_NEON(pCurr, pEnd, set, 0);
+}
+
+static char const* ts_ScanPastCharSet_NEON(char const* pCurr, char const* pEnd, tsCharSet_t const* set)
+{
+    return ts_ScanCharSet_NEON(pCurr, pEnd, set, ~(uint64_t) 0);
+}
+#endif // LABTEXT_NEON
+
+typedef struct tsSimdKernels_t {
+    tsSimdLevel_t level;
+    char const* (*scanForNonWhiteSpace)(char const* pCurr, char const* pEnd);
+    char const* (*scanForWhiteSpace)   (char const* pCurr, char const* pEnd);
+    char const* (*scanForCharacter)    (char const* pCurr, char const* pEnd, char delim);
+    char const* (*scanForCharSet)      (char const* pCurr, char const* pEnd, tsCharSet_t const* set);
+    char const* (*scanPastCharSet)     (char const* pCurr, char const* pEnd, tsCharSet_t const* set);
+    char const* (*scanForQuote)        (char const* pCurr, char const* pEnd, char delim);
+    uint64_t    (*lineBreakMask64)     (char const* p);  // \r and \n in the 64 bytes at p
+    void        (*classifySexpr64)     (char const* p, tsSexprClasses_t* c);
+} tsSimdKernels_t;
+
+static const tsSimdKernels_t ts_SimdScalar = {
+    tsSimdScalar,
+    ts_ScanForNonWhiteSpace_Scalar,
+    ts_ScanForWhiteSpace_Scalar,
+    ts_ScanForCharacter_Scalar,
+    ts_ScanForCharSet_Scalar,
+    ts_ScanPastCharSet_Scalar,
+    ts_ScanForQuote_Scalar,
+    ts_LineBreakMask64_Scalar,
+    ts_SexprClassify64_Scalar,
+};
+
+#ifdef LABTEXT_SSE2
+static const tsSimdKernels_t ts_SimdSSE2 = {
+    tsSimdSSE2,
+    ts_ScanForNonWhiteSpace_SSE2,
+    ts_ScanForWhiteSpace_SSE2,
+    ts_ScanForCharacter_SSE2,
+    ts_ScanForCharSet_Scalar,   // set classification needs pshufb, which SSE2 lacks
+    ts_ScanPastCharSet_Scalar,
+    ts_ScanForQuote_SSE2,
+    ts_LineBreakMask64_SSE2,
+    ts_SexprClassify64_SSE2,
+};
+#endif
+
+#ifdef LABTEXT_AVX2
+static const tsSimdKernels_t ts_SimdAVX2 = {
+    tsSimdAVX2,
+    ts_ScanForNonWhiteSpace_AVX2,
+    ts_ScanForWhiteSpace_AVX2,
+    ts_ScanForCharacter_AVX2,
+    ts_ScanForCharSet_AVX2,
+    ts_ScanPastCharSet_AVX2,
+    ts_ScanForQuote_AVX2,
+    ts_LineBreakMask64_AVX2,
+    ts_SexprClassify64_AVX2,
+};
+#endif
+
+#ifdef LABTEXT_NEON
+static const tsSimdKernels_t ts_SimdNEON = {
+    tsSimdNEON,
+    ts_ScanForNonWhiteSpace_NEON,
+    ts_ScanForWhiteSpace_NEON,
+    ts_ScanForCharacter_NEON,
+    ts_ScanForCharSet_NEON,
+    ts_ScanPastCharSet_NEON,
+    ts_ScanForQuote_NEON,
+    ts_LineBreakMask64_NEON,
+    ts_SexprClassify64_NEON,
+};
+#endif
+
+// Selected on first use. The parsers run scanners from several threads, so
+// the pointer is loaded and stored atomically; threads racing on the first
+// call all store the same kernels. Relaxed ordering suffices, as the kernel
+// tables are constant.
+static tsSimdKernels_t const* ts_SimdActive = NULL;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static inline tsSimdKernels_t const* ts_SimdLoad(void)
+{
+    return (tsSimdKernels_t const*) _InterlockedCompareExchangePointer((void* volatile*) &ts_SimdActive, NULL, NULL);
+}
+static inline void ts_SimdStore(tsSimdKernels_t const* k)
+{
+    _InterlockedExchangePointer((void* volatile*) &ts_SimdActive, (void*) k);
+}
+#elif defined(__GNUC__) || defined(__clang__)
+static inline tsSimdKernels_t const* ts_SimdLoad(void)
+{
+    return __atomic_load_n(&ts_SimdActive, __ATOMIC_RELAXED);
+}
+static inline void ts_SimdStore(tsSimdKernels_t const* k)
+{
+    __atomic_store_n(&ts_SimdActive, k, __ATOMIC_RELAXED);
+}
+#else
+static inline tsSimdKernels_t const* ts_SimdLoad(void)
+{
+    return ts_SimdActive;
+}
+static inline void ts_SimdStore(tsSimdKernels_t const* k)
+{
+    ts_SimdActive = k;
+}
+#endif
+
+static _Bool ts_CpuHasAVX2(void)
+{
+#if defined(LABTEXT_AVX2) && defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    _Bool osxsave = (info[2] & (1 << 27)) != 0;
+    _Bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(LABTEXT_AVX2)
+    return __builtin_cpu_supports("avx2") != 0;
+#else
+    return false;
+#endif
+}
+
+static tsSimdKernels_t const* ts_SimdKernelsForLevel(tsSimdLevel_t level)
+{
+#ifdef LABTEXT_AVX2
+    if (level >= tsSimdAVX2 && level != tsSimdNEON && ts_CpuHasAVX2())
+        return &ts_SimdAVX2;
+#endif
+#ifdef LABTEXT_SSE2
+    if (level >= tsSimdSSE2 && level != tsSimdNEON)
+        return &ts_SimdSSE2;
+#endif
+#ifdef LABTEXT_NEON
+    if (level == tsSimdNEON)
+        return &ts_SimdNEON;
+#endif
+    (void) level;
+    return &ts_SimdScalar;
+}
+
+static inline tsSimdKernels_t const* ts_Simd(void)
+{
+    tsSimdKernels_t const* k = ts_SimdLoad();
+    if (!k) {
+#ifdef LABTEXT_NEON
+        k = ts_SimdKernelsForLevel(tsSimdNEON);
+#else
+        k = ts_SimdKernelsForLevel(tsSimdAVX2);
+#endif
+        ts_SimdStore(k);
+    }
+    return k;
+}
+
+tsSimdLevel_t tsGetSimdLevel(void)
+{
+    return ts_Simd()->level;
+}
+
+tsSimdLevel_t tsSetSimdLevel(tsSimdLevel_t level)
+{
+    tsSimdKernels_t const* k = ts_SimdKernelsForLevel(level);
+    ts_SimdStore(k);
+    return k->level;
+}
+
+//----------------------------------------------------------------------------
+
+char const* tsScanForQuote(
+    char const* pCurr, char const* pEnd,
+    char delim,
+    bool recognizeEscapes)
+{
+    Assert(pCurr && pEnd && pEnd >= pCurr);
+
+    if (!recognizeEscapes)
+        return tsScanForCharacter(pCurr, pEnd, delim);
+    if (delim == '\\')
+        return ts_ScanForQuote_Scalar(pCurr, pEnd, delim);
+
+    return ts_Simd()->scanForQuote(pCurr, pEnd, delim);
+}
+
+char const* tsScanForWhiteSpace(
+    char const* pCurr, char const* pEnd)
+{
+    Assert(pCurr && pEnd && pEnd >= pCurr);
+
+    return ts_Simd()->scanForWhiteSpace(pCurr, pEnd) + 1;
+}
+
+char const* tsScanForNonWhiteSpace(
+   char const* pCurr, char const* pEnd)
+{
+    Assert(pCurr && pEnd && pEnd >= pCurr);
+
+    // most calls start on a token already, don't pay for the dispatch
+    if (pCurr < pEnd && !ts_IsWhiteSpace(*pCurr))
+        return pCurr;
+
+    return ts_Simd()->scanForNonWhiteSpace(pCurr, pEnd);
+}
+
 char const* tsScanBackwardsForWhiteSpace(
     char const* pCurr, char const* pStart)
 {
@@ -770,10 +2770,34 @@ char const* tsScanForCharacter(
 {
     Assert(pCurr && pEnd);
 
-    while (pCurr < pEnd && *pCurr != delim)
-        ++pCurr;
+    if (pCurr >= pEnd || *pCurr == delim)
+        return pCurr;
 
-    return pCurr;
+    return ts_Simd()->scanForCharacter(pCurr, pEnd, delim);
+}
+
+char const* tsScanForCharSet(
+    char const* pCurr, char const* pEnd,
+    tsCharSet_t const* set)
+{
+    Assert(pCurr && pEnd && set);
+
+    if (pCurr >= pEnd || tsCharSetContains(set, *pCurr))
+        return pCurr;
+
+    return ts_Simd()->scanForCharSet(pCurr, pEnd, set);
+}
+
+char const* tsScanPastCharSet(
+    char const* pCurr, char const* pEnd,
+    tsCharSet_t const* set)
+{
+    Assert(pCurr && pEnd && set);
+
+    if (pCurr >= pEnd || !tsCharSetContains(set, *pCurr))
+        return pCurr;
+
+    return ts_Simd()->scanPastCharSet(pCurr, pEnd, set);
 }
 
 char const* tsScanBackwardsForCharacter(
@@ -905,99 +2929,61 @@ char const* tsGetTokenWSDelimited(
     return pStringEnd;
 }
 
-char const* tsGetTokenAlphaNumericExt(
+// digits, A-Z and a-z, in tsCharSet_t layout
+static const tsCharSet_t ts_AlphaNumericSet = { {
+    0xa8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf0, 0x50, 0x50, 0x50, 0x50, 0x50,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } };
+
+// the ext strings never accept white space, it always ends a token
+static void ts_CharSetAddExt(tsCharSet_t* set, char const* ext)
+{
+    for (; *ext; ++ext)
+        if (!ts_IsWhiteSpace(*ext))
+            tsCharSetAdd(set, *ext);
+}
+
+char const* tsGetTokenCharSet(
     char const* pCurr, char const* pEnd,
-    char const* ext_,
+    tsCharSet_t const* accept,
     char const** resultStringBegin, uint32_t* stringLength)
 {
-    Assert(pCurr && pEnd);
+    Assert(pCurr && pEnd && accept);
 
     pCurr = tsScanForNonWhiteSpace(pCurr, pEnd);
     *resultStringBegin = pCurr;
-    *stringLength = 0;
-
-    while (pCurr < pEnd)
-    {
-        char test = pCurr[0];
-
-        if (tsIsWhiteSpace(test))
-            break;
-
-        _Bool accept = tsIsNumeric(test) || tsIsAlpha(test);
-        char const* ext = ext_;
-        for ( ; *ext && !accept; ++ext)
-            accept |= *ext == test;
-
-        if (!accept)
-            break;
-
-        ++pCurr;
-        *stringLength += 1;
-    }
-
+    pCurr = tsScanPastCharSet(pCurr, pEnd, accept);
+    *stringLength = (uint32_t)(pCurr - *resultStringBegin);
     return pCurr;
 }
 
-char const* tsGetTokenExt(
+char const* tsGetTokenAlphaNumericExt(
     char const* pCurr, char const* pEnd,
-    char const* ext_,
+    char const* ext,
     char const** resultStringBegin, uint32_t* stringLength)
 {
-    Assert(pCurr && pEnd);
-
-    pCurr = tsScanForNonWhiteSpace(pCurr, pEnd);
-    *resultStringBegin = pCurr;
-    *stringLength = 0;
-
-    while (pCurr < pEnd)
-    {
-        char test = pCurr[0];
-
-        if (tsIsWhiteSpace(test))
-            break;
-
-        _Bool accept = false;
-        char const* ext = ext_;
-        for (; *ext && !accept; ++ext)
-            accept |= *ext == test;
-
-        if (!accept)
-            break;
-
-        ++pCurr;
-        *stringLength += 1;
-    }
+    tsCharSet_t accept = ts_AlphaNumericSet;
+    ts_CharSetAddExt(&accept, ext);
+    return tsGetTokenCharSet(pCurr, pEnd, &accept, resultStringBegin, stringLength);
+}
 
-    return pCurr;
+char const* tsGetTokenExt(
+    char const* pCurr, char const* pEnd,
+    char const* ext,
+    char const** resultStringBegin, uint32_t* stringLength)
+{
+    tsCharSet_t accept;
+    tsCharSetClear(&accept);
+    ts_CharSetAddExt(&accept, ext);
+    return tsGetTokenCharSet(pCurr, pEnd, &accept, resultStringBegin, stringLength);
 }
 
 char const* tsGetTokenAlphaNumeric(
     char const* pCurr, char const* pEnd,
     char const** resultStringBegin, uint32_t* stringLength)
 {
-    Assert(pCurr && pEnd);
-
-    pCurr = tsScanForNonWhiteSpace(pCurr, pEnd);
-    *resultStringBegin = pCurr;
-    *stringLength = 0;
-
-    while (pCurr < pEnd)
-    {
-        char test = pCurr[0];
-
-        if (tsIsWhiteSpace(test))
-            break;
-
-        _Bool accept = ((test == '_') || tsIsNumeric(test) || tsIsAlpha(test));
-
-        if (!accept)
-            break;
-
-        ++pCurr;
-        *stringLength += 1;
-    }
-
-    return pCurr;
+    tsCharSet_t accept = ts_AlphaNumericSet;
+    tsCharSetAdd(&accept, '_');
+    return tsGetTokenCharSet(pCurr, pEnd, &accept, resultStringBegin, stringLength);
 }
 
 char const* tsGetNameSpacedTokenAlphaNumeric(
@@ -1005,36 +2991,16 @@ char const* tsGetNameSpacedTokenAlphaNumeric(
     char namespaceChar,
     char const** resultStringBegin, uint32_t* stringLength)
 {
-    Assert(pCurr && pEnd);
-
-    pCurr = tsScanForNonWhiteSpace(pCurr, pEnd);
-    *resultStringBegin = pCurr;
-    *stringLength = 0;
-
-    while (pCurr < pEnd)
-    {
-        char test = pCurr[0];
-
-        if (tsIsWhiteSpace(test))
-            break;
-
-        // should pass in a string of acceptable characters, ie "$^_"
-        _Bool accept = ((test == namespaceChar) || (test == '$') || (test == '^') || (test == '_') || tsIsNumeric(test) || tsIsAlpha(test));
-
-        if (!accept)
-            break;
-
-        ++pCurr;
-        *stringLength += 1;
-    }
-
-    return pCurr;
+    char ext[5] = { '$', '^', '_', namespaceChar, '\0' };
+    return tsGetTokenAlphaNumericExt(pCurr, pEnd, ext, resultStringBegin, stringLength);
 }
 
-char const* tsGetString(
+// The string readers, with the full length of the string; the public
+// versions report it in 32 bits, and the StrView versions in full.
+static char const* ts_GetString(
     char const* pCurr, char const* pEnd,
     bool recognizeEscapes,
-    char const** resultStringBegin, uint32_t* stringLength)
+    char const** resultStringBegin, size_t* stringLength)
 {
     Assert(pCurr && pEnd && pEnd >= pCurr);
 
@@ -1048,11 +3014,11 @@ char const* tsGetString(
         pCurr = tsScanForQuote(pCurr, pEnd, '\"', recognizeEscapes);
 
         if (pCurr < pEnd) {   // Found closing quote
-            *stringLength = (uint32_t)(pCurr - *resultStringBegin);
+            *stringLength = (size_t)(pCurr - *resultStringBegin);
             ++pCurr;          // point past closing quote
         } else {              // No closing quote found
             *stringLength = 0;
-                              // Don't increment pCurr - leave it at pEnd
+            pCurr = pEnd;     // a trailing backslash steps past pEnd
         }
     }
     else
@@ -1061,11 +3027,11 @@ char const* tsGetString(
     return pCurr;
 }
 
-char const* tsGetString2(
+static char const* ts_GetString2(
                         char const* pCurr, char const* pEnd,
                         char delim,
                         bool recognizeEscapes,
-                        char const** resultStringBegin, uint32_t* stringLength)
+                        char const** resultStringBegin, size_t* stringLength)
 {
     Assert(pCurr && pEnd && pEnd >= pCurr);
 
@@ -1079,11 +3045,14 @@ char const* tsGetString2(
         pCurr = tsScanForQuote(pCurr, pEnd, delim, recognizeEscapes);
 
         if (pCurr <= pEnd)
-            *stringLength = (uint32_t)(pCurr - *resultStringBegin);
+            *stringLength = (size_t)(pCurr - *resultStringBegin);
         else
             *stringLength = 0;
 
-        ++pCurr;    // point past closing quote
+        if (pCurr < pEnd)
+            ++pCurr;    // point past closing quote
+        else
+            pCurr = pEnd;   // unterminated
     }
     else
         *stringLength = 0;
@@ -1091,6 +3060,29 @@ char const* tsGetString2(
     return pCurr;
 }
 
+char const* tsGetString(
+    char const* pCurr, char const* pEnd,
+    bool recognizeEscapes,
+    char const** resultStringBegin, uint32_t* stringLength)
+{
+    size_t length;
+    pCurr = ts_GetString(pCurr, pEnd, recognizeEscapes, resultStringBegin, &length);
+    *stringLength = (uint32_t) length;
+    return pCurr;
+}
+
+char const* tsGetString2(
+                        char const* pCurr, char const* pEnd,
+                        char delim,
+                        bool recognizeEscapes,
+                        char const** resultStringBegin, uint32_t* stringLength)
+{
+    size_t length;
+    pCurr = ts_GetString2(pCurr, pEnd, delim, recognizeEscapes, resultStringBegin, &length);
+    *stringLength = (uint32_t) length;
+    return pCurr;
+}
+
 // Match pExpect. If pExect is found in the input stream, return pointing
 // to the character that follows, otherwise return the start of the input stream
 
@@ -1112,81 +3104,1063 @@ char const* tsGetInt16(
 {
     int32_t longresult;
     char const* retval = tsGetInt32(pCurr, pEnd, &longresult);
-    *result = (int16_t) longresult;
+    if (retval != pCurr)
+        *result = (int16_t) longresult;
     return retval;
 }
 
-char const* tsGetInt32(
-    char const* pCurr, char const* pEnd,
-    int32_t* result)
+//------------------------------------------------------------------------------
+// Decimal floating point
+//
+// Numbers are read by the method of Eisel and Lemire, as in fast_float:
+// the first 19 significant digits are multiplied by a 128 bit power of five,
+// which determines the correctly rounded result directly. Digits are read
+// eight at a time where eight are available. Small exact cases take Clinger's
+// fast path; a number with more than 19 significant digits that cannot be
+// settled from its first 19 falls back to strtod.
+//------------------------------------------------------------------------------
+
+// 5^q for q in [-342, 308], normalized and truncated to 128 bits, high then low
+static const uint64_t ts_PowersOfFive128[651 * 2] = {
+    0xeef453d6923bd65aull, 0x113faa2906a13b3full,
+    0x9558b4661b6565f8ull, 0x4ac7ca59a424c507ull,
+    0xbaaee17fa23ebf76ull, 0x5d79bcf00d2df649ull,
+    0xe95a99df8ace6f53ull, 0xf4d82c2c107973dcull,
+    0x91d8a02bb6c10594ull, 0x79071b9b8a4be869ull,
+    0xb64ec836a47146f9ull, 0x9748e2826cdee284ull,
+    0xe3e27a444d8d98b7ull, 0xfd1b1b2308169b25ull,
+    0x8e6d8c6ab0787f72ull, 0xfe30f0f5e50e20f7ull,
+    0xb208ef855c969f4full, 0xbdbd2d335e51a935ull,
+    0xde8b2b66b3bc4723ull, 0xad2c788035e61382ull,
+    0x8b16fb203055ac76ull, 0x4c3bcb5021afcc31ull,
+    0xaddcb9e83c6b1793ull, 0xdf4abe242a1bbf3dull,
+    0xd953e8624b85dd78ull, 0xd71d6dad34a2af0dull,
+    0x87d4713d6f33aa6bull, 0x8672648c40e5ad68ull,
+    0xa9c98d8ccb009506ull, 0x680efdaf511f18c2ull,
+    0xd43bf0effdc0ba48ull, 0x0212bd1b2566def2ull,
+    0x84a57695fe98746dull, 0x014bb630f7604b57ull,
+    0xa5ced43b7e3e9188ull, 0x419ea3bd35385e2dull,
+    0xcf42894a5dce35eaull, 0x52064cac828675b9ull,
+    0x818995ce7aa0e1b2ull, 0x7343efebd1940993ull,
+    0xa1ebfb4219491a1full, 0x1014ebe6c5f90bf8ull,
+    0xca66fa129f9b60a6ull, 0xd41a26e077774ef6ull,
+    0xfd00b897478238d0ull, 0x8920b098955522b4ull,
+    0x9e20735e8cb16382ull, 0x55b46e5f5d5535b0ull,
+    0xc5a890362fddbc62ull, 0xeb2189f734aa831dull,
+    0xf712b443bbd52b7bull, 0xa5e9ec7501d523e4ull,
+    0x9a6bb0aa55653b2dull, 0x47b233c92125366eull,
+    0xc1069cd4eabe89f8ull, 0x999ec0bb696e840aull,
+    0xf148440a256e2c76ull, 0xc00670ea43ca250dull,
+    0x96cd2a865764dbcaull, 0x380406926a5e5728ull,
+    0xbc807527ed3e12bcull, 0xc605083704f5ecf2ull,
+    0xeba09271e88d976bull, 0xf7864a44c633682eull,
+    0x93445b8731587ea3ull, 0x7ab3ee6afbe0211dull,
+    0xb8157268fdae9e4cull, 0x5960ea05bad82964ull,
+    0xe61acf033d1a45dfull, 0x6fb92487298e33bdull,
+    0x8fd0c16206306babull, 0xa5d3b6d479f8e056ull,
+    0xb3c4f1ba87bc8696ull, 0x8f48a4899877186cull,
+    0xe0b62e2929aba83cull, 0x331acdabfe94de87ull,
+    0x8c71dcd9ba0b4925ull, 0x9ff0c08b7f1d0b14ull,
+    0xaf8e5410288e1b6full, 0x07ecf0ae5ee44dd9ull,
+    0xdb71e91432b1a24aull, 0xc9e82cd9f69d6150ull,
+    0x892731ac9faf056eull, 0xbe311c083a225cd2ull,
+    0xab70fe17c79ac6caull, 0x6dbd630a48aaf406ull,
+    0xd64d3d9db981787dull, 0x092cbbccdad5b108ull,
+    0x85f0468293f0eb4eull, 0x25bbf56008c58ea5ull,
+    0xa76c582338ed2621ull, 0xaf2af2b80af6f24eull,
+    0xd1476e2c07286faaull, 0x1af5af660db4aee1ull,
+    0x82cca4db847945caull, 0x50d98d9fc890ed4dull,
+    0xa37fce126597973cull, 0xe50ff107bab528a0ull,
+    0xcc5fc196fefd7d0cull, 0x1e53ed49a96272c8ull,
+    0xff77b1fcbebcdc4full, 0x25e8e89c13bb0f7aull,
+    0x9faacf3df73609b1ull, 0x77b191618c54e9acull,
+    0xc795830d75038c1dull, 0xd59df5b9ef6a2417ull,
+    0xf97ae3d0d2446f25ull, 0x4b0573286b44ad1dull,
+    0x9becce62836ac577ull, 0x4ee367f9430aec32ull,
+    0xc2e801fb244576d5ull, 0x229c41f793cda73full,
+    0xf3a20279ed56d48aull, 0x6b43527578c1110full,
+    0x9845418c345644d6ull, 0x830a13896b78aaa9ull,
+    0xbe5691ef416bd60cull, 0x23cc986bc656d553ull,
+    0xedec366b11c6cb8full, 0x2cbfbe86b7ec8aa8ull,
+    0x94b3a202eb1c3f39ull, 0x7bf7d71432f3d6a9ull,
+    0xb9e08a83a5e34f07ull, 0xdaf5ccd93fb0cc53ull,
+    0xe858ad248f5c22c9ull, 0xd1b3400f8f9cff68ull,
+    0x91376c36d99995beull, 0x23100809b9c21fa1ull,
+    0xb58547448ffffb2dull, 0xabd40a0c2832a78aull,
+    0xe2e69915b3fff9f9ull, 0x16c90c8f323f516cull,
+    0x8dd01fad907ffc3bull, 0xae3da7d97f6792e3ull,
+    0xb1442798f49ffb4aull, 0x99cd11cfdf41779cull,
+    0xdd95317f31c7fa1dull, 0x40405643d711d583ull,
+    0x8a7d3eef7f1cfc52ull, 0x482835ea666b2572ull,
+    0xad1c8eab5ee43b66ull, 0xda3243650005eecfull,
+    0xd863b256369d4a40ull, 0x90bed43e40076a82ull,
+    0x873e4f75e2224e68ull, 0x5a7744a6e804a291ull,
+    0xa90de3535aaae202ull, 0x711515d0a205cb36ull,
+    0xd3515c2831559a83ull, 0x0d5a5b44ca873e03ull,
+    0x8412d9991ed58091ull, 0xe858790afe9486c2ull,
+    0xa5178fff668ae0b6ull, 0x626e974dbe39a872ull,
+    0xce5d73ff402d98e3ull, 0xfb0a3d212dc8128full,
+    0x80fa687f881c7f8eull, 0x7ce66634bc9d0b99ull,
+    0xa139029f6a239f72ull, 0x1c1fffc1ebc44e80ull,
+    0xc987434744ac874eull, 0xa327ffb266b56220ull,
+    0xfbe9141915d7a922ull, 0x4bf1ff9f0062baa8ull,
+    0x9d71ac8fada6c9b5ull, 0x6f773fc3603db4a9ull,
+    0xc4ce17b399107c22ull, 0xcb550fb4384d21d3ull,
+    0xf6019da07f549b2bull, 0x7e2a53a146606a48ull,
+    0x99c102844f94e0fbull, 0x2eda7444cbfc426dull,
+    0xc0314325637a1939ull, 0xfa911155fefb5308ull,
+    0xf03d93eebc589f88ull, 0x793555ab7eba27caull,
+    0x96267c7535b763b5ull, 0x4bc1558b2f3458deull,
+    0xbbb01b9283253ca2ull, 0x9eb1aaedfb016f16ull,
+    0xea9c227723ee8bcbull, 0x465e15a979c1cadcull,
+    0x92a1958a7675175full, 0x0bfacd89ec191ec9ull,
+    0xb749faed14125d36ull, 0xcef980ec671f667bull,
+    0xe51c79a85916f484ull, 0x82b7e12780e7401aull,
+    0x8f31cc0937ae58d2ull, 0xd1b2ecb8b0908810ull,
+    0xb2fe3f0b8599ef07ull, 0x861fa7e6dcb4aa15ull,
+    0xdfbdcece67006ac9ull, 0x67a791e093e1d49aull,
+    0x8bd6a141006042bdull, 0xe0c8bb2c5c6d24e0ull,
+    0xaecc49914078536dull, 0x58fae9f773886e18ull,
+    0xda7f5bf590966848ull, 0xaf39a475506a899eull,
+    0x888f99797a5e012dull, 0x6d8406c952429603ull,
+    0xaab37fd7d8f58178ull, 0xc8e5087ba6d33b83ull,
+    0xd5605fcdcf32e1d6ull, 0xfb1e4a9a90880a64ull,
+    0x855c3be0a17fcd26ull, 0x5cf2eea09a55067full,
+    0xa6b34ad8c9dfc06full, 0xf42faa48c0ea481eull,
+    0xd0601d8efc57b08bull, 0xf13b94daf124da26ull,
+    0x823c12795db6ce57ull, 0x76c53d08d6b70858ull,
+    0xa2cb1717b52481edull, 0x54768c4b0c64ca6eull,
+    0xcb7ddcdda26da268ull, 0xa9942f5dcf7dfd09ull,
+    0xfe5d54150b090b02ull, 0xd3f93b35435d7c4cull,
+    0x9efa548d26e5a6e1ull, 0xc47bc5014a1a6dafull,
+    0xc6b8e9b0709f109aull, 0x359ab6419ca1091bull,
+    0xf867241c8cc6d4c0ull, 0xc30163d203c94b62ull,
+    0x9b407691d7fc44f8ull, 0x79e0de63425dcf1dull,
+    0xc21094364dfb5636ull, 0x985915fc12f542e4ull,
+    0xf294b943e17a2bc4ull, 0x3e6f5b7b17b2939dull,
+    0x979cf3ca6cec5b5aull, 0xa705992ceecf9c42ull,
+    0xbd8430bd08277231ull, 0x50c6ff782a838353ull,
+    0xece53cec4a314ebdull, 0xa4f8bf5635246428ull,
+    0x940f4613ae5ed136ull, 0x871b7795e136be99ull,
+    0xb913179899f68584ull, 0x28e2557b59846e3full,
+    0xe757dd7ec07426e5ull, 0x331aeada2fe589cfull,
+    0x9096ea6f3848984full, 0x3ff0d2c85def7621ull,
+    0xb4bca50b065abe63ull, 0x0fed077a756b53a9ull,
+    0xe1ebce4dc7f16dfbull, 0xd3e8495912c62894ull,
+    0x8d3360f09cf6e4bdull, 0x64712dd7abbbd95cull,
+    0xb080392cc4349decull, 0xbd8d794d96aacfb3ull,
+    0xdca04777f541c567ull, 0xecf0d7a0fc5583a0ull,
+    0x89e42caaf9491b60ull, 0xf41686c49db57244ull,
+    0xac5d37d5b79b6239ull, 0x311c2875c522ced5ull,
+    0xd77485cb25823ac7ull, 0x7d633293366b828bull,
+    0x86a8d39ef77164bcull, 0xae5dff9c02033197ull,
+    0xa8530886b54dbdebull, 0xd9f57f830283fdfcull,
+    0xd267caa862a12d66ull, 0xd072df63c324fd7bull,
+    0x8380dea93da4bc60ull, 0x4247cb9e59f71e6dull,
+    0xa46116538d0deb78ull, 0x52d9be85f074e608ull,
+    0xcd795be870516656ull, 0x67902e276c921f8bull,
+    0x806bd9714632dff6ull, 0x00ba1cd8a3db53b6ull,
+    0xa086cfcd97bf97f3ull, 0x80e8a40eccd228a4ull,
+    0xc8a883c0fdaf7df0ull, 0x6122cd128006b2cdull,
+    0xfad2a4b13d1b5d6cull, 0x796b805720085f81ull,
+    0x9cc3a6eec6311a63ull, 0xcbe3303674053bb0ull,
+    0xc3f490aa77bd60fcull, 0xbedbfc4411068a9cull,
+    0xf4f1b4d515acb93bull, 0xee92fb5515482d44ull,
+    0x991711052d8bf3c5ull, 0x751bdd152d4d1c4aull,
+    0xbf5cd54678eef0b6ull, 0xd262d45a78a0635dull,
+    0xef340a98172aace4ull, 0x86fb897116c87c34ull,
+    0x9580869f0e7aac0eull, 0xd45d35e6ae3d4da0ull,
+    0xbae0a846d2195712ull, 0x8974836059cca109ull,
+    0xe998d258869facd7ull, 0x2bd1a438703fc94bull,
+    0x91ff83775423cc06ull, 0x7b6306a34627ddcfull,
+    0xb67f6455292cbf08ull, 0x1a3bc84c17b1d542ull,
+    0xe41f3d6a7377eecaull, 0x20caba5f1d9e4a93ull,
+    0x8e938662882af53eull, 0x547eb47b7282ee9cull,
+    0xb23867fb2a35b28dull, 0xe99e619a4f23aa43ull,
+    0xdec681f9f4c31f31ull, 0x6405fa00e2ec94d4ull,
+    0x8b3c113c38f9f37eull, 0xde83bc408dd3dd04ull,
+    0xae0b158b4738705eull, 0x9624ab50b148d445ull,
+    0xd98ddaee19068c76ull, 0x3badd624dd9b0957ull,
+    0x87f8a8d4cfa417c9ull, 0xe54ca5d70a80e5d6ull,
+    0xa9f6d30a038d1dbcull, 0x5e9fcf4ccd211f4cull,
+    0xd47487cc8470652bull, 0x7647c3200069671full,
+    0x84c8d4dfd2c63f3bull, 0x29ecd9f40041e073ull,
+    0xa5fb0a17c777cf09ull, 0xf468107100525890ull,
+    0xcf79cc9db955c2ccull, 0x7182148d4066eeb4ull,
+    0x81ac1fe293d599bfull, 0xc6f14cd848405530ull,
+    0xa21727db38cb002full, 0xb8ada00e5a506a7cull,
+    0xca9cf1d206fdc03bull, 0xa6d90811f0e4851cull,
+    0xfd442e4688bd304aull, 0x908f4a166d1da663ull,
+    0x9e4a9cec15763e2eull, 0x9a598e4e043287feull,
+    0xc5dd44271ad3cdbaull, 0x40eff1e1853f29fdull,
+    0xf7549530e188c128ull, 0xd12bee59e68ef47cull,
+    0x9a94dd3e8cf578b9ull, 0x82bb74f8301958ceull,
+    0xc13a148e3032d6e7ull, 0xe36a52363c1faf01ull,
+    0xf18899b1bc3f8ca1ull, 0xdc44e6c3cb279ac1ull,
+    0x96f5600f15a7b7e5ull, 0x29ab103a5ef8c0b9ull,
+    0xbcb2b812db11a5deull, 0x7415d448f6b6f0e7ull,
+    0xebdf661791d60f56ull, 0x111b495b3464ad21ull,
+    0x936b9fcebb25c995ull, 0xcab10dd900beec34ull,
+    0xb84687c269ef3bfbull, 0x3d5d514f40eea742ull,
+    0xe65829b3046b0afaull, 0x0cb4a5a3112a5112ull,
+    0x8ff71a0fe2c2e6dcull, 0x47f0e785eaba72abull,
+    0xb3f4e093db73a093ull, 0x59ed216765690f56ull,
+    0xe0f218b8d25088b8ull, 0x306869c13ec3532cull,
+    0x8c974f7383725573ull, 0x1e414218c73a13fbull,
+    0xafbd2350644eeacfull, 0xe5d1929ef90898faull,
+    0xdbac6c247d62a583ull, 0xdf45f746b74abf39ull,
+    0x894bc396ce5da772ull, 0x6b8bba8c328eb783ull,
+    0xab9eb47c81f5114full, 0x066ea92f3f326564ull,
+    0xd686619ba27255a2ull, 0xc80a537b0efefebdull,
+    0x8613fd0145877585ull, 0xbd06742ce95f5f36ull,
+    0xa798fc4196e952e7ull, 0x2c48113823b73704ull,
+    0xd17f3b51fca3a7a0ull, 0xf75a15862ca504c5ull,
+    0x82ef85133de648c4ull, 0x9a984d73dbe722fbull,
+    0xa3ab66580d5fdaf5ull, 0xc13e60d0d2e0ebbaull,
+    0xcc963fee10b7d1b3ull, 0x318df905079926a8ull,
+    0xffbbcfe994e5c61full, 0xfdf17746497f7052ull,
+    0x9fd561f1fd0f9bd3ull, 0xfeb6ea8bedefa633ull,
+    0xc7caba6e7c5382c8ull, 0xfe64a52ee96b8fc0ull,
+    0xf9bd690a1b68637bull, 0x3dfdce7aa3c673b0ull,
+    0x9c1661a651213e2dull, 0x06bea10ca65c084eull,
+    0xc31bfa0fe5698db8ull, 0x486e494fcff30a62ull,
+    0xf3e2f893dec3f126ull, 0x5a89dba3c3efccfaull,
+    0x986ddb5c6b3a76b7ull, 0xf89629465a75e01cull,
+    0xbe89523386091465ull, 0xf6bbb397f1135823ull,
+    0xee2ba6c0678b597full, 0x746aa07ded582e2cull,
+    0x94db483840b717efull, 0xa8c2a44eb4571cdcull,
+    0xba121a4650e4ddebull, 0x92f34d62616ce413ull,
+    0xe896a0d7e51e1566ull, 0x77b020baf9c81d17ull,
+    0x915e2486ef32cd60ull, 0x0ace1474dc1d122eull,
+    0xb5b5ada8aaff80b8ull, 0x0d819992132456baull,
+    0xe3231912d5bf60e6ull, 0x10e1fff697ed6c69ull,
+    0x8df5efabc5979c8full, 0xca8d3ffa1ef463c1ull,
+    0xb1736b96b6fd83b3ull, 0xbd308ff8a6b17cb2ull,
+    0xddd0467c64bce4a0ull, 0xac7cb3f6d05ddbdeull,
+    0x8aa22c0dbef60ee4ull, 0x6bcdf07a423aa96bull,
+    0xad4ab7112eb3929dull, 0x86c16c98d2c953c6ull,
+    0xd89d64d57a607744ull, 0xe871c7bf077ba8b7ull,
+    0x87625f056c7c4a8bull, 0x11471cd764ad4972ull,
+    0xa93af6c6c79b5d2dull, 0xd598e40d3dd89bcfull,
+    0xd389b47879823479ull, 0x4aff1d108d4ec2c3ull,
+    0x843610cb4bf160cbull, 0xcedf722a585139baull,
+    0xa54394fe1eedb8feull, 0xc2974eb4ee658828ull,
+    0xce947a3da6a9273eull, 0x733d226229feea32ull,
+    0x811ccc668829b887ull, 0x0806357d5a3f525full,
+    0xa163ff802a3426a8ull, 0xca07c2dcb0cf26f7ull,
+    0xc9bcff6034c13052ull, 0xfc89b393dd02f0b5ull,
+    0xfc2c3f3841f17c67ull, 0xbbac2078d443ace2ull,
+    0x9d9ba7832936edc0ull, 0xd54b944b84aa4c0dull,
+    0xc5029163f384a931ull, 0x0a9e795e65d4df11ull,
+    0xf64335bcf065d37dull, 0x4d4617b5ff4a16d5ull,
+    0x99ea0196163fa42eull, 0x504bced1bf8e4e45ull,
+    0xc06481fb9bcf8d39ull, 0xe45ec2862f71e1d6ull,
+    0xf07da27a82c37088ull, 0x5d767327bb4e5a4cull,
+    0x964e858c91ba2655ull, 0x3a6a07f8d510f86full,
+    0xbbe226efb628afeaull, 0x890489f70a55368bull,
+    0xeadab0aba3b2dbe5ull, 0x2b45ac74ccea842eull,
+    0x92c8ae6b464fc96full, 0x3b0b8bc90012929dull,
+    0xb77ada0617e3bbcbull, 0x09ce6ebb40173744ull,
+    0xe55990879ddcaabdull, 0xcc420a6a101d0515ull,
+    0x8f57fa54c2a9eab6ull, 0x9fa946824a12232dull,
+    0xb32df8e9f3546564ull, 0x47939822dc96abf9ull,
+    0xdff9772470297ebdull, 0x59787e2b93bc56f7ull,
+    0x8bfbea76c619ef36ull, 0x57eb4edb3c55b65aull,
+    0xaefae51477a06b03ull, 0xede622920b6b23f1ull,
+    0xdab99e59958885c4ull, 0xe95fab368e45ecedull,
+    0x88b402f7fd75539bull, 0x11dbcb0218ebb414ull,
+    0xaae103b5fcd2a881ull, 0xd652bdc29f26a119ull,
+    0xd59944a37c0752a2ull, 0x4be76d3346f0495full,
+    0x857fcae62d8493a5ull, 0x6f70a4400c562ddbull,
+    0xa6dfbd9fb8e5b88eull, 0xcb4ccd500f6bb952ull,
+    0xd097ad07a71f26b2ull, 0x7e2000a41346a7a7ull,
+    0x825ecc24c873782full, 0x8ed400668c0c28c8ull,
+    0xa2f67f2dfa90563bull, 0x728900802f0f32faull,
+    0xcbb41ef979346bcaull, 0x4f2b40a03ad2ffb9ull,
+    0xfea126b7d78186bcull, 0xe2f610c84987bfa8ull,
+    0x9f24b832e6b0f436ull, 0x0dd9ca7d2df4d7c9ull,
+    0xc6ede63fa05d3143ull, 0x91503d1c79720dbbull,
+    0xf8a95fcf88747d94ull, 0x75a44c6397ce912aull,
+    0x9b69dbe1b548ce7cull, 0xc986afbe3ee11abaull,
+    0xc24452da229b021bull, 0xfbe85badce996168ull,
+    0xf2d56790ab41c2a2ull, 0xfae27299423fb9c3ull,
+    0x97c560ba6b0919a5ull, 0xdccd879fc967d41aull,
+    0xbdb6b8e905cb600full, 0x5400e987bbc1c920ull,
+    0xed246723473e3813ull, 0x290123e9aab23b68ull,
+    0x9436c0760c86e30bull, 0xf9a0b6720aaf6521ull,
+    0xb94470938fa89bceull, 0xf808e40e8d5b3e69ull,
+    0xe7958cb87392c2c2ull, 0xb60b1d1230b20e04ull,
+    0x90bd77f3483bb9b9ull, 0xb1c6f22b5e6f48c2ull,
+    0xb4ecd5f01a4aa828ull, 0x1e38aeb6360b1af3ull,
+    0xe2280b6c20dd5232ull, 0x25c6da63c38de1b0ull,
+    0x8d590723948a535full, 0x579c487e5a38ad0eull,
+    0xb0af48ec79ace837ull, 0x2d835a9df0c6d851ull,
+    0xdcdb1b2798182244ull, 0xf8e431456cf88e65ull,
+    0x8a08f0f8bf0f156bull, 0x1b8e9ecb641b58ffull,
+    0xac8b2d36eed2dac5ull, 0xe272467e3d222f3full,
+    0xd7adf884aa879177ull, 0x5b0ed81dcc6abb0full,
+    0x86ccbb52ea94baeaull, 0x98e947129fc2b4e9ull,
+    0xa87fea27a539e9a5ull, 0x3f2398d747b36224ull,
+    0xd29fe4b18e88640eull, 0x8eec7f0d19a03aadull,
+    0x83a3eeeef9153e89ull, 0x1953cf68300424acull,
+    0xa48ceaaab75a8e2bull, 0x5fa8c3423c052dd7ull,
+    0xcdb02555653131b6ull, 0x3792f412cb06794dull,
+    0x808e17555f3ebf11ull, 0xe2bbd88bbee40bd0ull,
+    0xa0b19d2ab70e6ed6ull, 0x5b6aceaeae9d0ec4ull,
+    0xc8de047564d20a8bull, 0xf245825a5a445275ull,
+    0xfb158592be068d2eull, 0xeed6e2f0f0d56712ull,
+    0x9ced737bb6c4183dull, 0x55464dd69685606bull,
+    0xc428d05aa4751e4cull, 0xaa97e14c3c26b886ull,
+    0xf53304714d9265dfull, 0xd53dd99f4b3066a8ull,
+    0x993fe2c6d07b7fabull, 0xe546a8038efe4029ull,
+    0xbf8fdb78849a5f96ull, 0xde98520472bdd033ull,
+    0xef73d256a5c0f77cull, 0x963e66858f6d4440ull,
+    0x95a8637627989aadull, 0xdde7001379a44aa8ull,
+    0xbb127c53b17ec159ull, 0x5560c018580d5d52ull,
+    0xe9d71b689dde71afull, 0xaab8f01e6e10b4a6ull,
+    0x9226712162ab070dull, 0xcab3961304ca70e8ull,
+    0xb6b00d69bb55c8d1ull, 0x3d607b97c5fd0d22ull,
+    0xe45c10c42a2b3b05ull, 0x8cb89a7db77c506aull,
+    0x8eb98a7a9a5b04e3ull, 0x77f3608e92adb242ull,
+    0xb267ed1940f1c61cull, 0x55f038b237591ed3ull,
+    0xdf01e85f912e37a3ull, 0x6b6c46dec52f6688ull,
+    0x8b61313bbabce2c6ull, 0x2323ac4b3b3da015ull,
+    0xae397d8aa96c1b77ull, 0xabec975e0a0d081aull,
+    0xd9c7dced53c72255ull, 0x96e7bd358c904a21ull,
+    0x881cea14545c7575ull, 0x7e50d64177da2e54ull,
+    0xaa242499697392d2ull, 0xdde50bd1d5d0b9e9ull,
+    0xd4ad2dbfc3d07787ull, 0x955e4ec64b44e864ull,
+    0x84ec3c97da624ab4ull, 0xbd5af13bef0b113eull,
+    0xa6274bbdd0fadd61ull, 0xecb1ad8aeacdd58eull,
+    0xcfb11ead453994baull, 0x67de18eda5814af2ull,
+    0x81ceb32c4b43fcf4ull, 0x80eacf948770ced7ull,
+    0xa2425ff75e14fc31ull, 0xa1258379a94d028dull,
+    0xcad2f7f5359a3b3eull, 0x096ee45813a04330ull,
+    0xfd87b5f28300ca0dull, 0x8bca9d6e188853fcull,
+    0x9e74d1b791e07e48ull, 0x775ea264cf55347eull,
+    0xc612062576589ddaull, 0x95364afe032a819eull,
+    0xf79687aed3eec551ull, 0x3a83ddbd83f52205ull,
+    0x9abe14cd44753b52ull, 0xc4926a9672793543ull,
+    0xc16d9a0095928a27ull, 0x75b7053c0f178294ull,
+    0xf1c90080baf72cb1ull, 0x5324c68b12dd6339ull,
+    0x971da05074da7beeull, 0xd3f6fc16ebca5e04ull,
+    0xbce5086492111aeaull, 0x88f4bb1ca6bcf585ull,
+    0xec1e4a7db69561a5ull, 0x2b31e9e3d06c32e6ull,
+    0x9392ee8e921d5d07ull, 0x3aff322e62439fd0ull,
+    0xb877aa3236a4b449ull, 0x09befeb9fad487c3ull,
+    0xe69594bec44de15bull, 0x4c2ebe687989a9b4ull,
+    0x901d7cf73ab0acd9ull, 0x0f9d37014bf60a11ull,
+    0xb424dc35095cd80full, 0x538484c19ef38c95ull,
+    0xe12e13424bb40e13ull, 0x2865a5f206b06fbaull,
+    0x8cbccc096f5088cbull, 0xf93f87b7442e45d4ull,
+    0xafebff0bcb24aafeull, 0xf78f69a51539d749ull,
+    0xdbe6fecebdedd5beull, 0xb573440e5a884d1cull,
+    0x89705f4136b4a597ull, 0x31680a88f8953031ull,
+    0xabcc77118461cefcull, 0xfdc20d2b36ba7c3eull,
+    0xd6bf94d5e57a42bcull, 0x3d32907604691b4dull,
+    0x8637bd05af6c69b5ull, 0xa63f9a49c2c1b110ull,
+    0xa7c5ac471b478423ull, 0x0fcf80dc33721d54ull,
+    0xd1b71758e219652bull, 0xd3c36113404ea4a9ull,
+    0x83126e978d4fdf3bull, 0x645a1cac083126eaull,
+    0xa3d70a3d70a3d70aull, 0x3d70a3d70a3d70a4ull,
+    0xccccccccccccccccull, 0xcccccccccccccccdull,
+    0x8000000000000000ull, 0x0000000000000000ull,
+    0xa000000000000000ull, 0x0000000000000000ull,
+    0xc800000000000000ull, 0x0000000000000000ull,
+    0xfa00000000000000ull, 0x0000000000000000ull,
+    0x9c40000000000000ull, 0x0000000000000000ull,
+    0xc350000000000000ull, 0x0000000000000000ull,
+    0xf424000000000000ull, 0x0000000000000000ull,
+    0x9896800000000000ull, 0x0000000000000000ull,
+    0xbebc200000000000ull, 0x0000000000000000ull,
+    0xee6b280000000000ull, 0x0000000000000000ull,
+    0x9502f90000000000ull, 0x0000000000000000ull,
+    0xba43b74000000000ull, 0x0000000000000000ull,
+    0xe8d4a51000000000ull, 0x0000000000000000ull,
+    0x9184e72a00000000ull, 0x0000000000000000ull,
+    0xb5e620f480000000ull, 0x0000000000000000ull,
+    0xe35fa931a0000000ull, 0x0000000000000000ull,
+    0x8e1bc9bf04000000ull, 0x0000000000000000ull,
+    0xb1a2bc2ec5000000ull, 0x0000000000000000ull,
+    0xde0b6b3a76400000ull, 0x0000000000000000ull,
+    0x8ac7230489e80000ull, 0x0000000000000000ull,
+    0xad78ebc5ac620000ull, 0x0000000000000000ull,
+    0xd8d726b7177a8000ull, 0x0000000000000000ull,
+    0x878678326eac9000ull, 0x0000000000000000ull,
+    0xa968163f0a57b400ull, 0x0000000000000000ull,
+    0xd3c21bcecceda100ull, 0x0000000000000000ull,
+    0x84595161401484a0ull, 0x0000000000000000ull,
+    0xa56fa5b99019a5c8ull, 0x0000000000000000ull,
+    0xcecb8f27f4200f3aull, 0x0000000000000000ull,
+    0x813f3978f8940984ull, 0x4000000000000000ull,
+    0xa18f07d736b90be5ull, 0x5000000000000000ull,
+    0xc9f2c9cd04674edeull, 0xa400000000000000ull,
+    0xfc6f7c4045812296ull, 0x4d00000000000000ull,
+    0x9dc5ada82b70b59dull, 0xf020000000000000ull,
+    0xc5371912364ce305ull, 0x6c28000000000000ull,
+    0xf684df56c3e01bc6ull, 0xc732000000000000ull,
+    0x9a130b963a6c115cull, 0x3c7f400000000000ull,
+    0xc097ce7bc90715b3ull, 0x4b9f100000000000ull,
+    0xf0bdc21abb48db20ull, 0x1e86d40000000000ull,
+    0x96769950b50d88f4ull, 0x1314448000000000ull,
+    0xbc143fa4e250eb31ull, 0x17d955a000000000ull,
+    0xeb194f8e1ae525fdull, 0x5dcfab0800000000ull,
+    0x92efd1b8d0cf37beull, 0x5aa1cae500000000ull,
+    0xb7abc627050305adull, 0xf14a3d9e40000000ull,
+    0xe596b7b0c643c719ull, 0x6d9ccd05d0000000ull,
+    0x8f7e32ce7bea5c6full, 0xe4820023a2000000ull,
+    0xb35dbf821ae4f38bull, 0xdda2802c8a800000ull,
+    0xe0352f62a19e306eull, 0xd50b2037ad200000ull,
+    0x8c213d9da502de45ull, 0x4526f422cc340000ull,
+    0xaf298d050e4395d6ull, 0x9670b12b7f410000ull,
+    0xdaf3f04651d47b4cull, 0x3c0cdd765f114000ull,
+    0x88d8762bf324cd0full, 0xa5880a69fb6ac800ull,
+    0xab0e93b6efee0053ull, 0x8eea0d047a457a00ull,
+    0xd5d238a4abe98068ull, 0x72a4904598d6d880ull,
+    0x85a36366eb71f041ull, 0x47a6da2b7f864750ull,
+    0xa70c3c40a64e6c51ull, 0x999090b65f67d924ull,
+    0xd0cf4b50cfe20765ull, 0xfff4b4e3f741cf6dull,
+    0x82818f1281ed449full, 0xbff8f10e7a8921a4ull,
+    0xa321f2d7226895c7ull, 0xaff72d52192b6a0dull,
+    0xcbea6f8ceb02bb39ull, 0x9bf4f8a69f764490ull,
+    0xfee50b7025c36a08ull, 0x02f236d04753d5b4ull,
+    0x9f4f2726179a2245ull, 0x01d762422c946590ull,
+    0xc722f0ef9d80aad6ull, 0x424d3ad2b7b97ef5ull,
+    0xf8ebad2b84e0d58bull, 0xd2e0898765a7deb2ull,
+    0x9b934c3b330c8577ull, 0x63cc55f49f88eb2full,
+    0xc2781f49ffcfa6d5ull, 0x3cbf6b71c76b25fbull,
+    0xf316271c7fc3908aull, 0x8bef464e3945ef7aull,
+    0x97edd871cfda3a56ull, 0x97758bf0e3cbb5acull,
+    0xbde94e8e43d0c8ecull, 0x3d52eeed1cbea317ull,
+    0xed63a231d4c4fb27ull, 0x4ca7aaa863ee4bddull,
+    0x945e455f24fb1cf8ull, 0x8fe8caa93e74ef6aull,
+    0xb975d6b6ee39e436ull, 0xb3e2fd538e122b44ull,
+    0xe7d34c64a9c85d44ull, 0x60dbbca87196b616ull,
+    0x90e40fbeea1d3a4aull, 0xbc8955e946fe31cdull,
+    0xb51d13aea4a488ddull, 0x6babab6398bdbe41ull,
+    0xe264589a4dcdab14ull, 0xc696963c7eed2dd1ull,
+    0x8d7eb76070a08aecull, 0xfc1e1de5cf543ca2ull,
+    0xb0de65388cc8ada8ull, 0x3b25a55f43294bcbull,
+    0xdd15fe86affad912ull, 0x49ef0eb713f39ebeull,
+    0x8a2dbf142dfcc7abull, 0x6e3569326c784337ull,
+    0xacb92ed9397bf996ull, 0x49c2c37f07965404ull,
+    0xd7e77a8f87daf7fbull, 0xdc33745ec97be906ull,
+    0x86f0ac99b4e8dafdull, 0x69a028bb3ded71a3ull,
+    0xa8acd7c0222311bcull, 0xc40832ea0d68ce0cull,
+    0xd2d80db02aabd62bull, 0xf50a3fa490c30190ull,
+    0x83c7088e1aab65dbull, 0x792667c6da79e0faull,
+    0xa4b8cab1a1563f52ull, 0x577001b891185938ull,
+    0xcde6fd5e09abcf26ull, 0xed4c0226b55e6f86ull,
+    0x80b05e5ac60b6178ull, 0x544f8158315b05b4ull,
+    0xa0dc75f1778e39d6ull, 0x696361ae3db1c721ull,
+    0xc913936dd571c84cull, 0x03bc3a19cd1e38e9ull,
+    0xfb5878494ace3a5full, 0x04ab48a04065c723ull,
+    0x9d174b2dcec0e47bull, 0x62eb0d64283f9c76ull,
+    0xc45d1df942711d9aull, 0x3ba5d0bd324f8394ull,
+    0xf5746577930d6500ull, 0xca8f44ec7ee36479ull,
+    0x9968bf6abbe85f20ull, 0x7e998b13cf4e1ecbull,
+    0xbfc2ef456ae276e8ull, 0x9e3fedd8c321a67eull,
+    0xefb3ab16c59b14a2ull, 0xc5cfe94ef3ea101eull,
+    0x95d04aee3b80ece5ull, 0xbba1f1d158724a12ull,
+    0xbb445da9ca61281full, 0x2a8a6e45ae8edc97ull,
+    0xea1575143cf97226ull, 0xf52d09d71a3293bdull,
+    0x924d692ca61be758ull, 0x593c2626705f9c56ull,
+    0xb6e0c377cfa2e12eull, 0x6f8b2fb00c77836cull,
+    0xe498f455c38b997aull, 0x0b6dfb9c0f956447ull,
+    0x8edf98b59a373fecull, 0x4724bd4189bd5eacull,
+    0xb2977ee300c50fe7ull, 0x58edec91ec2cb657ull,
+    0xdf3d5e9bc0f653e1ull, 0x2f2967b66737e3edull,
+    0x8b865b215899f46cull, 0xbd79e0d20082ee74ull,
+    0xae67f1e9aec07187ull, 0xecd8590680a3aa11ull,
+    0xda01ee641a708de9ull, 0xe80e6f4820cc9495ull,
+    0x884134fe908658b2ull, 0x3109058d147fdcddull,
+    0xaa51823e34a7eedeull, 0xbd4b46f0599fd415ull,
+    0xd4e5e2cdc1d1ea96ull, 0x6c9e18ac7007c91aull,
+    0x850fadc09923329eull, 0x03e2cf6bc604ddb0ull,
+    0xa6539930bf6bff45ull, 0x84db8346b786151cull,
+    0xcfe87f7cef46ff16ull, 0xe612641865679a63ull,
+    0x81f14fae158c5f6eull, 0x4fcb7e8f3f60c07eull,
+    0xa26da3999aef7749ull, 0xe3be5e330f38f09dull,
+    0xcb090c8001ab551cull, 0x5cadf5bfd3072cc5ull,
+    0xfdcb4fa002162a63ull, 0x73d9732fc7c8f7f6ull,
+    0x9e9f11c4014dda7eull, 0x2867e7fddcdd9afaull,
+    0xc646d63501a1511dull, 0xb281e1fd541501b8ull,
+    0xf7d88bc24209a565ull, 0x1f225a7ca91a4226ull,
+    0x9ae757596946075full, 0x3375788de9b06958ull,
+    0xc1a12d2fc3978937ull, 0x0052d6b1641c83aeull,
+    0xf209787bb47d6b84ull, 0xc0678c5dbd23a49aull,
+    0x9745eb4d50ce6332ull, 0xf840b7ba963646e0ull,
+    0xbd176620a501fbffull, 0xb650e5a93bc3d898ull,
+    0xec5d3fa8ce427affull, 0xa3e51f138ab4cebeull,
+    0x93ba47c980e98cdfull, 0xc66f336c36b10137ull,
+    0xb8a8d9bbe123f017ull, 0xb80b0047445d4184ull,
+    0xe6d3102ad96cec1dull, 0xa60dc059157491e5ull,
+    0x9043ea1ac7e41392ull, 0x87c89837ad68db2full,
+    0xb454e4a179dd1877ull, 0x29babe4598c311fbull,
+    0xe16a1dc9d8545e94ull, 0xf4296dd6fef3d67aull,
+    0x8ce2529e2734bb1dull, 0x1899e4a65f58660cull,
+    0xb01ae745b101e9e4ull, 0x5ec05dcff72e7f8full,
+    0xdc21a1171d42645dull, 0x76707543f4fa1f73ull,
+    0x899504ae72497ebaull, 0x6a06494a791c53a8ull,
+    0xabfa45da0edbde69ull, 0x0487db9d17636892ull,
+    0xd6f8d7509292d603ull, 0x45a9d2845d3c42b6ull,
+    0x865b86925b9bc5c2ull, 0x0b8a2392ba45a9b2ull,
+    0xa7f26836f282b732ull, 0x8e6cac7768d7141eull,
+    0xd1ef0244af2364ffull, 0x3207d795430cd926ull,
+    0x8335616aed761f1full, 0x7f44e6bd49e807b8ull,
+    0xa402b9c5a8d3a6e7ull, 0x5f16206c9c6209a6ull,
+    0xcd036837130890a1ull, 0x36dba887c37a8c0full,
+    0x802221226be55a64ull, 0xc2494954da2c9789ull,
+    0xa02aa96b06deb0fdull, 0xf2db9baa10b7bd6cull,
+    0xc83553c5c8965d3dull, 0x6f92829494e5acc7ull,
+    0xfa42a8b73abbf48cull, 0xcb772339ba1f17f9ull,
+    0x9c69a97284b578d7ull, 0xff2a760414536efbull,
+    0xc38413cf25e2d70dull, 0xfef5138519684abaull,
+    0xf46518c2ef5b8cd1ull, 0x7eb258665fc25d69ull,
+    0x98bf2f79d5993802ull, 0xef2f773ffbd97a61ull,
+    0xbeeefb584aff8603ull, 0xaafb550ffacfd8faull,
+    0xeeaaba2e5dbf6784ull, 0x95ba2a53f983cf38ull,
+    0x952ab45cfa97a0b2ull, 0xdd945a747bf26183ull,
+    0xba756174393d88dfull, 0x94f971119aeef9e4ull,
+    0xe912b9d1478ceb17ull, 0x7a37cd5601aab85dull,
+    0x91abb422ccb812eeull, 0xac62e055c10ab33aull,
+    0xb616a12b7fe617aaull, 0x577b986b314d6009ull,
+    0xe39c49765fdf9d94ull, 0xed5a7e85fda0b80bull,
+    0x8e41ade9fbebc27dull, 0x14588f13be847307ull,
+    0xb1d219647ae6b31cull, 0x596eb2d8ae258fc8ull,
+    0xde469fbd99a05fe3ull, 0x6fca5f8ed9aef3bbull,
+    0x8aec23d680043beeull, 0x25de7bb9480d5854ull,
+    0xada72ccc20054ae9ull, 0xaf561aa79a10ae6aull,
+    0xd910f7ff28069da4ull, 0x1b2ba1518094da04ull,
+    0x87aa9aff79042286ull, 0x90fb44d2f05d0842ull,
+    0xa99541bf57452b28ull, 0x353a1607ac744a53ull,
+    0xd3fa922f2d1675f2ull, 0x42889b8997915ce8ull,
+    0x847c9b5d7c2e09b7ull, 0x69956135febada11ull,
+    0xa59bc234db398c25ull, 0x43fab9837e699095ull,
+    0xcf02b2c21207ef2eull, 0x94f967e45e03f4bbull,
+    0x8161afb94b44f57dull, 0x1d1be0eebac278f5ull,
+    0xa1ba1ba79e1632dcull, 0x6462d92a69731732ull,
+    0xca28a291859bbf93ull, 0x7d7b8f7503cfdcfeull,
+    0xfcb2cb35e702af78ull, 0x5cda735244c3d43eull,
+    0x9defbf01b061adabull, 0x3a0888136afa64a7ull,
+    0xc56baec21c7a1916ull, 0x088aaa1845b8fdd0ull,
+    0xf6c69a72a3989f5bull, 0x8aad549e57273d45ull,
+    0x9a3c2087a63f6399ull, 0x36ac54e2f678864bull,
+    0xc0cb28a98fcf3c7full, 0x84576a1bb416a7ddull,
+    0xf0fdf2d3f3c30b9full, 0x656d44a2a11c51d5ull,
+    0x969eb7c47859e743ull, 0x9f644ae5a4b1b325ull,
+    0xbc4665b596706114ull, 0x873d5d9f0dde1feeull,
+    0xeb57ff22fc0c7959ull, 0xa90cb506d155a7eaull,
+    0x9316ff75dd87cbd8ull, 0x09a7f12442d588f2ull,
+    0xb7dcbf5354e9beceull, 0x0c11ed6d538aeb2full,
+    0xe5d3ef282a242e81ull, 0x8f1668c8a86da5faull,
+    0x8fa475791a569d10ull, 0xf96e017d694487bcull,
+    0xb38d92d760ec4455ull, 0x37c981dcc395a9acull,
+    0xe070f78d3927556aull, 0x85bbe253f47b1417ull,
+    0x8c469ab843b89562ull, 0x93956d7478ccec8eull,
+    0xaf58416654a6babbull, 0x387ac8d1970027b2ull,
+    0xdb2e51bfe9d0696aull, 0x06997b05fcc0319eull,
+    0x88fcf317f22241e2ull, 0x441fece3bdf81f03ull,
+    0xab3c2fddeeaad25aull, 0xd527e81cad7626c3ull,
+    0xd60b3bd56a5586f1ull, 0x8a71e223d8d3b074ull,
+    0x85c7056562757456ull, 0xf6872d5667844e49ull,
+    0xa738c6bebb12d16cull, 0xb428f8ac016561dbull,
+    0xd106f86e69d785c7ull, 0xe13336d701beba52ull,
+    0x82a45b450226b39cull, 0xecc0024661173473ull,
+    0xa34d721642b06084ull, 0x27f002d7f95d0190ull,
+    0xcc20ce9bd35c78a5ull, 0x31ec038df7b441f4ull,
+    0xff290242c83396ceull, 0x7e67047175a15271ull,
+    0x9f79a169bd203e41ull, 0x0f0062c6e984d386ull,
+    0xc75809c42c684dd1ull, 0x52c07b78a3e60868ull,
+    0xf92e0c3537826145ull, 0xa7709a56ccdf8a82ull,
+    0x9bbcc7a142b17ccbull, 0x88a66076400bb691ull,
+    0xc2abf989935ddbfeull, 0x6acff893d00ea435ull,
+    0xf356f7ebf83552feull, 0x0583f6b8c4124d43ull,
+    0x98165af37b2153deull, 0xc3727a337a8b704aull,
+    0xbe1bf1b059e9a8d6ull, 0x744f18c0592e4c5cull,
+    0xeda2ee1c7064130cull, 0x1162def06f79df73ull,
+    0x9485d4d1c63e8be7ull, 0x8addcb5645ac2ba8ull,
+    0xb9a74a0637ce2ee1ull, 0x6d953e2bd7173692ull,
+    0xe8111c87c5c1ba99ull, 0xc8fa8db6ccdd0437ull,
+    0x910ab1d4db9914a0ull, 0x1d9c9892400a22a2ull,
+    0xb54d5e4a127f59c8ull, 0x2503beb6d00cab4bull,
+    0xe2a0b5dc971f303aull, 0x2e44ae64840fd61dull,
+    0x8da471a9de737e24ull, 0x5ceaecfed289e5d2ull,
+    0xb10d8e1456105dadull, 0x7425a83e872c5f47ull,
+    0xdd50f1996b947518ull, 0xd12f124e28f77719ull,
+    0x8a5296ffe33cc92full, 0x82bd6b70d99aaa6full,
+    0xace73cbfdc0bfb7bull, 0x636cc64d1001550bull,
+    0xd8210befd30efa5aull, 0x3c47f7e05401aa4eull,
+    0x8714a775e3e95c78ull, 0x65acfaec34810a71ull,
+    0xa8d9d1535ce3b396ull, 0x7f1839a741a14d0dull,
+    0xd31045a8341ca07cull, 0x1ede48111209a050ull,
+    0x83ea2b892091e44dull, 0x934aed0aab460432ull,
+    0xa4e4b66b68b65d60ull, 0xf81da84d5617853full,
+    0xce1de40642e3f4b9ull, 0x36251260ab9d668eull,
+    0x80d2ae83e9ce78f3ull, 0xc1d72b7c6b426019ull,
+    0xa1075a24e4421730ull, 0xb24cf65b8612f81full,
+    0xc94930ae1d529cfcull, 0xdee033f26797b627ull,
+    0xfb9b7cd9a4a7443cull, 0x169840ef017da3b1ull,
+    0x9d412e0806e88aa5ull, 0x8e1f289560ee864eull,
+    0xc491798a08a2ad4eull, 0xf1a6f2bab92a27e2ull,
+    0xf5b5d7ec8acb58a2ull, 0xae10af696774b1dbull,
+    0x9991a6f3d6bf1765ull, 0xacca6da1e0a8ef29ull,
+    0xbff610b0cc6edd3full, 0x17fd090a58d32af3ull,
+    0xeff394dcff8a948eull, 0xddfc4b4cef07f5b0ull,
+    0x95f83d0a1fb69cd9ull, 0x4abdaf101564f98eull,
+    0xbb764c4ca7a4440full, 0x9d6d1ad41abe37f1ull,
+    0xea53df5fd18d5513ull, 0x84c86189216dc5edull,
+    0x92746b9be2f8552cull, 0x32fd3cf5b4e49bb4ull,
+    0xb7118682dbb66a77ull, 0x3fbc8c33221dc2a1ull,
+    0xe4d5e82392a40515ull, 0x0fabaf3feaa5334aull,
+    0x8f05b1163ba6832dull, 0x29cb4d87f2a7400eull,
+    0xb2c71d5bca9023f8ull, 0x743e20e9ef511012ull,
+    0xdf78e4b2bd342cf6ull, 0x914da9246b255416ull,
+    0x8bab8eefb6409c1aull, 0x1ad089b6c2f7548eull,
+    0xae9672aba3d0c320ull, 0xa184ac2473b529b1ull,
+    0xda3c0f568cc4f3e8ull, 0xc9e5d72d90a2741eull,
+    0x8865899617fb1871ull, 0x7e2fa67c7a658892ull,
+    0xaa7eebfb9df9de8dull, 0xddbb901b98feeab7ull,
+    0xd51ea6fa85785631ull, 0x552a74227f3ea565ull,
+    0x8533285c936b35deull, 0xd53a88958f87275full,
+    0xa67ff273b8460356ull, 0x8a892abaf368f137ull,
+    0xd01fef10a657842cull, 0x2d2b7569b0432d85ull,
+    0x8213f56a67f6b29bull, 0x9c3b29620e29fc73ull,
+    0xa298f2c501f45f42ull, 0x8349f3ba91b47b8full,
+    0xcb3f2f7642717713ull, 0x241c70a936219a73ull,
+    0xfe0efb53d30dd4d7ull, 0xed238cd383aa0110ull,
+    0x9ec95d1463e8a506ull, 0xf4363804324a40aaull,
+    0xc67bb4597ce2ce48ull, 0xb143c6053edcd0d5ull,
+    0xf81aa16fdc1b81daull, 0xdd94b7868e94050aull,
+    0x9b10a4e5e9913128ull, 0xca7cf2b4191c8326ull,
+    0xc1d4ce1f63f57d72ull, 0xfd1c2f611f63a3f0ull,
+    0xf24a01a73cf2dccfull, 0xbc633b39673c8cecull,
+    0x976e41088617ca01ull, 0xd5be0503e085d813ull,
+    0xbd49d14aa79dbc82ull, 0x4b2d8644d8a74e18ull,
+    0xec9c459d51852ba2ull, 0xddf8e7d60ed1219eull,
+    0x93e1ab8252f33b45ull, 0xcabb90e5c942b503ull,
+    0xb8da1662e7b00a17ull, 0x3d6a751f3b936243ull,
+    0xe7109bfba19c0c9dull, 0x0cc512670a783ad4ull,
+    0x906a617d450187e2ull, 0x27fb2b80668b24c5ull,
+    0xb484f9dc9641e9daull, 0xb1f9f660802dedf6ull,
+    0xe1a63853bbd26451ull, 0x5e7873f8a0396973ull,
+    0x8d07e33455637eb2ull, 0xdb0b487b6423e1e8ull,
+    0xb049dc016abc5e5full, 0x91ce1a9a3d2cda62ull,
+    0xdc5c5301c56b75f7ull, 0x7641a140cc7810fbull,
+    0x89b9b3e11b6329baull, 0xa9e904c87fcb0a9dull,
+    0xac2820d9623bf429ull, 0x546345fa9fbdcd44ull,
+    0xd732290fbacaf133ull, 0xa97c177947ad4095ull,
+    0x867f59a9d4bed6c0ull, 0x49ed8eabcccc485dull,
+    0xa81f301449ee8c70ull, 0x5c68f256bfff5a74ull,
+    0xd226fc195c6a2f8cull, 0x73832eec6fff3111ull,
+    0x83585d8fd9c25db7ull, 0xc831fd53c5ff7eabull,
+    0xa42e74f3d032f525ull, 0xba3e7ca8b77f5e55ull,
+    0xcd3a1230c43fb26full, 0x28ce1bd2e55f35ebull,
+    0x80444b5e7aa7cf85ull, 0x7980d163cf5b81b3ull,
+    0xa0555e361951c366ull, 0xd7e105bcc332621full,
+    0xc86ab5c39fa63440ull, 0x8dd9472bf3fefaa7ull,
+    0xfa856334878fc150ull, 0xb14f98f6f0feb951ull,
+    0x9c935e00d4b9d8d2ull, 0x6ed1bf9a569f33d3ull,
+    0xc3b8358109e84f07ull, 0x0a862f80ec4700c8ull,
+    0xf4a642e14c6262c8ull, 0xcd27bb612758c0faull,
+    0x98e7e9cccfbd7dbdull, 0x8038d51cb897789cull,
+    0xbf21e44003acdd2cull, 0xe0470a63e6bd56c3ull,
+    0xeeea5d5004981478ull, 0x1858ccfce06cac74ull,
+    0x95527a5202df0ccbull, 0x0f37801e0c43ebc8ull,
+    0xbaa718e68396cffdull, 0xd30560258f54e6baull,
+    0xe950df20247c83fdull, 0x47c6b82ef32a2069ull,
+    0x91d28b7416cdd27eull, 0x4cdc331d57fa5441ull,
+    0xb6472e511c81471dull, 0xe0133fe4adf8e952ull,
+    0xe3d8f9e563a198e5ull, 0x58180fddd97723a6ull,
+    0x8e679c2f5e44ff8full, 0x570f09eaa7ea7648ull,
+};
+
+typedef struct {
+    int mantissaBits;           // explicit mantissa bits
+    int minimumExponent;        // the bias, negated
+    int infinitePower;          // the biased exponent of infinity
+    int smallestPowerOfTen;     // below which every mantissa rounds to zero
+    int largestPowerOfTen;      // above which every mantissa overflows
+    int minRoundToEven;         // the range of powers in which a tie can be exact
+    int maxRoundToEven;
+} ts_FloatFormat_t;
+
+static const ts_FloatFormat_t ts_Binary64 = { 52, -1023, 0x7ff, -342, 308, -4, 23 };
+static const ts_FloatFormat_t ts_Binary32 = { 23, -127, 0xff, -65, 38, -17, 10 };
+
+typedef struct {
+    uint64_t mantissa;          // up to the first 19 significant digits
+    int64_t exponent;           // the power of ten that scales mantissa
+    _Bool negative;
+    _Bool truncated;            // nonzero digits beyond the first 19 were dropped
+} ts_Decimal_t;
+
+static inline _Bool ts_IsDigit(char c)
 {
-    char const* start = pCurr;
+    return (unsigned char)(c - '0') < 10;
+}
 
-    _Bool foundNumeric = false;
-    pCurr = tsScanForNonWhiteSpace(pCurr, pEnd);
+static inline uint64_t ts_Load8(char const* p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
 
-    int ret = 0;
+static const uint64_t ts_PowersOfTenU64[20] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+    1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+    100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+    1000000000000000000ull, 10000000000000000000ull
+};
 
-    _Bool signFlip = false;
+// Reads the run of up to eight digits at p, which must have eight bytes to
+// read, without a branch per digit. Returns the length of the run, and its
+// value in *value. A byte is a digit if, xored with '0', it is at most 9;
+// the first byte that is not ends the run.
+static inline int ts_ReadDigits8(char const* p, uint32_t* value)
+{
+    uint64_t x = ts_Load8(p) ^ 0x3030303030303030ull;
+    uint64_t nonDigit = (x | (x + 0x0606060606060606ull)) & 0xf0f0f0f0f0f0f0f0ull;
+    int n = nonDigit ? ts_Ctz64(nonDigit) >> 3 : 8;
+    if (n == 0) {
+        *value = 0;
+        return 0;
+    }
+    // keep the run, as the last n of eight digits, then combine adjacent
+    // digits into pairs, the pairs into fours, and the fours into the value
+    x <<= 64 - 8 * n;
+    x = (x * 10) + (x >> 8);
+    x = (((x & 0x000000ff000000ffull) * 0x000f424000000064ull) +            // 100 + (1000000 << 32)
+         (((x >> 16) & 0x000000ff000000ffull) * 0x0000271000000001ull)) >> 32;  // 1 + (10000 << 32)
+    *value = (uint32_t) x;
+    return n;
+}
 
-    if (*pCurr == '+')
-    {
-        ++pCurr;
+// Accumulates the digits at p, wrapping past 19 of them, and returns the end.
+static char const* ts_AccumulateDigits(char const* p, char const* pEnd, uint64_t* value)
+{
+    uint64_t v = *value;
+    while (pEnd - p >= 8) {
+        uint32_t chunk;
+        int n = ts_ReadDigits8(p, &chunk);
+        v = v * ts_PowersOfTenU64[n] + chunk;
+        p += n;
+        if (n < 8) {
+            *value = v;
+            return p;
+        }
     }
-    else if (*pCurr == '-')
-    {
-        ++pCurr;
-        signFlip = true;
+    while (p < pEnd && ts_IsDigit(*p)) {
+        v = v * 10 + (uint64_t)(*p - '0');
+        ++p;
     }
+    *value = v;
+    return p;
+}
 
-    while (pCurr < pEnd)
-    {
-        if (!tsIsNumeric(*pCurr))
-        {
-            break;
+// Returns the end of the digits at p, finding it eight bytes at a time.
+static char const* ts_SkipDigits(char const* p, char const* pEnd)
+{
+    while (pEnd - p >= 8) {
+        uint64_t x = ts_Load8(p) ^ 0x3030303030303030ull;
+        uint64_t nonDigit = (x | (x + 0x0606060606060606ull)) & 0xf0f0f0f0f0f0f0f0ull;
+        if (nonDigit)
+            return p + (ts_Ctz64(nonDigit) >> 3);
+        p += 8;
+    }
+    while (p < pEnd && ts_IsDigit(*p))
+        ++p;
+    return p;
+}
+
+// Reads [+-] digits [. digits] [e [+-] digits], with a digit before or after
+// the point. Returns pCurr if there is no number; *isFloat is set if there is
+// a point or an exponent.
+static char const* ts_ParseDecimal(char const* pCurr, char const* pEnd, ts_Decimal_t* d, _Bool* isFloat)
+{
+    char const* p = pCurr;
+    memset(d, 0, sizeof(*d));
+    *isFloat = false;
+    if (p < pEnd && (*p == '+' || *p == '-')) {
+        d->negative = *p == '-';
+        ++p;
+    }
+
+    char const* intBegin = p;
+    uint64_t m = 0;
+    p = ts_AccumulateDigits(p, pEnd, &m);
+    char const* intEnd = p;
+    char const* fracBegin = p;
+    int64_t digitCount = intEnd - intBegin;
+    int64_t exponent = 0;
+    if (p < pEnd && *p == '.') {
+        fracBegin = ++p;
+        p = ts_AccumulateDigits(p, pEnd, &m);
+        exponent = -(int64_t)(p - fracBegin);
+        digitCount += p - fracBegin;
+        *isFloat = true;
+    }
+    if (digitCount == 0)
+        return pCurr;
+    char const* digitsEnd = p;
+
+    int64_t explicitExponent = 0;
+    if (p < pEnd && (*p == 'e' || *p == 'E')) {
+        char const* q = p + 1;
+        _Bool negative = false;
+        if (q < pEnd && (*q == '+' || *q == '-')) {
+            negative = *q == '-';
+            ++q;
+        }
+        if (q < pEnd && ts_IsDigit(*q)) {
+            // saturates far beyond any finite double, in either direction
+            while (q < pEnd && ts_IsDigit(*q)) {
+                if (explicitExponent < 0x10000000)
+                    explicitExponent = explicitExponent * 10 + (*q - '0');
+                ++q;
+            }
+            if (negative)
+                explicitExponent = -explicitExponent;
+            p = q;
+            *isFloat = true;
         }
-        foundNumeric = true;
-        ret = ret * 10 + *pCurr - '0';
-        ++pCurr;
     }
 
-    if (!foundNumeric)
-        return start;
+    if (digitCount > 19) {
+        // leading zeros are not significant
+        char const* s = intBegin;
+        while (s < digitsEnd && (*s == '0' || *s == '.')) {
+            if (*s == '0')
+                --digitCount;
+            ++s;
+        }
+        if (digitCount > 19) {
+            // keep the first 19 significant digits, and note whether any
+            // nonzero digit was dropped
+            m = 0;
+            int taken = 0;
+            for (; taken < 19; ++s)
+                if (*s != '.') {
+                    m = m * 10 + (uint64_t)(*s - '0');
+                    ++taken;
+                }
+            exponent = s <= intEnd ? (int64_t)(intEnd - s) : -(int64_t)(s - fracBegin);
+            for (; s < digitsEnd; ++s)
+                if (*s != '0' && *s != '.') {
+                    d->truncated = true;
+                    break;
+                }
+        }
+    }
+    d->mantissa = m;
+    d->exponent = exponent + explicitExponent;
+    return p;
+}
 
-    if (signFlip)
-    {
-        ret = -ret;
+static inline int ts_Clz64(uint64_t x)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int n = 0;
+    while (!(x & 0x8000000000000000ull)) {
+        x <<= 1;
+        ++n;
     }
-    *result = ret;
-    return pCurr;
+    return n;
+#else
+    return __builtin_clzll(x);
+#endif
 }
 
-char const* tsGetUInt32(
-    char const* pCurr, char const* pEnd,
-    uint32_t* result)
+static inline uint64_t ts_Mul128(uint64_t a, uint64_t b, uint64_t* high)
 {
-    char const* start = pCurr;
-    pCurr = tsScanForNonWhiteSpace(pCurr, pEnd);
+#if defined(__SIZEOF_INT128__)
+    __extension__ unsigned __int128 r = (unsigned __int128) a * b;
+    *high = (uint64_t)(r >> 64);
+    return (uint64_t) r;
+#else
+    uint64_t aLo = (uint32_t) a, aHi = a >> 32;
+    uint64_t bLo = (uint32_t) b, bHi = b >> 32;
+    uint64_t lolo = aLo * bLo, lohi = aLo * bHi, hilo = aHi * bLo, hihi = aHi * bHi;
+    uint64_t cross = (lolo >> 32) + (uint32_t) lohi + hilo;
+    *high = hihi + (lohi >> 32) + (cross >> 32);
+    return (cross << 32) | (uint32_t) lolo;
+#endif
+}
 
-    uint32_t ret = 0;
-    _Bool foundNumeric = false;
+// Computes the biased binary exponent and explicit mantissa nearest w * 10^q.
+// The 128 bit product is always sufficient (Mushtak and Lemire, 2023).
+static void ts_EiselLemire(int64_t q, uint64_t w, ts_FloatFormat_t const* f, uint64_t* mantissa, int32_t* power2)
+{
+    if (w == 0 || q < f->smallestPowerOfTen) {
+        *mantissa = 0;
+        *power2 = 0;
+        return;
+    }
+    if (q > f->largestPowerOfTen) {
+        *mantissa = 0;
+        *power2 = f->infinitePower;
+        return;
+    }
+    int lz = ts_Clz64(w);
+    w <<= lz;
+
+    int index = 2 * (int)(q + 342);
+    uint64_t high;
+    uint64_t low = ts_Mul128(w, ts_PowersOfFive128[index], &high);
+    uint64_t precisionMask = 0xffffffffffffffffull >> (f->mantissaBits + 3);
+    if ((high & precisionMask) == precisionMask) {
+        uint64_t secondHigh;
+        ts_Mul128(w, ts_PowersOfFive128[index + 1], &secondHigh);
+        low += secondHigh;
+        if (secondHigh > low)
+            ++high;
+    }
 
-    while (pCurr < pEnd)
-    {
-        if (!tsIsNumeric(*pCurr))
-        {
-            break;
+    int upperBit = (int)(high >> 63);
+    int shift = upperBit + 64 - f->mantissaBits - 3;
+    uint64_t m = high >> shift;
+    // floor(log2(10^q)) + 63, by a fixed point multiply
+    int32_t p2 = (int32_t)((((152170 + 65536) * q) >> 16) + 63) + upperBit - lz - f->minimumExponent;
+
+    if (p2 <= 0) {
+        // subnormal
+        if (-p2 + 1 >= 64) {
+            *mantissa = 0;
+            *power2 = 0;
+            return;
         }
-        foundNumeric = true;
-        ret = ret * 10 + *pCurr - '0';
-        ++pCurr;
+        m >>= -p2 + 1;
+        m += m & 1;
+        m >>= 1;
+        *power2 = m < (1ull << f->mantissaBits) ? 0 : 1;
+        *mantissa = m;
+        return;
+    }
+
+    // an exact tie rounds to even rather than up
+    if (low <= 1 && q >= f->minRoundToEven && q <= f->maxRoundToEven && (m & 3) == 1 && (m << shift) == high)
+        m &= ~1ull;
+    m += m & 1;
+    m >>= 1;
+    if (m >= (2ull << f->mantissaBits)) {
+        m = 1ull << f->mantissaBits;
+        ++p2;
+    }
+    m &= ~(1ull << f->mantissaBits);
+    if (p2 >= f->infinitePower) {
+        p2 = f->infinitePower;
+        m = 0;
+    }
+    *mantissa = m;
+    *power2 = p2;
+}
+
+// Rounds d to the format, returning false if the digits beyond the first 19
+// could change the result.
+static _Bool ts_DecimalToBits(ts_Decimal_t const* d, ts_FloatFormat_t const* f, uint64_t* bits)
+{
+    uint64_t m;
+    int32_t p2;
+    ts_EiselLemire(d->exponent, d->mantissa, f, &m, &p2);
+    if (d->truncated) {
+        uint64_t m1;
+        int32_t p21;
+        ts_EiselLemire(d->exponent, d->mantissa + 1, f, &m1, &p21);
+        if (m != m1 || p2 != p21)
+            return false;
     }
+    *bits = m | ((uint64_t) p2 << f->mantissaBits);
+    if (d->negative)
+        *bits |= 1ull << (f->mantissaBits + (f->mantissaBits == 52 ? 11 : 8));
+    return true;
+}
+
+// strtod reads the locale's decimal point, so the number is copied with
+// its point replaced.
+static double ts_StrtodLocaleSafe(char const* begin, char const* end, _Bool single)
+{
+    char buffer[128];
+    size_t n = (size_t)(end - begin);
+    char* copy = n < sizeof(buffer) ? buffer : (char*) malloc(n + 1);
+    if (!copy)
+        return 0;
+    char point = localeconv()->decimal_point[0];
+    for (size_t i = 0; i < n; ++i)
+        copy[i] = begin[i] == '.' ? point : begin[i];
+    copy[n] = '\0';
+    double result = single ? strtof(copy, NULL) : strtod(copy, NULL);
+    if (copy != buffer)
+        free(copy);
+    return result;
+}
+
+static const double ts_ExactPowersOfTen[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Rounds d, read from [begin, end), to the nearest double.
+static double ts_DecimalToDouble(ts_Decimal_t const* d, char const* begin, char const* end)
+{
+    // Clinger: both operands are exact, so one rounding gives the answer
+#if !defined(FLT_EVAL_METHOD) || FLT_EVAL_METHOD == 0
+    if (!d->truncated && d->mantissa <= (1ull << 53) && d->exponent >= -22 && d->exponent <= 22) {
+        double v = (double) d->mantissa;
+        v = d->exponent < 0 ? v / ts_ExactPowersOfTen[-d->exponent] : v * ts_ExactPowersOfTen[d->exponent];
+        return d->negative ? -v : v;
+    }
+#endif
+    uint64_t bits;
+    if (!ts_DecimalToBits(d, &ts_Binary64, &bits))
+        return ts_StrtodLocaleSafe(begin, end, false);
+    double result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+char const* tsGetDouble(
+    char const* pCurr, char const* pEnd,
+    double* result)
+{
+    char const* start = pCurr;
+    pCurr = tsScanForNonWhiteSpace(pCurr, pEnd);
 
-    if (!foundNumeric)
+    ts_Decimal_t d;
+    _Bool isFloat;
+    char const* next = ts_ParseDecimal(pCurr, pEnd, &d, &isFloat);
+    if (next == pCurr || !isFloat)
         return start;
+    *result = ts_DecimalToDouble(&d, pCurr, next);
+    return next;
+}
 
-    *result = ret;
-    return pCurr;
+// Rounds d, read from [begin, end), to the nearest float.
+static float ts_DecimalToFloat(ts_Decimal_t const* d, char const* begin, char const* end)
+{
+    // The double from Clinger's path is correctly rounded, and so lies on
+    // the same side of every float rounding boundary as the exact value,
+    // unless it lies on the boundary itself.
+#if !defined(FLT_EVAL_METHOD) || FLT_EVAL_METHOD == 0
+    if (!d->truncated && d->mantissa <= (1ull << 53) && d->exponent >= -22 && d->exponent <= 22) {
+        double v = (double) d->mantissa;
+        v = d->exponent < 0 ? v / ts_ExactPowersOfTen[-d->exponent] : v * ts_ExactPowersOfTen[d->exponent];
+        uint64_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        if ((v == 0 || (v >= FLT_MIN && v <= FLT_MAX)) && (bits & 0x1fffffffull) != 0x10000000ull)
+            return d->negative ? -(float) v : (float) v;
+    }
+#endif
+    uint64_t bits;
+    if (!ts_DecimalToBits(d, &ts_Binary32, &bits))
+        return (float) ts_StrtodLocaleSafe(begin, end, true);
+    uint32_t bits32 = (uint32_t) bits;
+    float result;
+    memcpy(&result, &bits32, sizeof(result));
+    return result;
 }
 
 char const* tsGetFloat(
@@ -1196,78 +4170,216 @@ char const* tsGetFloat(
     char const* start = pCurr;
     pCurr = tsScanForNonWhiteSpace(pCurr, pEnd);
 
-    float ret = 0.0f;
-
-    _Bool signFlip = false;
-    _Bool foundNumeric = false;
+    ts_Decimal_t d;
+    _Bool isFloat;
+    char const* next = ts_ParseDecimal(pCurr, pEnd, &d, &isFloat);
+    if (next == pCurr || !isFloat)
+        return start;
+    *result = ts_DecimalToFloat(&d, pCurr, next);
+    return next;
+}
 
-    if (*pCurr == '+')
-    {
-        ++pCurr;
-    }
-    else if (*pCurr == '-')
-    {
-        ++pCurr;
-        signFlip = true;
+// Reads the digits at p, eight at a time, and returns where they end, or p
+// if there are none. A value past UINT64_MAX sets *overflow and gives
+// UINT64_MAX.
+static char const* ts_ParseUInt64(char const* p, char const* pEnd, uint64_t* result, _Bool* overflow)
+{
+    char const* begin = p;
+    while (p < pEnd && *p == '0')
+        ++p;
+    char const* significant = p;
+    uint64_t v = 0;
+    p = ts_AccumulateDigits(p, pEnd, &v);
+    *overflow = false;
+    if (p == begin)
+        return begin;
+
+    // 19 digits always fit, and 20 may
+    ptrdiff_t digits = p - significant;
+    if (digits > 19) {
+        if (digits > 20)
+            *overflow = true;
+        else {
+            v = 0;
+            ts_AccumulateDigits(significant, significant + 19, &v);
+            uint64_t last = (uint64_t)(significant[19] - '0');
+            if (v > (UINT64_MAX - last) / 10)
+                *overflow = true;
+            else
+                v = v * 10 + last;
+        }
     }
+    *result = *overflow ? UINT64_MAX : v;
+    return p;
+}
 
-    // get integer part
-    uint32_t uintPart;
-    const char* test = tsGetUInt32(pCurr, pEnd, &uintPart);
-    if (test == pCurr)
-        return start;
-    pCurr = test;
-
-    ret = (float) uintPart;
+char const* tsGetUInt64(
+    char const* pCurr, char const* pEnd,
+    uint64_t* result, bool* overflow)
+{
+    char const* start = pCurr;
+    pCurr = tsScanForNonWhiteSpace(pCurr, pEnd);
 
-    // get fractional part
-    if (*pCurr != '.')
-        return start;   // no decimal, not a float
+    uint64_t v;
+    _Bool over;
+    char const* next = ts_ParseUInt64(pCurr, pEnd, &v, &over);
+    if (next == pCurr)
+        return start;
+    *result = v;
+    if (overflow)
+        *overflow = over;
+    return next;
+}
 
-    ++pCurr;
+char const* tsGetInt64(
+    char const* pCurr, char const* pEnd,
+    int64_t* result, bool* overflow)
+{
+    char const* start = pCurr;
+    pCurr = tsScanForNonWhiteSpace(pCurr, pEnd);
 
-    float scaler = 0.1f;
-    while (pCurr < pEnd)
-    {
-        if (!tsIsNumeric(*pCurr))
-        {
-            break;
-        }
-        foundNumeric = true;
-        ret = ret + (float)(*pCurr - '0') * scaler;
+    _Bool negative = false;
+    if (pCurr < pEnd && (*pCurr == '+' || *pCurr == '-')) {
+        negative = *pCurr == '-';
         ++pCurr;
-        scaler *= 0.1f;
     }
+    uint64_t v;
+    _Bool over;
+    char const* next = ts_ParseUInt64(pCurr, pEnd, &v, &over);
+    if (next == pCurr)
+        return start;
 
-    // get exponent
-    if (*pCurr == 'e' || *pCurr == 'E')
-    {
-        ++pCurr;
+    uint64_t limit = negative ? (uint64_t) INT64_MAX + 1 : (uint64_t) INT64_MAX;
+    if (v > limit) {
+        v = limit;
+        over = true;
+    }
+    *result = negative ? -(int64_t)(v - 1) - 1 : (int64_t) v;
+    if (overflow)
+        *overflow = over;
+    return next;
+}
+
+// Gaps between numbers are usually a byte or two, so they are stepped over
+// a byte at a time, and only a longer run goes to the vector scanner.
+static inline char const* ts_SkipSeparators(char const* p, char const* pEnd, tsCharSet_t const* separators)
+{
+    for (int i = 0; i < 4; ++i, ++p)
+        if (p >= pEnd || !tsCharSetContains(separators, *p))
+            return p;
+    return tsScanPastCharSet(p, pEnd, separators);
+}
 
-        int32_t intPart = 0;
-        test = tsGetInt32(pCurr, pEnd, &intPart);
+static inline _Bool ts_EndsValue(char const* p, char const* pEnd, tsCharSet_t const* separators)
+{
+    return p == pEnd || tsCharSetContains(separators, *p);
+}
 
-        if (pCurr == test)
-            return start;   // e without a number following it is malformed
+typedef enum { ts_BulkDoubles, ts_BulkFloats, ts_BulkInts } ts_BulkKind_t;
 
-        ret *= powf(10.0f, (float) intPart);
+// Reads an integer in 64 bit range, or returns p.
+static inline char const* ts_LexInt64(char const* p, char const* pEnd, int64_t* result)
+{
+    char const* digits = p;
+    _Bool negative = false;
+    if (digits < pEnd && (*digits == '+' || *digits == '-')) {
+        negative = *digits == '-';
+        ++digits;
     }
+    uint64_t v;
+    _Bool overflow;
+    char const* next = ts_ParseUInt64(digits, pEnd, &v, &overflow);
+    if (next == digits || overflow || v > (uint64_t) INT64_MAX + negative)
+        return p;
+    *result = negative ? -(int64_t)(v - 1) - 1 : (int64_t) v;
+    return next;
+}
 
-    if (signFlip)
-    {
-        ret = -ret;
+// The loop of the bulk readers; kind is the type of values. Each value is
+// converted as soon as it is lexed. Lexing a block ahead and converting it
+// in a loop of its own measured slower, as the conversions are short and
+// already overlap with the lexing of the next value.
+static size_t ts_ParseBulk(ts_BulkKind_t kind, char const* pCurr, char const* pEnd,
+                           tsCharSet_t const* separators, void* values, size_t capacity,
+                           char const** stop)
+{
+    size_t count = 0;
+    char const* p = pCurr;
+    while (count < capacity) {
+        char const* value = ts_SkipSeparators(p, pEnd, separators);
+        char const* next;
+        ts_Decimal_t d;
+        int64_t i = 0;
+        if (kind == ts_BulkInts)
+            next = ts_LexInt64(value, pEnd, &i);
+        else {
+            _Bool isFloat;
+            next = ts_ParseDecimal(value, pEnd, &d, &isFloat);
+        }
+        if (next == value || !ts_EndsValue(next, pEnd, separators)) {
+            p = value;
+            break;
+        }
+        switch (kind) {
+        case ts_BulkDoubles: ((double*) values)[count] = ts_DecimalToDouble(&d, value, next); break;
+        case ts_BulkFloats: ((float*) values)[count] = ts_DecimalToFloat(&d, value, next); break;
+        case ts_BulkInts: ((int64_t*) values)[count] = i; break;
+        }
+        ++count;
+        p = next;
     }
-    *result = ret;
-    return pCurr;
+    if (stop)
+        *stop = p;
+    return count;
 }
 
-char const* tsGetHex(
-    char const* pCurr, char const* pEnd,
-    uint32_t* result)
+size_t tsParseDoubles(char const* pCurr, char const* pEnd, tsCharSet_t const* separators,
+                      double* values, size_t capacity, char const** stop)
 {
-    pCurr = tsScanForNonWhiteSpace(pCurr, pEnd);
+    return ts_ParseBulk(ts_BulkDoubles, pCurr, pEnd, separators, values, capacity, stop);
+}
 
-    int ret = 0;
+size_t tsParseFloats(char const* pCurr, char const* pEnd, tsCharSet_t const* separators,
+                     float* values, size_t capacity, char const** stop)
+{
+    return ts_ParseBulk(ts_BulkFloats, pCurr, pEnd, separators, values, capacity, stop);
+}
+
+size_t tsParseInts(char const* pCurr, char const* pEnd, tsCharSet_t const* separators,
+                   int64_t* values, size_t capacity, char const** stop)
+{
+    return ts_ParseBulk(ts_BulkInts, pCurr, pEnd, separators, values, capacity, stop);
+}
+
+char const* tsGetInt32(
+    char const* pCurr, char const* pEnd,
+    int32_t* result)
+{
+    int64_t v;
+    char const* next = tsGetInt64(pCurr, pEnd, &v, NULL);
+    if (next != pCurr)
+        *result = v < INT32_MIN ? INT32_MIN : v > INT32_MAX ? INT32_MAX : (int32_t) v;
+    return next;
+}
+
+char const* tsGetUInt32(
+    char const* pCurr, char const* pEnd,
+    uint32_t* result)
+{
+    uint64_t v;
+    char const* next = tsGetUInt64(pCurr, pEnd, &v, NULL);
+    if (next != pCurr)
+        *result = v > UINT32_MAX ? UINT32_MAX : (uint32_t) v;
+    return next;
+}
+
+char const* tsGetHex(
+    char const* pCurr, char const* pEnd,
+    uint32_t* result)
+{
+    pCurr = tsScanForNonWhiteSpace(pCurr, pEnd);
+
+    int ret = 0;
 
     while (pCurr < pEnd)
     {
@@ -1317,6 +4429,35 @@ _Bool tsIsAlpha(char test)
     return ((test >= 'a' && test <= 'z') || (test >= 'A' && test <= 'Z'));
 }
 
+void tsCharSetClear(tsCharSet_t* set)
+{
+    memset(set->bits, 0, sizeof(set->bits));
+}
+
+void tsCharSetAdd(tsCharSet_t* set, char c)
+{
+    uint8_t u = (uint8_t) c;
+    set->bits[((u & 0x80) >> 3) | (u & 0x0f)] |= (uint8_t)(1u << ((u >> 4) & 7));
+}
+
+void tsCharSetAddString(tsCharSet_t* set, char const* chars)
+{
+    for (; chars && *chars; ++chars)
+        tsCharSetAdd(set, *chars);
+}
+
+void tsCharSetAddRange(tsCharSet_t* set, char first, char last)
+{
+    for (int c = (uint8_t) first; c <= (uint8_t) last; ++c)
+        tsCharSetAdd(set, (char) c);
+}
+
+void tsCharSetAddAlphaNumeric(tsCharSet_t* set)
+{
+    for (int i = 0; i < 32; ++i)
+        set->bits[i] |= ts_AlphaNumericSet.bits[i];
+}
+
 
 
 _Bool tsStrViewBegins(const tsStrView_t *s, const tsStrView_t *rhs) {
@@ -1414,23 +4555,29 @@ tsStrView_t tsStrViewGetNameSpacedTokenAlphaNumeric(const tsStrView_t* s, char n
     return (tsStrView_t){ next, (size_t) (s->curr + s->sz - next) };
 }
 
-tsStrView_t tsStrViewGetString(const tsStrView_t* s, bool recognizeEscapes, tsStrView_t* result) {
-    if (!s || !result) {
+tsStrView_t tsStrViewGetTokenCharSet(const tsStrView_t* s, tsCharSet_t const* accept, tsStrView_t* result) {
+    if (!s || !result || !accept) {
         return (tsStrView_t){ NULL, 0 };
     }
     uint32_t sz;
-    char const* next = tsGetString(s->curr, s->curr + s->sz, recognizeEscapes, &result->curr, &sz);
+    char const* next = tsGetTokenCharSet(s->curr, s->curr + s->sz, accept, &result->curr, &sz);
     result->sz = sz;
     return (tsStrView_t){ next, (size_t) (s->curr + s->sz - next) };
 }
 
+tsStrView_t tsStrViewGetString(const tsStrView_t* s, bool recognizeEscapes, tsStrView_t* result) {
+    if (!s || !result) {
+        return (tsStrView_t){ NULL, 0 };
+    }
+    char const* next = ts_GetString(s->curr, s->curr + s->sz, recognizeEscapes, &result->curr, &result->sz);
+    return (tsStrView_t){ next, (size_t) (s->curr + s->sz - next) };
+}
+
 tsStrView_t tsStrViewGetString2(const tsStrView_t* s, char strDelim, bool recognizeEscapes, tsStrView_t* result) {
     if (!s || !result) {
         return (tsStrView_t){ NULL, 0 };
     }
-    uint32_t sz;
-    char const* next = tsGetString2(s->curr, s->curr + s->sz, strDelim, recognizeEscapes, &result->curr, &sz);
-    result->sz = sz;
+    char const* next = ts_GetString2(s->curr, s->curr + s->sz, strDelim, recognizeEscapes, &result->curr, &result->sz);
     return (tsStrView_t){ next, (size_t) (s->curr + s->sz - next) };
 }
 
@@ -1442,6 +4589,22 @@ tsStrView_t tsStrViewGetInt16(const tsStrView_t* s, int16_t* result) {
     return (tsStrView_t){ next, (size_t) (s->curr + s->sz - next) };
 }
 
+tsStrView_t tsStrViewGetInt64(const tsStrView_t* s, int64_t* result, bool* overflow) {
+    if (!s || !result) {
+        return (tsStrView_t){ NULL, 0 };
+    }
+    char const* next = tsGetInt64(s->curr, s->curr + s->sz, result, overflow);
+    return (tsStrView_t){ next, (size_t) (s->curr + s->sz - next) };
+}
+
+tsStrView_t tsStrViewGetUInt64(const tsStrView_t* s, uint64_t* result, bool* overflow) {
+    if (!s || !result) {
+        return (tsStrView_t){ NULL, 0 };
+    }
+    char const* next = tsGetUInt64(s->curr, s->curr + s->sz, result, overflow);
+    return (tsStrView_t){ next, (size_t) (s->curr + s->sz - next) };
+}
+
 tsStrView_t tsStrViewGetInt32(const tsStrView_t* s, int32_t* result) {
     if (!s || !result) {
         return (tsStrView_t){ NULL, 0 };
@@ -1474,6 +4637,41 @@ tsStrView_t tsStrViewGetFloat(const tsStrView_t* s, float* result) {
     return (tsStrView_t){ next, (size_t) (s->curr + s->sz - next) };
 }
 
+tsStrView_t tsStrViewGetDouble(const tsStrView_t* s, double* result) {
+    if (!s || !result) {
+        return (tsStrView_t){ NULL, 0 };
+    }
+    char const* next = tsGetDouble(s->curr, s->curr + s->sz, result);
+    return (tsStrView_t){ next, (size_t) (s->curr + s->sz - next) };
+}
+
+tsStrView_t tsStrViewParseDoubles(const tsStrView_t* s, tsCharSet_t const* separators, double* values, size_t capacity, size_t* count) {
+    if (!s || !separators || !count) {
+        return (tsStrView_t){ NULL, 0 };
+    }
+    char const* next;
+    *count = tsParseDoubles(s->curr, s->curr + s->sz, separators, values, capacity, &next);
+    return (tsStrView_t){ next, (size_t) (s->curr + s->sz - next) };
+}
+
+tsStrView_t tsStrViewParseFloats(const tsStrView_t* s, tsCharSet_t const* separators, float* values, size_t capacity, size_t* count) {
+    if (!s || !separators || !count) {
+        return (tsStrView_t){ NULL, 0 };
+    }
+    char const* next;
+    *count = tsParseFloats(s->curr, s->curr + s->sz, separators, values, capacity, &next);
+    return (tsStrView_t){ next, (size_t) (s->curr + s->sz - next) };
+}
+
+tsStrView_t tsStrViewParseInts(const tsStrView_t* s, tsCharSet_t const* separators, int64_t* values, size_t capacity, size_t* count) {
+    if (!s || !separators || !count) {
+        return (tsStrView_t){ NULL, 0 };
+    }
+    char const* next;
+    *count = tsParseInts(s->curr, s->curr + s->sz, separators, values, capacity, &next);
+    return (tsStrView_t){ next, (size_t) (s->curr + s->sz - next) };
+}
+
 tsStrView_t tsStrViewScanForCharacter(const tsStrView_t* s, char c) {
     if (!s) {
         return (tsStrView_t){ NULL, 0 };
@@ -1482,6 +4680,22 @@ tsStrView_t tsStrViewScanForCharacter(const tsStrView_t* s, char c) {
     return (tsStrView_t){ next, (size_t) (s->curr + s->sz - next) };
 }
 
+tsStrView_t tsStrViewScanForCharSet(const tsStrView_t* s, tsCharSet_t const* set) {
+    if (!s || !set) {
+        return (tsStrView_t){ NULL, 0 };
+    }
+    char const* next = tsScanForCharSet(s->curr, s->curr + s->sz, set);
+    return (tsStrView_t){ next, (size_t) (s->curr + s->sz - next) };
+}
+
+tsStrView_t tsStrViewScanPastCharSet(const tsStrView_t* s, tsCharSet_t const* set) {
+    if (!s || !set) {
+        return (tsStrView_t){ NULL, 0 };
+    }
+    char const* next = tsScanPastCharSet(s->curr, s->curr + s->sz, set);
+    return (tsStrView_t){ next, (size_t) (s->curr + s->sz - next) };
+}
+
 tsStrView_t tsStrViewScanBackwardsForCharacter(const tsStrView_t* s, char c) {
     if (!s) {
         return (tsStrView_t){ NULL, 0 };
@@ -1635,60 +4849,196 @@ tsStrView_t tsStrViewStrip(const tsStrView_t* s) {
 tsParsedSexpr_t* tsParsedSexpr_New() {
     tsParsedSexpr_t* result = (tsParsedSexpr_t*)malloc(sizeof(tsParsedSexpr_t));
     // the token will be Atom, since tsSeexprAtom is 0.
+    if (result)
+        memset(result, 0, sizeof(tsParsedSexpr_t));
+    return result;
+}
+
+void tsParsedSexpr_Free(tsParsedSexpr_t* list) {
+    while (list) {
+        tsParsedSexpr_t* next = list->next;
+        free(list);
+        list = next;
+    }
+}
+
+struct tsSexprArenaSlab_t {
+    tsSexprArenaSlab_t* next;
+    tsParsedSexpr_t cells[1];       // cellsPerSlab cells follow
+};
+
+void tsSexprArena_Init(tsSexprArena_t* arena, size_t cellsPerSlab) {
+    arena->slabs = NULL;
+    arena->spare = NULL;
+    arena->cellsPerSlab = cellsPerSlab ? cellsPerSlab : 4096;
+    arena->used = arena->cellsPerSlab; // the first New allocates a slab
+}
+
+tsParsedSexpr_t* tsSexprArena_New(tsSexprArena_t* arena) {
+    if (arena->used == arena->cellsPerSlab) {
+        tsSexprArenaSlab_t* slab = arena->spare;
+        if (slab)
+            arena->spare = slab->next;
+        else {
+            slab = (tsSexprArenaSlab_t*) malloc(sizeof(tsSexprArenaSlab_t) +
+                                                (arena->cellsPerSlab - 1) * sizeof(tsParsedSexpr_t));
+            if (!slab)
+                return NULL;
+        }
+        slab->next = arena->slabs;
+        arena->slabs = slab;
+        arena->used = 0;
+    }
+    tsParsedSexpr_t* result = &arena->slabs->cells[arena->used++];
     memset(result, 0, sizeof(tsParsedSexpr_t));
     return result;
 }
 
-// recursive sexpr parser. returns the next tsStrView_t to parse, following the
-// final matched closed paren beginnning at the supplied input s.
+void tsSexprArena_Reset(tsSexprArena_t* arena) {
+    while (arena->slabs) {
+        tsSexprArenaSlab_t* slab = arena->slabs;
+        arena->slabs = slab->next;
+        slab->next = arena->spare;
+        arena->spare = slab;
+    }
+    arena->used = arena->cellsPerSlab;
+}
+
+void tsSexprArena_Free(tsSexprArena_t* arena) {
+    tsSexprArena_Reset(arena);
+    while (arena->spare) {
+        tsSexprArenaSlab_t* slab = arena->spare;
+        arena->spare = slab->next;
+        free(slab);
+    }
+}
+
+static tsParsedSexpr_t* ts_SexprNewCell(tsSexprArena_t* arena) {
+    return arena ? tsSexprArena_New(arena) : tsParsedSexpr_New();
+}
+
 tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int balance) {
-    if (!s || !s->sz || !s->curr || !currCell)
-        return (tsStrView_t){ NULL, 0 };
+    return tsStrViewParseSexprWithOptions(s, currCell, balance, NULL, NULL);
+}
 
-    tsStrView_t curr = *s;
+tsStrView_t tsStrViewParseSexprArena(tsStrView_t* s, tsParsedSexpr_t* currCell, int balance, tsSexprArena_t* arena) {
+    tsSexprParseOptions_t options = { arena, 0 };
+    return tsStrViewParseSexprWithOptions(s, currCell, balance, &options, NULL);
+}
+
+// One token of the C Sexpr grammar; strings and atoms are views into the source.
+typedef struct tsSexprLexeme_t {
+    tsSexprToken_t token;
+    char const* at;             // first byte of the token
+    union {
+        int64_t i;
+        double f;
+        tsStrView_t str;
+    };
+} tsSexprLexeme_t;
+
+// Skips comments and white space up to the opening paren of the document.
+static tsSexprStatus_t ts_SexprSkipToFirstList(tsStrView_t* curr) {
     while (true) {
-        curr = tsStrViewScanForNonWhiteSpace(&curr);
-        if (curr.sz == 0)
-            return curr; // parsing finished
-        if (*curr.curr == ';') {
-            curr = tsStrViewScanForBeginningOfNextLine(&curr); // Lisp comment
+        *curr = tsStrViewScanForNonWhiteSpace(curr);
+        if (curr->sz == 0)
+            return tsSexprOk; // parsing finished
+        if (*curr->curr == ';') {
+            *curr = tsStrViewScanForBeginningOfNextLine(curr); // Lisp comment
             continue;
         }
-        if (*curr.curr != '(') {
-            curr.sz = 0; // stop parsing
-            return curr; // error
+        if (*curr->curr != '(') {
+            curr->sz = 0; // stop parsing
+            return tsSexprErrorSyntax;
         }
-        break;
+        return tsSexprOk;
+    }
+}
+
+char const* tsSexprGetNumber(char const* pCurr, char const* pEnd, tsSexprToken_t* token, int64_t* i, double* f) {
+    // most atoms are rejected by their first byte
+    if (pCurr >= pEnd || !(ts_IsDigit(*pCurr) || *pCurr == '-' || *pCurr == '+' || *pCurr == '.'))
+        return pCurr;
+
+    ts_Decimal_t d;
+    _Bool isFloat;
+    char const* next = ts_ParseDecimal(pCurr, pEnd, &d, &isFloat);
+    if (next == pCurr)
+        return pCurr;
+
+    // an integer of up to 19 significant digits has its value in the mantissa
+    uint64_t limit = d.negative ? (uint64_t) INT64_MAX + 1 : (uint64_t) INT64_MAX;
+    if (!isFloat && d.exponent == 0 && !d.truncated && d.mantissa <= limit) {
+        *token = tsSexprInteger;
+        *i = d.negative ? -(int64_t)(d.mantissa - 1) - 1 : (int64_t) d.mantissa;
+        return next;
     }
+    *token = tsSexprFloat;
+    *f = ts_DecimalToDouble(&d, pCurr, next);
+    return next;
+}
 
-    // the loop above searched for an opening paren. now we parse the sexpr
-    currCell->next = tsParsedSexpr_New();
-    currCell->next->token = tsSexprPushList;
-    currCell = currCell->next;
-    ++balance;
+char const* tsSexprScanNumber(char const* pCurr, char const* pEnd, tsSexprToken_t* token) {
+    if (pCurr >= pEnd || !(ts_IsDigit(*pCurr) || *pCurr == '-' || *pCurr == '+' || *pCurr == '.'))
+        return pCurr;
+
+    // the grammar of ts_ParseDecimal, with the digits stepped over
+    char const* p = pCurr;
+    if (*p == '+' || *p == '-')
+        ++p;
+    char const* digits = p;
+    p = ts_SkipDigits(p, pEnd);
+    ptrdiff_t digitCount = p - digits;
+    _Bool isFloat = false;
+    if (p < pEnd && *p == '.') {
+        char const* fraction = ++p;
+        p = ts_SkipDigits(p, pEnd);
+        digitCount += p - fraction;
+        isFloat = true;
+    }
+    if (digitCount == 0)
+        return pCurr;
+    if (p < pEnd && (*p == 'e' || *p == 'E')) {
+        char const* q = p + 1;
+        if (q < pEnd && (*q == '+' || *q == '-'))
+            ++q;
+        if (q < pEnd && ts_IsDigit(*q)) {
+            p = ts_SkipDigits(q, pEnd);
+            isFloat = true;
+        }
+    }
 
-    curr.curr += 1; // consume the discovered paren
-    curr.sz -= 1;
+    // whether an integer this long fits in 64 bits takes its value to tell
+    if (!isFloat && digitCount >= 19) {
+        int64_t i;
+        double f;
+        return tsSexprGetNumber(pCurr, pEnd, token, &i, &f);
+    }
+    *token = isFloat ? tsSexprFloat : tsSexprInteger;
+    return p;
+}
 
+// Reads the next token from curr, advancing it. Returns false at the end of input.
+static _Bool ts_SexprLex(tsStrView_t* pCurr, tsSexprLexeme_t* lex) {
+    tsStrView_t curr = *pCurr;
     while (true) {
         curr = tsStrViewScanForNonWhiteSpace(&curr);
-        if (curr.sz == 0)
-            return curr; // parsing finished
-        
+        if (curr.sz == 0) {
+            *pCurr = curr;
+            return false; // parsing finished
+        }
+
+        lex->at = curr.curr;
+
         if (*curr.curr == ';') {
             curr = tsStrViewScanForBeginningOfNextLine(&curr); // Lisp comment
             continue;
         }
 
         if (*curr.curr == '\xA7') { // Latin-1 encoding of § character
-            tsStrView_t str;
-            curr = tsStrViewGetString2(&curr, '\xA7', true, &str); // parse a string with § delimiter
-            tsParsedSexpr_t* cell = tsParsedSexpr_New();
-            cell->token = tsSexprString;
-            cell->str = str;
-            currCell->next = cell;
-            currCell = cell;
-            continue;
+            curr = tsStrViewGetString2(&curr, '\xA7', true, &lex->str); // parse a string with § delimiter
+            lex->token = tsSexprString;
+            break;
         }
 
         if (*curr.curr == '\xC2' && curr.sz > 1 && *(curr.curr + 1) == '\xA7') { // UTF-8 encoding of § character
@@ -1696,74 +5046,64 @@ tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int b
             tsStrView_t adjusted_curr = curr;
             adjusted_curr.curr += 2;
             adjusted_curr.sz -= 2;
-            
-            // Find the closing UTF-8 § character manually since tsStrViewGetString2 
+
+            // Find the closing UTF-8 § character manually since tsStrViewGetString2
             // expects single-byte delimiters but UTF-8 § is 2 bytes (C2 A7)
-            tsStrView_t str;
             char const* start = adjusted_curr.curr;
             char const* end = adjusted_curr.curr;
             char const* const limit = adjusted_curr.curr + adjusted_curr.sz;
-            
+
             // Scan for closing UTF-8 § sequence (C2 A7)
             while (end < limit - 1) {
-                if (*end == '\xC2' && *(end + 1) == '\xA7') {
+                end = tsScanForCharacter(end, limit - 1, '\xC2');
+                if (end < limit - 1 && *(end + 1) == '\xA7') {
                     break; // Found closing delimiter
                 }
                 ++end;
             }
-            
+
+            lex->str.curr = start;
             if (end < limit - 1) {
                 // Found proper closing delimiter
-                str.curr = start;
-                str.sz = end - start;
-                
+                lex->str.sz = end - start;
+
                 // Position after the closing UTF-8 § (skip 2 bytes)
                 curr.curr = end + 2;
                 curr.sz = limit - (end + 2);
             } else {
                 // No closing delimiter found - treat as unterminated string
-                str.curr = start;
-                str.sz = limit - start;
+                lex->str.sz = limit - start;
                 curr.curr = limit;
                 curr.sz = 0;
             }
-            
-            tsParsedSexpr_t* cell = tsParsedSexpr_New();
-            cell->token = tsSexprString;
-            cell->str = str;
-            currCell->next = cell;
-            currCell = cell;
-            continue;
+            lex->token = tsSexprString;
+            break;
         }
 
         if (*curr.curr == '"') {
-            tsStrView_t str;
-            curr = tsStrViewGetString(&curr, true, &str); // parse a string, dealing with escaped characters
-            tsParsedSexpr_t* cell = tsParsedSexpr_New();
-            cell->token = tsSexprString;
-            cell->str = str;
-            currCell->next = cell;
-            currCell = cell;
-            continue;
-       }
+            curr = tsStrViewGetString(&curr, true, &lex->str); // parse a string, dealing with escaped characters
+            lex->token = tsSexprString;
+            break;
+        }
 
-        if (*curr.curr == ')') {
+        if (*curr.curr == ')' || *curr.curr == '(') {
+            lex->token = *curr.curr == '(' ? tsSexprPushList : tsSexprPopList;
             curr.curr += 1; // consume the discovered paren
             curr.sz -= 1;
-            --balance;
-            tsParsedSexpr_t* cell = tsParsedSexpr_New();
-            cell->token = tsSexprPopList;
-            currCell->next = cell;
-            currCell = cell;
-            continue;
+            break;
         }
 
-        if (*curr.curr == '(') {
-            curr = tsStrViewParseSexpr(&curr, currCell, balance);
-            continue;
+        // a number is read in the same pass that classifies it; anything
+        // after it is lexed again as the next token
+        char const* end = curr.curr + curr.sz;
+        char const* next = tsSexprGetNumber(curr.curr, end, &lex->token, &lex->i, &lex->f);
+        if (next != curr.curr) {
+            curr.curr = next;
+            curr.sz = (size_t)(end - next);
+            break;
         }
 
-        // consume a token, stopping at white space, parens, semicolons, or § delimiters
+        // consume an atom, stopping at white space, parens, semicolons, or § delimiters
         tsStrView_t token = curr;
         token.sz = 0;
         while (curr.sz > 0) {
@@ -1784,78 +5124,1869 @@ tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int b
         if (token.sz == 0)
             continue;
 
-        // try to parse the token as a float
-        float f;
-        tsStrView_t test = tsStrViewGetFloat(&token, &f);
-        if (test.curr != token.curr) {
-            tsParsedSexpr_t* cell = tsParsedSexpr_New();
-            cell->token = tsSexprFloat;
-            cell->f = f;
-            currCell->next = cell;
-            currCell = cell;
-            curr.curr = test.curr;
-            curr.sz -= test.sz;
-            curr = tsStrViewScanForNonWhiteSpace(&curr);
-            continue;
-        }
+        // assume it is an atom; curr is already pointing at the end of it
+        lex->token = tsSexprAtom;
+        lex->str = token;
+        break;
+    }
 
-        int32_t i;
-        test = tsStrViewGetInt32(&token, &i);
-        if (test.curr != token.curr) {
-            tsParsedSexpr_t* cell = tsParsedSexpr_New();
-            cell->token = tsSexprInteger;
-            cell->i = i;
-            currCell->next = cell;
-            currCell = cell;
-            curr.curr = test.curr;
-            curr.sz -= test.sz;
-            curr = tsStrViewScanForNonWhiteSpace(&curr);
-            continue;
+    *pCurr = tsStrViewScanForNonWhiteSpace(&curr);
+    return true;
+}
+
+// Iterative sexpr parser. Lists are tracked by the balance count alone, so
+// nesting costs no stack. Returns the remaining input, which is empty once
+// the document has been consumed, or an empty view at the point of an error.
+tsStrView_t tsStrViewParseSexprWithOptions(tsStrView_t* s, tsParsedSexpr_t* currCell, int balance,
+                                           tsSexprParseOptions_t const* options, tsSexprStatus_t* status) {
+    tsSexprStatus_t ignored;
+    if (!status)
+        status = &ignored;
+    *status = tsSexprOk;
+
+    if (!s || !s->sz || !s->curr || !currCell)
+        return (tsStrView_t){ NULL, 0 };
+
+    tsSexprArena_t* arena = options ? options->arena : NULL;
+    int maxDepth = options ? options->maxDepth : 0;
+
+    tsStrView_t curr = *s;
+    *status = ts_SexprSkipToFirstList(&curr);
+    if (*status != tsSexprOk || curr.sz == 0)
+        return curr;
+
+    // every token from the opening paren to the end of the input is appended
+    tsSexprLexeme_t lex;
+    while (ts_SexprLex(&curr, &lex)) {
+        if (lex.token == tsSexprPushList) {
+            if (maxDepth > 0 && balance >= maxDepth) {
+                *status = tsSexprErrorDepth;
+                return (tsStrView_t){ lex.at, 0 }; // stop parsing at the paren
+            }
+            ++balance;
         }
+        else if (lex.token == tsSexprPopList)
+            --balance;
 
-        // assume it is an atom
-        tsParsedSexpr_t* cell = tsParsedSexpr_New();
-        cell->token = tsSexprAtom;
-        cell->str = token;
+        tsParsedSexpr_t* cell = ts_SexprNewCell(arena);
+        if (!cell) {
+            *status = tsSexprErrorMemory;
+            return (tsStrView_t){ lex.at, 0 };
+        }
+        cell->token = lex.token;
+        if (lex.token == tsSexprInteger)
+            cell->i = lex.i;
+        else if (lex.token == tsSexprFloat)
+            cell->f = lex.f;
+        else if (lex.token == tsSexprAtom || lex.token == tsSexprString)
+            cell->str = lex.str;
         currCell->next = cell;
         currCell = cell;
-        // curr.curr is already pointing at the end of the atom, simply scan ahead
-        curr = tsStrViewScanForNonWhiteSpace(&curr);
     }
+    return curr;
 }
 
+// tsSexprIndexer_t states
+enum {
+    ts_IndexOutside = 0,
+    ts_IndexString,
+    ts_IndexLatin1String,
+    ts_IndexUtf8String,
+    ts_IndexComment
+};
 
-#ifdef __cplusplus
-namespace lab { namespace Text {
-std::vector<StrView> Split(StrView s, char splitter)
-{
-    std::vector<StrView> result;
-    char const* src = s.curr;
-    char const* curr = src;
-    size_t remaining = s.sz;
-    size_t sz = 0;
-    while (remaining > 0)
-    {
-        if (*src != splitter)
-        {
-            ++sz;
-            ++src;
+void tsSexprIndexer_Init(tsSexprIndexer_t* indexer) {
+    memset(indexer, 0, sizeof(tsSexprIndexer_t));
+    indexer->afterSeparator = 1; // a token may begin the input
+}
+
+// bits lo through hi
+static inline uint64_t ts_BitRange(int lo, int hi) {
+    return (~0ull << lo) & (~0ull >> (63 - hi));
+}
+
+// Resolves the strings and comments of one block and returns the bits of
+// its structural bytes. Strings and comments are stepped over a whole region
+// per iteration: the opener is the lowest candidate bit, and the closer the
+// lowest candidate bit after it. a7Next has bit i set if byte i + 1 is A7.
+//
+// The grammar is ParseSexpr's. A " outside a string opens one, even inside
+// an atom, as does a ;, a comment. A Latin-1 or UTF-8 § opens a string only
+// where a token may begin: at the start of the input, or after white space,
+// a paren, a " or the close of a § string. Backslashes escape in " and
+// Latin-1 § strings, and are resolved for the whole block at once.
+static uint64_t ts_SexprStructure64(tsSexprIndexer_t* ix, tsSexprClasses_t const* c, uint64_t a7Next) {
+    uint64_t sep = c->ws | c->paren | c->quote;
+    uint64_t carry = (uint64_t) ix->afterSeparator;
+
+    // Most blocks hold nothing but " strings without escapes, and a prefix
+    // xor of the quotes marks the inside of all of them at once.
+    if (!(c->semicolon | c->a7 | c->c2 | c->backslash | ix->escapedCarry | ix->nextInside)
+        && (ix->state == ts_IndexOutside || ix->state == ts_IndexString)) {
+        uint64_t in = c->quote;
+        in ^= in << 1;
+        in ^= in << 2;
+        in ^= in << 4;
+        in ^= in << 8;
+        in ^= in << 16;
+        in ^= in << 32;
+        if (ix->state == ts_IndexString)
+            in = ~in;
+        ix->state = (in >> 63) ? ts_IndexString : ts_IndexOutside;
+        ix->afterSeparator = (int)(sep >> 63);
+        uint64_t inside = in ^ c->quote;    // after each opener, through its closer
+        uint64_t tokens = ~(c->ws | c->paren | c->quote) & ((sep << 1) | carry);
+        return (c->paren | c->quote | tokens) & ~inside;
+    }
+
+    uint64_t escaped = ~ts_UnescapedQuotes(~0ull, c->backslash, &ix->escapedCarry);
+    uint64_t pairC2 = c->c2 & a7Next;       // the C2 of each C2 A7
+    uint64_t closed = ix->nextInside;       // the last byte of each § string
+    uint64_t inside = ix->nextInside;       // string and comment bytes, but not a string's opener
+    int pos = ix->nextInside ? 1 : 0;
+    ix->nextInside = 0;
+
+    while (pos < 64) {
+        uint64_t from = ~0ull << pos;
+        if (ix->state == ts_IndexOutside) {
+            uint64_t start = ~(c->ws | c->paren) & (((sep | closed) << 1) | carry);
+            uint64_t open = (c->quote | c->semicolon | ((c->a7 | pairC2) & start)) & from;
+            if (!open)
+                break;
+            int o = ts_Ctz64(open);
+            uint64_t bit = 1ull << o;
+            pos = o + 1;
+            if (c->quote & bit)
+                ix->state = ts_IndexString;
+            else if (c->semicolon & bit) {
+                ix->state = ts_IndexComment;
+                inside |= bit;
+            }
+            else if (c->a7 & bit)
+                ix->state = ts_IndexLatin1String;
+            else {
+                // the A7 of the opener may be the first byte of the next block
+                ix->state = ts_IndexUtf8String;
+                if (o == 63)
+                    ix->nextInside = 1;
+                else
+                    inside |= bit << 1;
+                pos = o + 2;
+            }
+            continue;
         }
-        else
-        {
-            result.push_back(StrView{curr, sz});
-            sz = 0;
-            ++src;
-            curr = src;
+
+        uint64_t close;
+        switch (ix->state) {
+        case ts_IndexString:        close = c->quote & ~escaped; break;
+        case ts_IndexLatin1String:  close = c->a7 & ~escaped; break;
+        case ts_IndexUtf8String:    close = pairC2; break;
+        default:                    close = c->lineEnd; break;
         }
-        --remaining;
+        close &= from;
+        if (!close) {
+            inside |= from;
+            break;
+        }
+        int e = ts_Ctz64(close);
+        inside |= ts_BitRange(pos, e);
+        pos = e + 1;
+        if (ix->state == ts_IndexLatin1String)
+            closed |= 1ull << e;
+        else if (ix->state == ts_IndexUtf8String) {
+            if (e == 63)
+                ix->nextInside = 1;
+            else {
+                inside |= 1ull << (e + 1);
+                closed |= 1ull << (e + 1);
+            }
+            pos = e + 2;
+        }
+        ix->state = ts_IndexOutside;
     }
 
-    // capture last crumb
-    if (sz > 0)
-        result.push_back(StrView{curr, sz});
+    uint64_t after = ((sep | closed) << 1) | carry;
+    ix->afterSeparator = (int)((sep | closed) >> 63);
+    uint64_t tokens = ~(c->ws | c->paren | c->quote | c->semicolon) & after;
+    return (c->paren | c->quote | tokens) & ~inside;
+}
 
-    return result;
+size_t tsSexprIndexStructure(tsSexprIndexer_t* indexer, char const* p, char const* end,
+                             uint32_t* offsets, size_t capacity, size_t* count) {
+    tsSimdKernels_t const* simd = ts_Simd();
+    char const* start = p;
+    // offsets are 32 bits, so one call indexes less than 4 GB
+    char const* limit = (uint64_t)(end - p) > 0xffffff00ull ? p + 0xffffff00ull : end;
+    size_t n = 0;
+
+    while (p < limit && capacity - n >= 64) {
+        tsSexprClasses_t c;
+        uint64_t valid = ~0ull;
+        if (end - p >= 64)
+            simd->classifySexpr64(p, &c);
+        else {
+            // the tail is padded with white space, which adds nothing
+            char block[64];
+            memset(block, ' ', sizeof(block));
+            memcpy(block, p, (size_t)(end - p));
+            simd->classifySexpr64(block, &c);
+            valid = ~0ull >> (64 - (end - p));
+        }
+
+        uint64_t a7Next = c.a7 >> 1;
+        if (end - p > 64 && p[64] == '\xA7')
+            a7Next |= 1ull << 63;
+
+        uint64_t m = ts_SexprStructure64(indexer, &c, a7Next) & valid;
+        uint32_t base = (uint32_t)(p - start);
+        for (; m; m &= m - 1)
+            offsets[n++] = base + (uint32_t) ts_Ctz64(m);
+        p += end - p >= 64 ? 64 : end - p;
+    }
+    *count = n;
+    return (size_t)(p - start);
+}
+
+void tsSexprTape_Init(tsSexprTape_t* tape) {
+    memset(tape, 0, sizeof(tsSexprTape_t));
+}
+
+void tsSexprTape_Free(tsSexprTape_t* tape) {
+    free(tape->entries);
+    tsSexprTape_Init(tape);
+}
+
+static _Bool ts_SexprTapeReserve(tsSexprTape_t* tape, size_t capacity) {
+    if (capacity <= tape->capacity)
+        return true;
+    tsSexprTapeEntry_t* entries = (tsSexprTapeEntry_t*) realloc(tape->entries, capacity * sizeof(tsSexprTapeEntry_t));
+    if (!entries)
+        return false;
+    tape->entries = entries;
+    tape->capacity = capacity;
+    return true;
+}
+
+// Lists still open where the parse ends, whether at the end of the input or
+// at an error, match the end of the tape.
+static void ts_SexprTapeCloseOpen(tsSexprTape_t* tape, uint64_t open) {
+    while (open != tsSexprTapeNoMatch) {
+        tsSexprTapeEntry_t* push = &tape->entries[open];
+        open = push->match;
+        push->match = tape->count;
+    }
+}
+
+// The same grammar as tsStrViewParseSexprWithOptions, written to one array.
+// While a list is open, its entry's match field links to the enclosing open
+// list, so matching parens needs no stack beyond the tape itself.
+tsStrView_t tsStrViewParseSexprTape(tsStrView_t* s, tsSexprTape_t* tape,
+                                    tsSexprParseOptions_t const* options, tsSexprStatus_t* status) {
+    tsSexprStatus_t ignored;
+    if (!status)
+        status = &ignored;
+    *status = tsSexprOk;
+
+    if (!tape)
+        return (tsStrView_t){ NULL, 0 };
+    tape->count = 0;
+    tape->source = s ? s->curr : NULL;
+    if (!s || !s->sz || !s->curr)
+        return (tsStrView_t){ NULL, 0 };
+
+    int maxDepth = options ? options->maxDepth : 0;
+    int balance = 0;
+    uint64_t open = tsSexprTapeNoMatch;
+
+    tsStrView_t curr = *s;
+    *status = ts_SexprSkipToFirstList(&curr);
+    if (*status != tsSexprOk || curr.sz == 0)
+        return curr;
+
+    // a generous first guess at one token per 8 bytes saves most regrowth
+    if (!ts_SexprTapeReserve(tape, s->sz / 8 + 16)) {
+        *status = tsSexprErrorMemory;
+        return (tsStrView_t){ curr.curr, 0 };
+    }
+
+    tsSexprLexeme_t lex;
+    while (ts_SexprLex(&curr, &lex)) {
+        if (tape->count == tape->capacity && !ts_SexprTapeReserve(tape, tape->capacity * 2)) {
+            *status = tsSexprErrorMemory;
+            ts_SexprTapeCloseOpen(tape, open);
+            return (tsStrView_t){ lex.at, 0 };
+        }
+        size_t index = tape->count;
+        tsSexprTapeEntry_t* e = &tape->entries[index];
+        e->token = (uint32_t) lex.token;
+        e->length = 0;
+        switch (lex.token) {
+        case tsSexprPushList:
+            if (maxDepth > 0 && balance >= maxDepth) {
+                *status = tsSexprErrorDepth;
+                ts_SexprTapeCloseOpen(tape, open);
+                return (tsStrView_t){ lex.at, 0 }; // stop parsing at the paren
+            }
+            ++balance;
+            e->match = open;
+            open = index;
+            break;
+        case tsSexprPopList:
+            --balance;
+            e->match = open;
+            if (open != tsSexprTapeNoMatch) {
+                tsSexprTapeEntry_t* push = &tape->entries[open];
+                open = push->match;
+                push->match = index;
+            }
+            break;
+        case tsSexprInteger:
+            e->i = lex.i;
+            break;
+        case tsSexprFloat:
+            e->f = lex.f;
+            break;
+        case tsSexprAtom:
+        case tsSexprString:
+            if (lex.str.sz > UINT32_MAX) {
+                *status = tsSexprErrorMemory;   // too long for the length field
+                ts_SexprTapeCloseOpen(tape, open);
+                return (tsStrView_t){ lex.at, 0 };
+            }
+            e->offset = (uint64_t)(lex.str.curr - s->curr);
+            e->length = (uint32_t) lex.str.sz;
+            break;
+        }
+        ++tape->count;
+    }
+
+    ts_SexprTapeCloseOpen(tape, open);
+    return curr;
+}
+
+tsStrView_t tsSexprTape_String(tsSexprTape_t const* tape, size_t index) {
+    tsSexprTapeEntry_t const* e = &tape->entries[index];
+    if (e->token != tsSexprAtom && e->token != tsSexprString)
+        return (tsStrView_t){ NULL, 0 };
+    return (tsStrView_t){ tape->source + e->offset, e->length };
+}
+
+size_t tsSexprTape_Skip(tsSexprTape_t const* tape, size_t index) {
+    tsSexprTapeEntry_t const* e = &tape->entries[index];
+    if (e->token == tsSexprPushList)
+        return e->match < tape->count ? (size_t) e->match + 1 : tape->count;
+    return index + 1;
+}
+
+// The same grammar as tsStrViewParseSexprWithOptions, delivered to callbacks.
+tsStrView_t tsStrViewParseSexprHandler(tsStrView_t* s, tsSexprHandler_t const* handler,
+                                       tsSexprParseOptions_t const* options, tsSexprStatus_t* status) {
+    tsSexprStatus_t ignored;
+    if (!status)
+        status = &ignored;
+    *status = tsSexprOk;
+
+    if (!s || !s->sz || !s->curr || !handler)
+        return (tsStrView_t){ NULL, 0 };
+
+    int maxDepth = options ? options->maxDepth : 0;
+    int balance = 0;
+    void* user = handler->user;
+
+    tsStrView_t curr = *s;
+    *status = ts_SexprSkipToFirstList(&curr);
+    if (*status != tsSexprOk || curr.sz == 0)
+        return curr;
+
+    tsSexprLexeme_t lex;
+    while (ts_SexprLex(&curr, &lex)) {
+        switch (lex.token) {
+        case tsSexprPushList:
+            if (maxDepth > 0 && balance >= maxDepth) {
+                *status = tsSexprErrorDepth;
+                return (tsStrView_t){ lex.at, 0 }; // stop parsing at the paren
+            }
+            ++balance;
+            if (handler->onPush)
+                handler->onPush(user);
+            break;
+        case tsSexprPopList:
+            --balance;
+            if (handler->onPop)
+                handler->onPop(user);
+            break;
+        case tsSexprInteger:
+            if (handler->onInt)
+                handler->onInt(user, lex.i);
+            break;
+        case tsSexprFloat:
+            if (handler->onFloat)
+                handler->onFloat(user, lex.f);
+            break;
+        case tsSexprAtom:
+            if (handler->onAtom)
+                handler->onAtom(user, lex.str);
+            break;
+        case tsSexprString:
+            if (handler->onString)
+                handler->onString(user, lex.str);
+            break;
+        }
+    }
+    return curr;
+}
+
+//-----------------------------------------------------------------------------
+// Memory mapped files
+//-----------------------------------------------------------------------------
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+// without NOMINMAX, windows.h defines min and max macros that break std::min
+// and std::max in the C++ part of this file
+#ifndef NOMINMAX
+#define NOMINMAX
+#define TS_DEFINED_NOMINMAX
+#endif
+#include <windows.h>
+#ifdef TS_DEFINED_NOMINMAX
+#undef NOMINMAX
+#undef TS_DEFINED_NOMINMAX
+#endif
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static char const ts_EmptyFile[1] = { 0 };
+
+#if !defined(_WIN32)
+// Hints are advisory, so a failure is ignored. Strict ISO modes hide
+// madvise, and the hints are then skipped.
+static void ts_AdviseMapping(void* data, size_t size, unsigned flags)
+{
+#if defined(MADV_SEQUENTIAL)
+    if (flags & tsMapRandom)
+        madvise(data, size, MADV_RANDOM);
+    else {
+        madvise(data, size, MADV_SEQUENTIAL);
+        madvise(data, size, MADV_WILLNEED);
+    }
+#if defined(MADV_HUGEPAGE)
+    if (flags & tsMapHugePages)
+        madvise(data, size, MADV_HUGEPAGE);
+#endif
+#elif defined(POSIX_MADV_SEQUENTIAL)
+    if (flags & tsMapRandom)
+        posix_madvise(data, size, POSIX_MADV_RANDOM);
+    else {
+        posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+        posix_madvise(data, size, POSIX_MADV_WILLNEED);
+    }
+#else
+    (void) data; (void) size; (void) flags;
+#endif
+}
+#endif
+
+_Bool tsMappedFile_Open(tsMappedFile_t* file, char const* path, unsigned flags)
+{
+    file->data = NULL;
+    file->size = 0;
+    if (!path)
+        return false;
+
+#if defined(_WIN32)
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                (flags & tsMapRandom) ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || (uint64_t) size.QuadPart > (uint64_t) SIZE_MAX) {
+        CloseHandle(handle);
+        return false;
+    }
+    if (size.QuadPart == 0) {
+        CloseHandle(handle);
+        file->data = ts_EmptyFile;
+        return true;
+    }
+    // the view keeps the mapping, and the mapping the file, open
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if (!mapping)
+        return false;
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data)
+        return false;
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+    if (!(flags & tsMapRandom)) {
+        WIN32_MEMORY_RANGE_ENTRY range = { data, (SIZE_T) size.QuadPart };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#endif
+    file->data = (char const*) data;
+    file->size = (size_t) size.QuadPart;
+    return true;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 0 || (uint64_t) st.st_size > (uint64_t) SIZE_MAX) {
+        close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        file->data = ts_EmptyFile;
+        return true;
+    }
+    size_t size = (size_t) st.st_size;
+    // the mapping keeps the file open
+    void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    ts_AdviseMapping(data, size, flags);
+    file->data = (char const*) data;
+    file->size = size;
+    return true;
+#endif
+}
+
+void tsMappedFile_Close(tsMappedFile_t* file)
+{
+    if (file->data && file->data != ts_EmptyFile) {
+#if defined(_WIN32)
+        UnmapViewOfFile(file->data);
+#else
+        munmap((void*) file->data, file->size);
+#endif
+    }
+    file->data = NULL;
+    file->size = 0;
+}
+
+tsStrView_t tsMappedFile_View(tsMappedFile_t const* file)
+{
+    tsStrView_t view = { file->data, file->size };
+    return view;
+}
+
+#ifdef __cplusplus
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#if defined(__has_include)
+#if __has_include(<charconv>) && __cplusplus >= 201703L
+#include <charconv>
+#endif
+#endif
+#if defined(_WIN32)
+#include <io.h>
+#endif
+
+namespace lab { namespace Text {
+std::vector<StrView> Split(StrView s, char splitter)
+{
+    std::vector<StrView> result;
+    char const* src = s.curr;
+    char const* curr = src;
+    size_t remaining = s.sz;
+    size_t sz = 0;
+    while (remaining > 0)
+    {
+        if (*src != splitter)
+        {
+            ++sz;
+            ++src;
+        }
+        else
+        {
+            result.push_back(StrView{curr, sz});
+            sz = 0;
+            ++src;
+            curr = src;
+        }
+        --remaining;
+    }
+
+    // capture last crumb
+    if (sz > 0)
+        result.push_back(StrView{curr, sz});
+
+    return result;
+}
+
+// Appends the start of every line that begins in [begin, end). begin must not
+// sit on the second half of a two character line break.
+static void ts_IndexLineStarts(char const* base, char const* begin, char const* end, std::vector<size_t>& starts)
+{
+    tsSimdKernels_t const* simd = ts_Simd();
+    char const* consumed = nullptr;   // second half of the last \r\n or \n\r
+    auto lineBreak = [&](char const* p) {
+        if (p == consumed)
+            return;
+        char const* next = p + 1;
+        if (next < end && (*next == '\r' || *next == '\n') && *next != *p)
+            consumed = next++;
+        starts.push_back(static_cast<size_t>(next - base));
+    };
+
+    char const* p = begin;
+    for (; end - p >= 64; p += 64) {
+        for (uint64_t m = simd->lineBreakMask64(p); m; m &= m - 1)
+            lineBreak(p + ts_Ctz64(m));
+    }
+    for (; p < end; ++p)
+        if (*p == '\r' || *p == '\n')
+            lineBreak(p);
+}
+
+void LineIndex::BuildIndex() const
+{
+    built = true;
+    starts.clear();
+    starts.push_back(0);
+
+    char const* begin = source.curr;
+    char const* end = source.curr + source.sz;
+    if (!source.sz)
+        return;
+
+    unsigned n = threads;
+    if (!n)
+        n = source.sz >= (size_t(1) << 30) ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+    if (n == 1) {
+        ts_IndexLineStarts(begin, begin, end, starts);
+        return;
+    }
+
+    // Split into n chunks, moving each split forward until it follows an
+    // ordinary character so that no line break straddles two chunks.
+    std::vector<char const*> splits;
+    splits.push_back(begin);
+    for (unsigned i = 1; i < n; ++i) {
+        char const* split = begin + source.sz / n * i;
+        split = std::max(split, splits.back());
+        while (split < end && (split[-1] == '\r' || split[-1] == '\n'))
+            ++split;
+        splits.push_back(split);
+    }
+    splits.push_back(end);
+
+    std::vector<std::vector<size_t>> chunks(n);
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < n; ++i)
+        workers.emplace_back([&, i]() {
+            ts_IndexLineStarts(begin, splits[i], splits[i + 1], chunks[i]);
+        });
+    for (auto& w : workers)
+        w.join();
+
+    size_t total = starts.size();
+    for (auto& c : chunks)
+        total += c.size();
+    starts.reserve(total);
+    for (auto& c : chunks)
+        starts.insert(starts.end(), c.begin(), c.end());
+}
+
+void SexprStreamParser::Emit(StrView form)
+{
+    Sexpr sexpr(form, options);
+    onForm(sexpr);
+}
+
+tsSexprStatus_t SexprStreamParser::Fail(tsSexprStatus_t error, size_t offset)
+{
+    status = error;
+    errorOffset = offset;
+    pending.clear();
+    return status;
+}
+
+tsSexprStatus_t SexprStreamParser::Feed(StrView chunk)
+{
+    if (status != tsSexprOk)
+        return status;
+
+    char const* c = chunk.curr;
+    char const* end = chunk.curr + chunk.sz;
+
+    struct Forms {
+        SexprStreamParser& parser;
+        char const* chunkBegin;
+        char const* formBegin;      // the part of the open form in this chunk
+
+        bool OnParen(char const* p) {
+            if (*p == '(') {
+                if (parser.depth == 0)
+                    formBegin = p;
+                int maxDepth = parser.options.maxDepth;
+                if (maxDepth > 0 && parser.depth >= maxDepth)
+                    return Stop(tsSexprErrorDepth, p);
+                ++parser.depth;
+                return true;
+            }
+            if (parser.depth == 0)
+                return Stop(tsSexprErrorSyntax, p);
+            if (--parser.depth == 0) {
+                if (parser.pending.empty())
+                    parser.Emit(StrView(formBegin, p + 1 - formBegin));
+                else {
+                    parser.pending.append(formBegin, p + 1);
+                    parser.Emit(StrView(parser.pending));
+                    parser.pending.clear();
+                }
+                formBegin = nullptr;
+            }
+            return true;
+        }
+        bool OnToken(char const* p) {
+            // only lists may appear at the top level
+            return parser.depth > 0 || Stop(tsSexprErrorSyntax, p);
+        }
+        bool Stop(tsSexprStatus_t error, char const* p) {
+            parser.Fail(error, parser.bytesFed + (p - chunkBegin));
+            return false;
+        }
+    };
+
+    Forms forms{ *this, c, depth > 0 ? c : nullptr };
+    scanner.Scan(c, end, forms);
+    if (status != tsSexprOk)
+        return status;
+
+    if (forms.formBegin)
+        pending.append(forms.formBegin, end);
+    bytesFed += chunk.sz;
+    return status;
+}
+
+tsSexprStatus_t SexprStreamParser::Finish()
+{
+    if (status != tsSexprOk)
+        return status;
+    if (pending.empty())
+        return status;
+
+    size_t offset = bytesFed - pending.size();
+    Emit(StrView(pending));
+    return Fail(tsSexprErrorUnterminated, offset);
+}
+
+// smaller documents are parsed serially, and no piece is smaller than this
+static constexpr size_t ts_SexprParallelMinBytes = 1 << 20;
+
+void Sexpr::ParseParallel(StrView s, SexprOptions const& options)
+{
+    unsigned threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+    if (threads < 2 || s.sz < ts_SexprParallelMinBytes) {
+        ParseSerial(s, options);
+        return;
+    }
+
+    // Cut before a ( that opens a list with none open and no unmatched ) to
+    // answer; the serial parse sees the same tokens there, at balance 0. The
+    // structural index finds the parens a block at a time, so this pass is
+    // short next to the parse. Several pieces per thread keep the threads
+    // busy to the end.
+    std::vector<char const*> cuts(1, s.curr);
+    size_t target = std::max(s.sz / (threads * 4), ts_SexprParallelMinBytes / 4);
+    tsSexprIndexer_t indexer;
+    tsSexprIndexer_Init(&indexer);
+    uint32_t offsets[1024];
+    int open = 0, depth = 0;
+    char const* end = s.curr + s.sz;
+    for (char const* p = s.curr; p < end; ) {
+        size_t count;
+        size_t used = tsSexprIndexStructure(&indexer, p, end, offsets, sizeof(offsets) / sizeof(offsets[0]), &count);
+        for (size_t i = 0; i < count; ++i) {
+            char const* t = p + offsets[i];
+            if (*t == '(') {
+                if (!open && !depth && static_cast<size_t>(t - cuts.back()) >= target)
+                    cuts.push_back(t);
+                ++open;
+                ++depth;
+            }
+            else if (*t == ')') {
+                --depth;
+                if (open)
+                    --open;
+            }
+        }
+        p += used;
+    }
+
+    size_t n = cuts.size();
+    if (n < 2) {
+        ParseSerial(s, options);
+        return;
+    }
+    cuts.push_back(s.curr + s.sz);
+
+    // each piece interns into a table of its own, merged in document order below
+    std::vector<std::unique_ptr<Sexpr>> parts(n);
+    std::vector<std::unique_ptr<SymbolTable>> tables(n);
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t i; (i = next++) < n; ) {
+            SexprOptions o = options;
+            o.threads = 1;
+            o.lazyNumbers = lazyNumbers;
+            if (options.symbols) {
+                tables[i].reset(new SymbolTable());
+                o.symbols = tables[i].get();
+            }
+            parts[i].reset(new Sexpr(StrView(cuts[i], cuts[i + 1] - cuts[i]), o));
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < std::min<size_t>(threads, n); ++t)
+        pool.emplace_back(work);
+    work();
+    for (auto& t : pool)
+        t.join();
+
+    // a piece that fails ends the document, as the serial parse stops there
+    size_t used = 0, exprCount = 0, listCount = 0, intCount = 0, floatCount = 0, stringCount = 0, unescapedSize = 0;
+    while (used < n) {
+        Sexpr const& part = *parts[used++];
+        exprCount += part.expr.size();
+        listCount += part.lists.size();
+        intCount += lazyNumbers ? part.intSpans.size() : part.ints.size();
+        floatCount += lazyNumbers ? part.floatSpans.size() : part.floats.size();
+        stringCount += zeroCopy ? part.views.size() : part.strings.size();
+        unescapedSize += part.unescaped ? part.unescaped->size() : 0;
+        if (part.status != tsSexprOk)
+            break;
+    }
+    expr.reserve(exprCount);
+    lists.reserve(listCount);
+    if (lazyNumbers) {
+        intSpans.reserve(intCount);
+        floatSpans.reserve(floatCount);
+    }
+    else {
+        ints.reserve(intCount);
+        floats.reserve(floatCount);
+    }
+    if (zeroCopy)
+        views.reserve(stringCount);
+    else
+        strings.reserve(stringCount);
+    if (unescapedSize) {
+        unescaped = std::make_shared<std::string>();
+        unescaped->reserve(unescapedSize);
+    }
+
+    for (size_t i = 0; i < used; ++i) {
+        Sexpr& part = *parts[i];
+        size_t unescapedBase = unescaped ? unescaped->size() : 0;
+        if (part.unescaped)
+            unescaped->append(*part.unescaped);
+        if (!Append(part, tables[i].get(), part.unescaped.get(), unescapedBase)) {
+            // the refs of this piece would pass MaxRef; the document ends where it begins
+            status = tsSexprErrorMemory;
+            errorOffset = static_cast<size_t>(cuts[i] - s.curr);
+            break;
+        }
+        if (part.status != tsSexprOk) {
+            status = part.status;
+            errorOffset = part.errorOffset + static_cast<size_t>(cuts[i] - s.curr);
+        }
+        parts[i].reset();
+    }
+}
+
+// Appends a piece parsed on its own, rebasing its refs past what is here.
+// False, with nothing appended, if a rebased ref would pass MaxRef.
+bool Sexpr::Append(Sexpr& part, SymbolTable const* partSymbols, std::string const* partUnescaped,
+                   size_t unescapedBase)
+{
+    size_t limit = static_cast<size_t>(MaxRef) + 1;
+    if (lists.size() + part.lists.size() > limit
+        || (lazyNumbers ? intSpans.size() + part.intSpans.size() : ints.size() + part.ints.size()) > limit
+        || (lazyNumbers ? floatSpans.size() + part.floatSpans.size() : floats.size() + part.floats.size()) > limit
+        || (zeroCopy ? views.size() + part.views.size() : strings.size() + part.strings.size()) > limit)
+        return false;
+
+    int exprBase = static_cast<int>(expr.size());
+    int listBase = static_cast<int>(lists.size());
+    int intBase = static_cast<int>(lazyNumbers ? intSpans.size() : ints.size());
+    int floatBase = static_cast<int>(lazyNumbers ? floatSpans.size() : floats.size());
+    int stringBase = static_cast<int>(zeroCopy ? views.size() : strings.size());
+
+    std::vector<uint32_t> symbolIds;
+    if (partSymbols) {
+        symbolIds.reserve(partSymbols->Size());
+        for (uint32_t id = 0; id < partSymbols->Size(); ++id)
+            symbolIds.push_back(symbols->Intern(partSymbols->Name(id)));
+        if (symbols->Size() > limit)
+            return false;
+    }
+
+    for (Elem e : part.expr) {
+        switch (e.token) {
+        case tsSexprPushList: e.ref += listBase; break;
+        case tsSexprPopList: if (e.ref >= 0) e.ref += listBase; break;
+        case tsSexprInteger: e.ref += intBase; break;
+        case tsSexprFloat: e.ref += floatBase; break;
+        case tsSexprString: e.ref += stringBase; break;
+        case tsSexprAtom: e.ref = partSymbols ? static_cast<int>(symbolIds[e.ref]) : e.ref + stringBase; break;
+        }
+        expr.push_back(e);
+    }
+    for (List l : part.lists) {
+        l.begin += exprBase;
+        l.end += exprBase;
+        lists.push_back(l);
+    }
+    ints.insert(ints.end(), part.ints.begin(), part.ints.end());
+    floats.insert(floats.end(), part.floats.begin(), part.floats.end());
+    uint32_t sourceBase = static_cast<uint32_t>(part.source - source);
+    for (NumberSpan n : part.intSpans)
+        intSpans.push_back({ n.offset + sourceBase, n.size });
+    for (NumberSpan n : part.floatSpans)
+        floatSpans.push_back({ n.offset + sourceBase, n.size });
+    if (zeroCopy) {
+        for (StrView v : part.views) {
+            // unescaped strings move to this Sexpr's buffer
+            if (partUnescaped && v.curr >= partUnescaped->data() && v.curr < partUnescaped->data() + partUnescaped->size())
+                v.curr = unescaped->data() + unescapedBase + (v.curr - partUnescaped->data());
+            views.push_back(v);
+        }
+    }
+    else
+        strings.insert(strings.end(), std::make_move_iterator(part.strings.begin()), std::make_move_iterator(part.strings.end()));
+    balance += part.balance;
+    return true;
+}
+
+void Sexpr::DecodeNumber(tsSexprToken_t token, int ref) const
+{
+    // values are stored from the first read on
+    if (ints.size() < intSpans.size())
+        ints.resize(intSpans.size());
+    if (floats.size() < floatSpans.size())
+        floats.resize(floatSpans.size());
+
+    NumberSpan& span = token == tsSexprInteger ? intSpans[ref] : floatSpans[ref];
+    char const* text = source + span.offset;
+    tsSexprToken_t kind;
+    int64_t i = 0;
+    double f = 0;
+    tsSexprGetNumber(text, text + span.size, &kind, &i, &f);
+    if (token == tsSexprInteger)
+        ints[ref] = i;
+    else
+        floats[ref] = f;
+    span.size = 0;
+}
+
+// fewer numbers than this per thread are decoded on fewer threads
+static constexpr size_t ts_SexprDecodeMinNumbers = 1 << 16;
+
+void Sexpr::DecodeAllNumbers(unsigned threads) const
+{
+    if (intSpans.empty() && floatSpans.empty())
+        return;
+    ints.resize(intSpans.size());
+    floats.resize(floatSpans.size());
+    if (!threads)
+        threads = std::thread::hardware_concurrency();
+    size_t count = intSpans.size() + floatSpans.size();
+    size_t n = std::min<size_t>(std::max(1u, threads), count / ts_SexprDecodeMinNumbers + 1);
+
+    // each thread decodes a slice of each table
+    auto work = [this, n](size_t slice) {
+        for (size_t r = intSpans.size() * slice / n, end = intSpans.size() * (slice + 1) / n; r < end; ++r)
+            if (intSpans[r].size)
+                DecodeNumber(tsSexprInteger, static_cast<int>(r));
+        for (size_t r = floatSpans.size() * slice / n, end = floatSpans.size() * (slice + 1) / n; r < end; ++r)
+            if (floatSpans[r].size)
+                DecodeNumber(tsSexprFloat, static_cast<int>(r));
+    };
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < n; ++t)
+        pool.emplace_back(work, t);
+    work(0);
+    for (auto& t : pool)
+        t.join();
+    std::vector<NumberSpan>().swap(intSpans);
+    std::vector<NumberSpan>().swap(floatSpans);
+}
+
+LineIndex::Location LineIndex::Find(size_t offset) const
+{
+    Build();
+    auto it = std::upper_bound(starts.begin(), starts.end(), offset);
+    size_t line = static_cast<size_t>(it - starts.begin()) - 1;
+    return Location{ line, offset - starts[line] };
+}
+
+StrView LineIndex::Line(size_t line) const
+{
+    Build();
+    size_t b = starts[line];
+    size_t e = line + 1 < starts.size() ? starts[line + 1] : source.sz;
+    // line text never contains \r or \n, so everything trailing is the break
+    while (e > b && (source.curr[e - 1] == '\r' || source.curr[e - 1] == '\n'))
+        --e;
+    return StrView(source.curr + b, e - b);
+}
+
+constexpr uint32_t SymbolTable::NoSymbol;
+constexpr uint32_t KeywordIndex::NoEntry;
+
+// names are copied into blocks of this size, long names into blocks of their own
+static constexpr size_t ts_SymbolBlockSize = 64 * 1024;
+
+SymbolTable::SymbolTable(size_t expected)
+{
+    size_t slotCount = 64;
+    while (slotCount < expected * 2)
+        slotCount *= 2;
+    slots.assign(slotCount, 0);
+    names.reserve(expected);
+    hashes.reserve(expected);
+}
+
+// Mixes eight bytes at a time with a multiply and fold; names are short, so
+// the tail and the length are folded into the last word.
+uint64_t SymbolTable::Hash(StrView name)
+{
+    const uint64_t k = 0x9e3779b97f4a7c15ull;
+    uint64_t h = name.sz * k;
+    char const* p = name.curr;
+    size_t n = name.sz;
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = (h ^ w) * k;
+        h ^= h >> 29;
+    }
+    uint64_t w = 0;
+    memcpy(&w, p, n);
+    h = (h ^ w) * k;
+    h ^= h >> 32;
+    h *= 0xd6e8feb86659fd93ull;
+    h ^= h >> 32;
+    return h;
+}
+
+uint32_t SymbolTable::Probe(StrView name, uint64_t hash, size_t& slot) const
+{
+    size_t mask = slots.size() - 1;
+    for (slot = hash & mask; slots[slot]; slot = (slot + 1) & mask) {
+        uint32_t id = slots[slot] - 1;
+        if (hashes[id] == hash && names[id].sz == name.sz && !memcmp(names[id].curr, name.curr, name.sz))
+            return id;
+    }
+    return NoSymbol;
+}
+
+uint32_t SymbolTable::Find(StrView name) const
+{
+    size_t slot;
+    return Probe(name, Hash(name), slot);
+}
+
+uint32_t SymbolTable::Intern(StrView name)
+{
+    uint64_t hash = Hash(name);
+    size_t slot;
+    uint32_t id = Probe(name, hash, slot);
+    if (id != NoSymbol)
+        return id;
+
+    // keep the table at most half full
+    if ((names.size() + 1) * 2 > slots.size()) {
+        Rehash(slots.size() * 2);
+        Probe(name, hash, slot);
+    }
+    id = static_cast<uint32_t>(names.size());
+    names.push_back(StrView(Store(name), name.sz));
+    hashes.push_back(hash);
+    slots[slot] = id + 1;
+    return id;
+}
+
+void SymbolTable::Rehash(size_t slotCount)
+{
+    slots.assign(slotCount, 0);
+    size_t mask = slotCount - 1;
+    for (uint32_t id = 0; id < names.size(); ++id) {
+        size_t slot = hashes[id] & mask;
+        while (slots[slot])
+            slot = (slot + 1) & mask;
+        slots[slot] = id + 1;
+    }
+}
+
+KeywordIndex::KeywordIndex(Sexpr const& sexpr, SymbolTable& symbols)
+: symbols(symbols)
+{
+    // a document with symbols carries their ids, which only its table can look up
+    Assert(!sexpr.symbols || sexpr.symbols == &symbols);
+
+    // every list's children are visited once, stepping over nested lists
+    size_t size = sexpr.expr.size();
+    for (Sexpr::List const& list : sexpr.lists) {
+        uint32_t open = NoEntry;    // the keyword whose values are being read
+        size_t c = list.begin + 1;
+        for (; c < list.end; c = sexpr.Next(c)) {
+            Sexpr::Elem const& e = sexpr.expr[c];
+            if (e.token != tsSexprAtom)
+                continue;
+            StrView name = sexpr.Text(e);
+            if (name.sz < 2 || name.curr[0] != ':')
+                continue;
+            if (open != NoEntry)
+                entries[open].end = static_cast<uint32_t>(c);
+            uint32_t symbol = sexpr.symbols ? static_cast<uint32_t>(e.ref) : symbols.Intern(name);
+            open = static_cast<uint32_t>(entries.size());
+            entries.push_back({ Key(list.begin, symbol), static_cast<uint32_t>(c + 1), 0, NoEntry });
+        }
+        if (open != NoEntry)
+            entries[open].end = static_cast<uint32_t>(std::min(c, size));
+    }
+
+    size_t slotCount = 64;
+    while (slotCount < entries.size() * 2)
+        slotCount *= 2;
+    slots.assign(slotCount, 0);
+    for (uint32_t i = 0; i < entries.size(); ++i)
+        Insert(i);
+}
+
+void KeywordIndex::Insert(uint32_t entry)
+{
+    uint64_t key = entries[entry].key;
+    size_t mask = slots.size() - 1;
+    for (size_t slot = Slot(key, mask); ; slot = (slot + 1) & mask) {
+        if (!slots[slot]) {
+            slots[slot] = entry + 1;
+            return;
+        }
+        uint32_t e = slots[slot] - 1;
+        if (entries[e].key == key) {
+            // entries are inserted in document order, so repeats chain at the end
+            while (entries[e].next != NoEntry)
+                e = entries[e].next;
+            entries[e].next = entry;
+            return;
+        }
+    }
+}
+
+KeywordIndex::Span KeywordIndex::SpanOf(uint32_t entry) const
+{
+    Span span;
+    if (entry != NoEntry) {
+        span.begin = entries[entry].begin;
+        span.end = entries[entry].end;
+        span.entry = entry;
+    }
+    return span;
+}
+
+KeywordIndex::Span KeywordIndex::Find(size_t list, uint32_t symbol) const
+{
+    uint64_t key = Key(list, symbol);
+    size_t mask = slots.size() - 1;
+    for (size_t slot = Slot(key, mask); slots[slot]; slot = (slot + 1) & mask) {
+        uint32_t e = slots[slot] - 1;
+        if (entries[e].key == key)
+            return SpanOf(e);
+    }
+    return Span();
+}
+
+KeywordIndex::Span KeywordIndex::Find(size_t list, StrView keyword) const
+{
+    uint32_t symbol = symbols.Find(keyword);
+    return symbol == SymbolTable::NoSymbol ? Span() : Find(list, symbol);
+}
+
+KeywordIndex::Span KeywordIndex::Next(Span const& span) const
+{
+    return span.Found() ? SpanOf(entries[span.entry].next) : Span();
+}
+
+// A Sexpr image is a header followed by its sections, each aligned to 8
+// bytes. Offsets are from the start of the image, so it can be mapped
+// anywhere. probe is an Elem as the writer laid it out, which catches a
+// change of byte order or bit field layout.
+static constexpr char ts_SexprImageMagic[8] = { 'L', 'a', 'b', 'S', 'e', 'x', 'p', 'r' };
+static constexpr uint32_t ts_SexprImageVersion = 3;    // 2: floats are doubles, 3: ints are 64 bit
+
+enum tsSexprImageSection_t {
+    tsSexprImageExpr, tsSexprImageLists, tsSexprImageInts, tsSexprImageFloats,
+    tsSexprImageStringOffsets, tsSexprImageStringBytes,
+    tsSexprImageSymbolOffsets, tsSexprImageSymbolBytes,
+    tsSexprImageSectionCount
+};
+
+struct tsSexprImageHeader_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t probe;
+    uint64_t size;              // of the whole image
+    uint64_t sourceHash;
+    uint64_t errorOffset;
+    int32_t status;
+    int32_t balance;
+    struct { uint64_t offset, count; } sections[tsSexprImageSectionCount];
+};
+
+static uint32_t ts_SexprImageProbe()
+{
+    Sexpr::Elem e;
+    e.token = tsSexprString;
+    e.ref = -2;
+    uint32_t probe;
+    memcpy(&probe, &e, sizeof(probe));
+    return probe;
+}
+
+static size_t ts_SexprImageSectionWidth(int section)
+{
+    switch (section) {
+    case tsSexprImageExpr: return sizeof(Sexpr::Elem);
+    case tsSexprImageLists: return sizeof(Sexpr::List);
+    case tsSexprImageInts: return sizeof(int64_t);
+    case tsSexprImageFloats: return sizeof(double);
+    case tsSexprImageStringBytes:
+    case tsSexprImageSymbolBytes: return 1;
+    default: return sizeof(uint64_t);
+    }
+}
+
+uint64_t SexprImage::HashSource(StrView source)
+{
+    return SymbolTable::Hash(source);
+}
+
+void Sexpr::WriteImage(std::string& image, StrView source) const
+{
+    static_assert(sizeof(Elem) == 4, "Sexpr::Elem is expected to pack into 32 bits");
+    DecodeAllNumbers();
+
+    size_t stringCount = zeroCopy ? views.size() : strings.size();
+    size_t symbolCount = symbols ? symbols->Size() : 0;
+    std::vector<uint64_t> stringOffsets(stringCount + 1, 0);
+    for (size_t i = 0; i < stringCount; ++i)
+        stringOffsets[i + 1] = stringOffsets[i] + String(static_cast<int>(i)).sz;
+    std::vector<uint64_t> symbolOffsets(symbols ? symbolCount + 1 : 0, 0);
+    for (size_t i = 0; i < symbolCount; ++i)
+        symbolOffsets[i + 1] = symbolOffsets[i] + symbols->Name(static_cast<uint32_t>(i)).sz;
+
+    tsSexprImageHeader_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ts_SexprImageMagic, sizeof(header.magic));
+    header.version = ts_SexprImageVersion;
+    header.probe = ts_SexprImageProbe();
+    header.sourceHash = SexprImage::HashSource(source);
+    header.errorOffset = errorOffset;
+    header.status = status;
+    header.balance = balance;
+
+    size_t counts[tsSexprImageSectionCount] = {
+        expr.size(), lists.size(), ints.size(), floats.size(),
+        stringOffsets.size(), stringOffsets.back(),
+        symbolOffsets.size(), symbolOffsets.empty() ? 0 : symbolOffsets.back()
+    };
+    uint64_t offset = (sizeof(header) + 7) & ~uint64_t(7);
+    for (int i = 0; i < tsSexprImageSectionCount; ++i) {
+        header.sections[i].offset = offset;
+        header.sections[i].count = counts[i];
+        offset += (counts[i] * ts_SexprImageSectionWidth(i) + 7) & ~uint64_t(7);
+    }
+    header.size = offset;
+
+    // sections are written in order, each padded out to the next one
+    size_t base = image.size();
+    image.reserve(base + static_cast<size_t>(offset));
+    auto put = [&](int section, void const* data, size_t bytes) {
+        image.resize(base + static_cast<size_t>(header.sections[section].offset), '\0');
+        image.append(static_cast<char const*>(data), bytes);
+    };
+    image.append(reinterpret_cast<char const*>(&header), sizeof(header));
+    put(tsSexprImageExpr, expr.data(), expr.size() * sizeof(Elem));
+    put(tsSexprImageLists, lists.data(), lists.size() * sizeof(List));
+    put(tsSexprImageInts, ints.data(), ints.size() * sizeof(int64_t));
+    put(tsSexprImageFloats, floats.data(), floats.size() * sizeof(double));
+    put(tsSexprImageStringOffsets, stringOffsets.data(), stringOffsets.size() * sizeof(uint64_t));
+    put(tsSexprImageStringBytes, nullptr, 0);
+    for (size_t i = 0; i < stringCount; ++i) {
+        StrView str = String(static_cast<int>(i));
+        image.append(str.curr, str.sz);
+    }
+    put(tsSexprImageSymbolOffsets, symbolOffsets.data(), symbolOffsets.size() * sizeof(uint64_t));
+    put(tsSexprImageSymbolBytes, nullptr, 0);
+    for (size_t i = 0; i < symbolCount; ++i) {
+        StrView name = symbols->Name(static_cast<uint32_t>(i));
+        image.append(name.curr, name.sz);
+    }
+    image.resize(base + static_cast<size_t>(offset), '\0');
+}
+
+SexprImage::SexprImage(void const* image, size_t size)
+{
+    tsSexprImageHeader_t const* header = static_cast<tsSexprImageHeader_t const*>(image);
+    if (!image || size < sizeof(*header) || (reinterpret_cast<uintptr_t>(image) & 7) ||
+        memcmp(header->magic, ts_SexprImageMagic, sizeof(header->magic)) ||
+        header->version != ts_SexprImageVersion || header->probe != ts_SexprImageProbe() ||
+        header->size > size)
+        return;
+
+    for (int i = 0; i < tsSexprImageSectionCount; ++i) {
+        uint64_t offset = header->sections[i].offset;
+        uint64_t count = header->sections[i].count;
+        if ((offset & 7) || offset > header->size ||
+            count > (header->size - offset) / ts_SexprImageSectionWidth(i))
+            return;
+    }
+    char const* base = static_cast<char const*>(image);
+    auto section = [&](int i, auto& table) {
+        using T = typename std::remove_reference<decltype(table[0])>::type;
+        table.data = reinterpret_cast<T const*>(base + header->sections[i].offset);
+        table.count = static_cast<size_t>(header->sections[i].count);
+    };
+    section(tsSexprImageExpr, expr);
+    section(tsSexprImageLists, lists);
+    section(tsSexprImageInts, ints);
+    section(tsSexprImageFloats, floats);
+    section(tsSexprImageStringOffsets, stringOffsets);
+    section(tsSexprImageSymbolOffsets, symbolOffsets);
+    stringBytes = base + header->sections[tsSexprImageStringBytes].offset;
+    symbolBytes = base + header->sections[tsSexprImageSymbolBytes].offset;
+    if (stringOffsets.empty() ||
+        stringOffsets[stringOffsets.size() - 1] != header->sections[tsSexprImageStringBytes].count ||
+        (HasSymbols() && symbolOffsets[symbolOffsets.size() - 1] != header->sections[tsSexprImageSymbolBytes].count) ||
+        !CheckTables())
+        return;
+
+    balance = header->balance;
+    status = static_cast<tsSexprStatus_t>(header->status);
+    errorOffset = static_cast<size_t>(header->errorOffset);
+    sourceHash = header->sourceHash;
+    valid = true;
+}
+
+static bool ts_OffsetsGrow(SexprImage::Table<uint64_t> const& offsets)
+{
+    if (offsets.empty())
+        return true;
+    if (offsets[0] != 0)
+        return false;
+    for (size_t i = 1; i < offsets.size(); ++i)
+        if (offsets[i] < offsets[i - 1])
+            return false;
+    return true;
+}
+
+// Replays the parens as the Builder saw them: lists are numbered in the
+// order they open, each ) closes the innermost open list, and the lists
+// still open end with the document.
+bool SexprImage::CheckTables() const
+{
+    if (!ts_OffsetsGrow(stringOffsets) || !ts_OffsetsGrow(symbolOffsets))
+        return false;
+    size_t stringCount = stringOffsets.size() - 1;
+    size_t atomCount = HasSymbols() ? SymbolCount() : stringCount;
+
+    struct Open {
+        uint32_t list;
+        uint32_t children;
+    };
+    std::vector<Open> open;
+    size_t opened = 0;
+    for (size_t i = 0; i < expr.size(); ++i) {
+        Elem e = expr[i];
+        if (e.token == tsSexprPopList) {
+            if (open.empty()) {
+                if (e.ref != -1)
+                    return false;
+                continue;
+            }
+            Open o = open.back();
+            List const& l = lists[o.list];
+            if (e.ref < 0 || static_cast<uint32_t>(e.ref) != o.list || l.end != i || l.count != o.children)
+                return false;
+            open.pop_back();
+            continue;
+        }
+        if (!open.empty())
+            ++open.back().children;
+        size_t ref = static_cast<size_t>(e.ref);
+        switch (e.token) {
+        case tsSexprPushList:
+            if (e.ref < 0 || ref != opened || ref >= lists.size() || lists[ref].begin != i || lists[ref].end <= i)
+                return false;
+            open.push_back({ static_cast<uint32_t>(opened++), 0 });
+            break;
+        case tsSexprInteger: if (e.ref < 0 || ref >= ints.size()) return false; break;
+        case tsSexprFloat: if (e.ref < 0 || ref >= floats.size()) return false; break;
+        case tsSexprString: if (e.ref < 0 || ref >= stringCount) return false; break;
+        case tsSexprAtom: if (e.ref < 0 || ref >= atomCount) return false; break;
+        default: return false;
+        }
+    }
+    for (Open const& o : open)
+        if (lists[o.list].end != expr.size() || lists[o.list].count != o.children)
+            return false;
+    return opened == lists.size();
+}
+
+//------------------------------------------------------------------------------
+// SexprQuery
+//------------------------------------------------------------------------------
+
+static bool ts_IsKeyword(StrView name)
+{
+    return name.sz > 1 && name.curr[0] == ':';
+}
+
+SexprQuery::Name SexprQuery::Compile(StrView text)
+{
+    Name name;
+    name.text.assign(text.curr, text.sz);
+    name.any = text.sz == 1 && text.curr[0] == '*';
+    if (symbols && !name.any)
+        name.symbol = symbols->Intern(text);
+    return name;
+}
+
+SexprQuery::SexprQuery(StrView query, SymbolTable* symbols)
+: symbols(symbols)
+{
+    std::string text = "(";
+    text.append(query.curr, query.sz);
+    text += "\n)";    // a trailing comment is closed by the newline
+    Sexpr q(text);
+    if (q.status != tsSexprOk || q.balance != 0 || q.lists.empty() || q.expr[0].token != tsSexprPushList)
+        return;
+
+    size_t end = q.Match(0);
+    if (end != q.expr.size() - 1)
+        return;
+    for (size_t i = 1; i < end; i = q.Next(i)) {
+        Sexpr::Elem const& e = q.expr[i];
+        if (e.token == tsSexprAtom && ts_IsKeyword(q.Text(e)) && q.Next(i) == end && !steps.empty()) {
+            select = Compile(q.Text(e));
+            selects = true;
+            break;
+        }
+        if (e.token != tsSexprPushList || q.ChildCount(i) == 0)
+            return;
+
+        Step step;
+        size_t stepEnd = q.Match(i);
+        size_t c = i + 1;
+        if (q.expr[c].token != tsSexprAtom)
+            return;
+        step.head = Compile(q.Text(q.expr[c]));
+        for (c = q.Next(c); c < stepEnd; c = q.Next(q.Next(c))) {
+            Sexpr::Elem const& key = q.expr[c];
+            size_t v = q.Next(c);
+            if (key.token != tsSexprAtom || !ts_IsKeyword(q.Text(key)) || v >= stepEnd)
+                return;
+            Constraint constraint;
+            constraint.key = Compile(q.Text(key));
+            Sexpr::Elem const& value = q.expr[v];
+            constraint.value.token = static_cast<tsSexprToken_t>(value.token);
+            switch (value.token) {
+            case tsSexprAtom: constraint.value.name = Compile(q.Text(value)); break;
+            case tsSexprString: {
+                StrView str = q.String(value.ref);
+                constraint.value.name.text.assign(str.curr, str.sz);
+                break;
+            }
+            case tsSexprInteger:
+                constraint.value.integer = q.Int(value.ref);
+                constraint.value.number = static_cast<double>(constraint.value.integer);
+                break;
+            case tsSexprFloat: constraint.value.number = q.Float(value.ref); break;
+            default: return;    // a list is not a value
+            }
+            step.where.push_back(std::move(constraint));
+        }
+        if (step.where.size() > 64)
+            return;     // Matches ticks the constraints off in one 64 bit word
+        steps.push_back(std::move(step));
+    }
+    valid = !steps.empty();
+}
+
+bool SexprQuery::Is(Sexpr const& sexpr, Sexpr::Elem const& e, Name const& name) const
+{
+    if (e.token != tsSexprAtom)
+        return false;
+    if (name.any)
+        return true;
+    if (symbols && sexpr.symbols == symbols)
+        return static_cast<uint32_t>(e.ref) == name.symbol;
+    StrView text = sexpr.Text(e);
+    return text.sz == name.text.size() && !memcmp(text.curr, name.text.data(), text.sz);
+}
+
+bool SexprQuery::Equals(Sexpr const& sexpr, Sexpr::Elem const& e, Value const& value) const
+{
+    if (value.token == tsSexprAtom && value.name.any)
+        return true;
+    switch (value.token) {
+    case tsSexprAtom:
+        return Is(sexpr, e, value.name);
+    case tsSexprString:
+        if (e.token != tsSexprString)
+            return false;
+        else {
+            StrView text = sexpr.String(e.ref);
+            return text.sz == value.name.text.size() && !memcmp(text.curr, value.name.text.data(), text.sz);
+        }
+    default:
+        // an integer and a float are compared by value
+        if (e.token == tsSexprInteger && value.token == tsSexprInteger)
+            return sexpr.Int(e.ref) == value.integer;
+        if (e.token == tsSexprInteger)
+            return static_cast<double>(sexpr.Int(e.ref)) == value.number;
+        if (e.token == tsSexprFloat)
+            return sexpr.Float(e.ref) == value.number;
+        return false;
+    }
+}
+
+bool SexprQuery::Matches(Sexpr const& sexpr, Step const& step, size_t list) const
+{
+    size_t end = sexpr.Match(list);
+    size_t c = list + 1;
+    if (c >= end || !Is(sexpr, sexpr.expr[c], step.head))
+        return false;
+    if (step.where.empty())
+        return true;
+
+    // one pass over the children, ticking off constraints as their keywords appear
+    uint64_t unmet = step.where.size() == 64 ? ~0ull : (1ull << step.where.size()) - 1;
+    for (c = sexpr.Next(c); c < end && unmet; c = sexpr.Next(c)) {
+        Sexpr::Elem const& e = sexpr.expr[c];
+        if (e.token != tsSexprAtom)
+            continue;
+        size_t v = sexpr.Next(c);
+        if (v >= end)
+            break;
+        for (size_t k = 0; k < step.where.size(); ++k)
+            if ((unmet >> k & 1) && Is(sexpr, e, step.where[k].key) && Equals(sexpr, sexpr.expr[v], step.where[k].value))
+                unmet &= ~(1ull << k);
+    }
+    return !unmet;
+}
+
+bool SexprQuery::Select(Sexpr const& sexpr, size_t list, Match& m) const
+{
+    size_t end = sexpr.Match(list);
+    m.list = list;
+    if (!selects) {
+        m.begin = list;
+        m.end = sexpr.Next(list);
+        return true;
+    }
+    for (size_t c = sexpr.Next(list + 1); c < end; c = sexpr.Next(c)) {
+        if (!Is(sexpr, sexpr.expr[c], select))
+            continue;
+        // the values run to the next keyword or the end of the list
+        m.begin = c + 1;
+        for (m.end = m.begin; m.end < end; m.end = sexpr.Next(m.end)) {
+            Sexpr::Elem const& e = sexpr.expr[m.end];
+            if (e.token == tsSexprAtom && ts_IsKeyword(sexpr.Text(e)))
+                break;
+        }
+        m.end = std::min(m.end, sexpr.expr.size());
+        return true;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// SexprWriter
+//------------------------------------------------------------------------------
+
+// Formats v backwards into the buffer ending at end, two digits at a time.
+static char* ts_FormatUInt64(uint64_t v, char* end)
+{
+    static char const pairs[] =
+        "00010203040506070809101112131415161718192021222324"
+        "25262728293031323334353637383940414243444546474849"
+        "50515253545556575859606162636465666768697071727374"
+        "75767778798081828384858687888990919293949596979899";
+    while (v >= 100) {
+        unsigned pair = static_cast<unsigned>(v % 100) * 2;
+        v /= 100;
+        *--end = pairs[pair + 1];
+        *--end = pairs[pair];
+    }
+    if (v >= 10) {
+        *--end = pairs[v * 2 + 1];
+        *--end = pairs[v * 2];
+    }
+    else
+        *--end = static_cast<char>('0' + v);
+    return end;
+}
+
+// Writes the shortest text that reads back as f, and returns its length.
+// Without a decimal point or an exponent the text would read as an integer,
+// so .0 is added when the shortest form has neither. Infinities are written
+// as an exponent past the double range, which the lexer reads as a float;
+// inf would read as an atom.
+template <class T>
+static size_t ts_FormatFloat(T f, char* out, size_t capacity)
+{
+    if (std::isinf(f)) {
+        char const* text = f < 0 ? "-1e999" : "1e999";
+        size_t n = strlen(text);
+        memcpy(out, text, n);
+        return n;
+    }
+    size_t n = 0;
+#if defined(__cpp_lib_to_chars)
+    std::to_chars_result r = std::to_chars(out, out + capacity - 3, f);
+    n = static_cast<size_t>(r.ptr - out);
+#else
+    for (int precision = std::numeric_limits<T>::digits10; precision <= std::numeric_limits<T>::max_digits10; ++precision) {
+        n = static_cast<size_t>(snprintf(out, capacity - 3, "%.*g", precision, static_cast<double>(f)));
+        T back = std::is_same<T, float>::value ? static_cast<T>(strtof(out, nullptr)) : static_cast<T>(strtod(out, nullptr));
+        if (back == f)
+            break;
+    }
+    for (size_t i = 0; i < n; ++i)
+        if (out[i] == ',')
+            out[i] = '.';   // a locale's decimal comma
+#endif
+    if (std::isnan(f))
+        return n;
+    if (std::find(out, out + n, '.') == out + n && std::find(out, out + n, 'e') == out + n) {
+        out[n++] = '.';
+        out[n++] = '0';
+    }
+    return n;
+}
+
+// The delimiter that reads text back unchanged: text from a quoted string
+// has no unescaped ", nor from a Latin-1 § string an unescaped A7, and
+// UTF-8 § strings take no escapes.
+static int ts_EscapedStringDelimiter(StrView text)
+{
+    char const* end = text.curr + text.sz;
+    size_t trailing = 0;
+    while (trailing < text.sz && end[-1 - static_cast<ptrdiff_t>(trailing)] == '\\')
+        ++trailing;
+    if (!(trailing & 1)) {
+        if (tsScanForQuote(text.curr, end, '\"', true) >= end)
+            return '"';
+        if (tsScanForQuote(text.curr, end, '\xA7', true) >= end)
+            return 0xA7;
+    }
+    for (char const* p = text.curr; p + 1 < end; ++p)
+        if (p[0] == '\xC2' && p[1] == '\xA7')
+            return -1;
+    return 0xC2A7;
+}
+
+void SexprWriter::Separate()
+{
+    if (needSpace)
+        buffer += ' ';
+}
+
+SexprWriter& SexprWriter::Push()
+{
+    if (pretty && depth > 0) {
+        buffer += '\n';
+        buffer.append(static_cast<size_t>(depth * indent), ' ');
+    }
+    else
+        Separate();
+    buffer += '(';
+    ++depth;
+    needSpace = false;
+    return *this;
+}
+
+SexprWriter& SexprWriter::Pop()
+{
+    buffer += ')';
+    if (depth > 0)
+        --depth;
+    Token();
+    if (depth == 0) {
+        buffer += '\n';
+        needSpace = false;
+    }
+    return *this;
+}
+
+SexprWriter& SexprWriter::Atom(StrView atom)
+{
+    Separate();
+    buffer.append(atom.curr, atom.sz);
+    Token();
+    return *this;
+}
+
+SexprWriter& SexprWriter::String(StrView value)
+{
+    Separate();
+    buffer += '"';
+    char const* p = value.curr;
+    char const* end = value.curr + value.sz;
+    for (char const* q = p; q < end; ++q) {
+        char escape;
+        switch (*q) {
+        case '"': escape = '"'; break;
+        case '\\': escape = '\\'; break;
+        case '\n': escape = 'n'; break;
+        case '\r': escape = 'r'; break;
+        case '\t': escape = 't'; break;
+        default: continue;
+        }
+        buffer.append(p, q);
+        buffer += '\\';
+        buffer += escape;
+        p = q + 1;
+    }
+    buffer.append(p, end);
+    buffer += '"';
+    Token();
+    return *this;
+}
+
+SexprWriter& SexprWriter::EscapedString(StrView text)
+{
+    int delimiter = ts_EscapedStringDelimiter(text);
+    if (delimiter < 0) {
+        // no delimiter can hold it as it is, so write what it would read as
+        std::string value;
+        Sexpr::Unescape(text, value);
+        return String(value);
+    }
+    Separate();
+    char const* open = delimiter == '"' ? "\"" : delimiter == 0xA7 ? "\xA7" : "\xC2\xA7";
+    buffer += open;
+    buffer.append(text.curr, text.sz);
+    buffer += open;
+    Token();
+    return *this;
+}
+
+SexprWriter& SexprWriter::Int(int64_t i)
+{
+    Separate();
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    uint64_t magnitude = i < 0 ? 0 - static_cast<uint64_t>(i) : static_cast<uint64_t>(i);
+    char* p = ts_FormatUInt64(magnitude, end);
+    if (i < 0)
+        *--p = '-';
+    buffer.append(p, end);
+    Token();
+    return *this;
+}
+
+SexprWriter& SexprWriter::Float(float f)
+{
+    Separate();
+    char text[48];
+    buffer.append(text, ts_FormatFloat(f, text, sizeof(text)));
+    Token();
+    return *this;
+}
+
+SexprWriter& SexprWriter::Float(double f)
+{
+    Separate();
+    char text[48];
+    buffer.append(text, ts_FormatFloat(f, text, sizeof(text)));
+    Token();
+    return *this;
+}
+
+SexprWriter& SexprWriter::Write(Sexpr const& sexpr)
+{
+    for (Sexpr::Elem const& e : sexpr.expr) {
+        switch (e.token) {
+        case tsSexprPushList: Push(); break;
+        case tsSexprPopList: Pop(); break;
+        case tsSexprInteger: Int(sexpr.Int(e.ref)); break;
+        case tsSexprFloat: Float(sexpr.Float(e.ref)); break;
+        case tsSexprAtom: Atom(sexpr.Text(e)); break;
+        case tsSexprString:
+            if (sexpr.unescapeStrings)
+                String(sexpr.String(e.ref));
+            else
+                EscapedString(sexpr.String(e.ref));
+            break;
+        }
+    }
+    return *this;
+}
+
+bool SexprWriter::Flush()
+{
+    if (fd < 0 || failed)
+        return !failed;
+    char const* p = buffer.data();
+    size_t left = buffer.size();
+    while (left) {
+#if defined(_WIN32)
+        int n = _write(fd, p, static_cast<unsigned>(std::min(left, size_t(1) << 30)));
+#else
+        ssize_t n = write(fd, p, left);
+        if (n < 0 && errno == EINTR)
+            continue;
+#endif
+        if (n <= 0) {
+            failed = true;
+            break;
+        }
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+    buffer.clear();
+    return !failed;
+}
+
+char const* SymbolTable::Store(StrView name)
+{
+    // an oversized name gets a block of its own, leaving the current one open
+    if (name.sz > ts_SymbolBlockSize / 4) {
+        blocks.emplace_back(new char[name.sz]);
+        memcpy(blocks.back().get(), name.curr, name.sz);
+        return blocks.back().get();
+    }
+    if (name.sz > blockFree) {
+        blocks.emplace_back(new char[ts_SymbolBlockSize]);
+        blockNext = blocks.back().get();
+        blockFree = ts_SymbolBlockSize;
+    }
+    char* p = blockNext;
+    memcpy(p, name.curr, name.sz);
+    blockNext += name.sz;
+    blockFree -= name.sz;
+    return p;
 }
 }} // lab::Text
 #endif